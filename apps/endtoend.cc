@@ -7,11 +7,15 @@
 #include "tcp_over_ip.hh"
 
 #include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <thread>
 
 using namespace std;
 
+// How many datagrams the network thread moves per system call on the Internet socket
+static constexpr size_t INTERNET_BATCH = 32;
+
 EthernetAddress random_host_ethernet_address()
 {
   EthernetAddress addr;
@@ -216,7 +220,7 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
   atomic<bool> exit_flag {};
 
   queue<EthernetFrame> router_to_host;
-  queue<EthernetFrame> router_to_internet;
+  deque<EthernetFrame> router_to_internet; // frames leave from the front, a batch at a time
 
   /* set up the network */
   thread network_thread( [&]() {
@@ -251,32 +255,43 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
         },
         [&] { return not router_to_host.empty(); } );
 
-      // Frames from router to Internet
+      // Frames from router to Internet, up to a batch per system call
       event_loop.add_rule(
         "frames from router to Internet",
         internet_socket,
         Direction::Out,
         [&] {
           auto& f = router_to_internet;
-          if ( debug ) {
-            cerr << "     Router->Internet: " << summary( f.front() ) << "\n";
+          vector<vector<Buffer>> batch;
+          for ( size_t i = 0; i < f.size() and i < INTERNET_BATCH; i++ ) {
+            batch.push_back( serialize( f[i] ) );
+          }
+          // frames not sent stay queued for the next call (which throws if the socket has failed)
+          const size_t sent = internet_socket.send_batch( batch );
+          for ( size_t i = 0; i < sent; i++ ) {
+            if ( debug ) {
+              cerr << "     Router->Internet: " << summary( f.front() ) << "\n";
+            }
+            f.pop_front();
           }
-          internet_socket.write( serialize( f.front() ) );
-          f.pop();
         },
         [&] { return not router_to_internet.empty(); } );
 
-      // Frames from Internet to router
+      // Frames from Internet to router, draining up to a batch per readiness event (a datagram too long to be an
+      // Ethernet frame is dropped)
       event_loop.add_rule( "frames from Internet to router", internet_socket, Direction::In, [&] {
-        auto frame_opt = maybe_receive_frame( internet_socket );
-        if ( not frame_opt ) {
-          return;
-        }
-        EthernetFrame frame = move( frame_opt.value() );
-        if ( debug ) {
-          cerr << "     Internet->router: " << summary( frame ) << "\n";
+        vector<DatagramSocket::Received> datagrams;
+        internet_socket.recv_batch( datagrams, INTERNET_BATCH, PacketPool::MTU_SLAB );
+        for ( auto& datagram : datagrams ) {
+          EthernetFrame frame;
+          if ( not parse( frame, { move( datagram.payload ) } ) ) {
+            continue;
+          }
+          if ( debug ) {
+            cerr << "     Internet->router: " << summary( frame ) << "\n";
+          }
+          router.interface( internet_side ).recv_frame( frame );
         }
-        router.interface( internet_side ).recv_frame( frame );
         router.route();
       } );
 
@@ -291,7 +306,7 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
           router_to_host.push( move( frame.value() ) );
         }
         while ( auto frame = router.interface( internet_side ).maybe_send() ) {
-          router_to_internet.push( move( frame.value() ) );
+          router_to_internet.push_back( move( frame.value() ) );
         }
 
         if ( exit_flag ) {
@@ -6,3 +6,9 @@ set(SANITIZING_FLAGS -fno-sanitize-recover=all -fsanitize=undefined -fsanitize=a
 # ask for more warnings from the compiler
 set (CMAKE_BASE_CXX_FLAGS "${CMAKE_CXX_FLAGS}")
 set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -Wall -Wpedantic -Wextra -Weffc++ -Werror -Wshadow -Wpointer-arith -Wcast-qual -Wformat=2 -Wno-unqualified-std-cast-call")
+
+# Buffers handed between threads need atomic reference counts; a program that never does so can drop them
+option (BUFFER_NONATOMIC_REFCOUNT "Count references to Buffer storage without atomic operations" OFF)
+if (BUFFER_NONATOMIC_REFCOUNT)
+  add_compile_definitions (BUFFER_NONATOMIC_REFCOUNT)
+endif ()
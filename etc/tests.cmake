@@ -45,6 +45,10 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_sack)
+ttest(recv_window_scale)
+ttest(recv_zero_copy)
+ttest(recv_timestamps)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -53,11 +57,28 @@ ttest(send_window)
 ttest(send_ack)
 ttest(send_close)
 ttest(send_extra)
+ttest(send_fast_retx)
+ttest(send_sack)
+ttest(send_window_scale)
+ttest(send_mss)
+ttest(tcp_peer_options)
+ttest(send_nagle)
+ttest(send_pacing)
+ttest(send_timestamps)
 
 ttest(net_interface)
 
 ttest(router)
 
+ttest(eventloop)
+ttest(packet_pool)
+ttest(udp_batch)
+ttest(tun_adapter_io_uring)
+ttest(tun_multi_queue)
+
+ttest(tcp_multiplexer)
+ttest(tcp_sharded_runtime)
+
 add_custom_target (check0 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 12 -R 'webget|^byte_stream_')
 
 add_custom_target (check_webget COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --timeout 12 -R 'webget')
@@ -90,3 +111,12 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(tcp_peer_speed_test)
+stest(tcp_multiplexer_speed_test)
+stest(tcp_sharded_runtime_speed_test)
+stest(eventloop_speed_test)
+stest(tun_adapter_speed_test)
+stest(tcp_segment_speed_test)
+stest(parser_speed_test)
+stest(tcp_sender_wire_speed_test)
+stest(udp_batch_speed_test)
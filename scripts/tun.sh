@@ -9,7 +9,7 @@ show_usage () {
 
 start_tun () {
     local TUNNUM="$1" TUNDEV="tun$1"
-    ip tuntap add mode tun user "${SUDO_USER}" name "${TUNDEV}"
+    ip tuntap add mode tun multi_queue user "${SUDO_USER}" name "${TUNDEV}"
     ip addr add "${TUN_IP_PREFIX}.${TUNNUM}.1/24" dev "${TUNDEV}"
     ip link set dev "${TUNDEV}" up
     ip route change "${TUN_IP_PREFIX}.${TUNNUM}.0/24" dev "${TUNDEV}" rto_min 10ms
@@ -24,7 +24,7 @@ stop_tun () {
     local TUNDEV="tun$1"
     iptables -t nat -D PREROUTING -s ${TUN_IP_PREFIX}.${1}.0/24 -j CONNMARK --set-mark ${1}
     iptables -t nat -D POSTROUTING -j MASQUERADE -m connmark --mark ${1}
-    ip tuntap del mode tun name "$TUNDEV"
+    ip tuntap del mode tun multi_queue name "$TUNDEV" 2>/dev/null || ip tuntap del mode tun name "$TUNDEV"
 }
 
 start_all () {
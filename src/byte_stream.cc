@@ -7,10 +7,14 @@ using namespace std;
 
 ByteStream::ByteStream( uint64_t capacity ) : capacity_( capacity ), rest( capacity ) {}
 
-void Writer::push( string data )
+void Writer::push( Buffer data )
 {
   uint64_t const len = min( data.size(), rest );
-  buff += data.substr( 0, len );
+  if ( len == 0 ) {
+    return;
+  }
+  buff.push_back( len == data.size() ? move( data ) : data.substr( 0, len ) );
+  buff.back().compact(); // don't hold a whole read slab for a short payload
   rest -= len;
   pushed += len;
 }
@@ -30,6 +34,18 @@ bool Writer::is_closed() const
   return closed;
 }
 
+void Writer::set_capacity( uint64_t capacity )
+{
+  const uint64_t buffered = capacity_ - rest;
+  capacity_ = max( capacity, buffered );
+  rest = capacity_ - buffered;
+}
+
+uint64_t Writer::capacity() const
+{
+  return capacity_;
+}
+
 uint64_t Writer::available_capacity() const
 {
   return rest;
@@ -42,7 +58,7 @@ uint64_t Writer::bytes_pushed() const
 
 string_view Reader::peek() const
 {
-  return buff;
+  return buff.empty() ? string_view {} : string_view { buff.front() };
 }
 
 bool Reader::is_finished() const
@@ -60,7 +76,14 @@ void Reader::pop( uint64_t len )
   len = min( len, bytes_buffered() );
   poped += len;
   rest += len;
-  buff = buff.substr( len );
+  while ( len > 0 ) {
+    const uint64_t from_front = min( len, buff.front().size() );
+    buff.front().remove_prefix( from_front );
+    len -= from_front;
+    if ( buff.front().empty() ) {
+      buff.pop_front();
+    }
+  }
 }
 
 uint64_t Reader::bytes_buffered() const
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "buffer.hh"
+
 #include <cstdint>
+#include <deque>
 #include <queue>
 #include <stdexcept>
 #include <string>
@@ -12,7 +15,7 @@ class Writer;
 class ByteStream
 {
 protected:
-  std::string buff {};
+  std::deque<Buffer> buff {}; // pushed Buffers, copied only if compact() finds them small
   uint64_t capacity_;
   uint64_t rest = 0;
   uint64_t pushed = 0;
@@ -33,12 +36,15 @@ public:
 class Writer : public ByteStream
 {
 public:
-  void push( std::string data ); // Push data to stream, but only as much as available capacity allows.
+  void push( Buffer data ); // Push data to stream, but only as much as available capacity allows.
 
   void close();     // Signal that the stream has reached its ending. Nothing more will be written.
   void set_error(); // Signal that the stream suffered an error.
 
   bool is_closed() const;              // Has the stream been closed?
+  void set_capacity( uint64_t capacity ); // Resize the stream (never below the bytes already buffered).
+
+  uint64_t capacity() const;           // How many bytes can the stream hold at once?
   uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
   uint64_t bytes_pushed() const;       // Total number of bytes cumulatively pushed to the stream
 };
@@ -46,7 +52,7 @@ public:
 class Reader : public ByteStream
 {
 public:
-  std::string_view peek() const; // Peek at the next bytes in the buffer
+  std::string_view peek() const; // Peek at the next bytes in the buffer (up to the end of the oldest push)
   void pop( uint64_t len );      // Remove `len` bytes from the buffer
 
   bool is_finished() const; // Is the stream finished (closed and fully popped)?
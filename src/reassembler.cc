@@ -1,33 +1,48 @@
 #include "reassembler.hh"
-#include <sstream>
+
+#include <algorithm>
+#include <iterator>
 
 using namespace std;
 
-void Reassembler::insert( uint64_t first_index, string data, bool is_last_substring, Writer& output )
+void Reassembler::insert( uint64_t first_index, Buffer data, bool is_last_substring, Writer& output )
 {
   if ( is_last_substring ) {
-    last_rcvd = is_last_substring;
+    end_index = first_index + data.size();
+  }
+
+  // only keep the part of the substring that fits in the window
+  const uint64_t begin = max( first_index, current_index );
+  const uint64_t end = min( first_index + data.size(), current_index + output.available_capacity() );
+
+  // write or store the parts not already held, each as a slice of `data` (copied only if it is small enough
+  // that holding on to all of `data` would waste memory)
+  auto it = segments.upper_bound( begin );
+  if ( it != segments.begin() && prev( it )->first + prev( it )->second.size() > begin ) {
+    --it;
   }
-  for ( uint64_t i = 0; i < data.size(); i++ ) {
-    if ( first_index + i < current_index || m.contains( first_index + i )
-         || first_index + i - current_index + 1 > output.available_capacity() ) {
-      continue;
+  for ( uint64_t next = begin; next < end; ++it ) {
+    const uint64_t gap_end = it == segments.end() ? end : min( end, it->first );
+    if ( next == current_index && next < gap_end ) {
+      output.push( data.substr( next - first_index, gap_end - next ) ); // in order: skip the map
+      current_index = gap_end;
+    } else if ( next < gap_end ) {
+      pending += gap_end - next;
+      segments.emplace_hint( it, next, data.substr( next - first_index, gap_end - next ) )->second.compact();
+    }
+    if ( it == segments.end() ) {
+      break;
     }
-    m[first_index + i] = data[i];
-    pending++;
+    next = max( next, it->first + it->second.size() );
   }
-  ostringstream oss;
 
-  while ( m.contains( current_index ) ) {
-    oss << m[current_index];
-    pending--;
-    current_index++;
-  }
-  string const str = oss.str();
-  if ( !str.empty() ) {
-    output.push( str );
+  while ( !segments.empty() && segments.begin()->first == current_index ) {
+    auto node = segments.extract( segments.begin() );
+    pending -= node.mapped().size();
+    current_index += node.mapped().size();
+    output.push( move( node.mapped() ) );
   }
-  if ( last_rcvd && bytes_pending() == 0 ) {
+  if ( end_index.has_value() && current_index == end_index.value() ) {
     output.close();
   }
 }
@@ -36,3 +51,17 @@ uint64_t Reassembler::bytes_pending() const
 {
   return pending;
 }
+
+vector<pair<uint64_t, uint64_t>> Reassembler::pending_ranges() const
+{
+  vector<pair<uint64_t, uint64_t>> ranges;
+  ranges.reserve( segments.size() );
+  for ( const auto& [first, data] : segments ) {
+    if ( !ranges.empty() && ranges.back().second == first ) {
+      ranges.back().second += data.size();
+    } else {
+      ranges.emplace_back( first, first + data.size() );
+    }
+  }
+  return ranges;
+}
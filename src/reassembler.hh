@@ -2,15 +2,18 @@
 
 #include "byte_stream.hh"
 
+#include <map>
+#include <optional>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 class Reassembler
 {
 private:
-  std::unordered_map<uint64_t, char> m {};
+  std::map<uint64_t, Buffer> segments {}; // non-overlapping slices of inserted substrings keyed by first index
   uint64_t current_index = 0;
-  bool last_rcvd = false;
+  std::optional<uint64_t> end_index {};
   uint64_t pending = 0;
 
 public:
@@ -33,9 +36,15 @@ public:
    * (i.e., bytes that couldn't be written even if earlier gaps get filled in).
    *
    * The Reassembler should close the stream after writing the last byte.
+   *
+   * Substrings are stored and written as slices of `data`, so their bytes are never copied.
    */
-  void insert( uint64_t first_index, std::string data, bool is_last_substring, Writer& output );
+  void insert( uint64_t first_index, Buffer data, bool is_last_substring, Writer& output );
 
   // How many bytes are stored in the Reassembler itself?
   uint64_t bytes_pending() const;
+
+  // Which [first, last) stream index ranges are stored in the Reassembler, in ascending order (touching
+  // ranges reported as one)?
+  std::vector<std::pair<uint64_t, uint64_t>> pending_ranges() const;
 };
@@ -1,29 +1,83 @@
 #include "tcp_receiver.hh"
+#include "tcp_config.hh"
+
+#include <algorithm>
 
 using namespace std;
 
 void TCPReceiver::receive( TCPSenderMessage message, Reassembler& reassembler, Writer& inbound_stream )
 {
+  if ( paws_reject( message ) ) {
+    return;
+  }
   if ( !syn_received && message.SYN ) {
     zero_point = message.seqno;
     syn_received = true;
+    sack_permitted = message.sack_permitted;
+    timestamps = message.timestamp.has_value();
   }
   if ( syn_received ) {
-    reassembler.insert(
-      message.seqno.unwrap( Wrap32::wrap( message.SYN ? 0 : 1, zero_point ), inbound_stream.bytes_pushed() ),
-      message.payload,
-      message.FIN,
-      inbound_stream );
+    const uint64_t first_index
+      = message.seqno.unwrap( Wrap32::wrap( message.SYN ? 0 : 1, zero_point ), inbound_stream.bytes_pushed() );
+    // remember the timestamp of a segment that does not start beyond what we acknowledge (RFC 7323 4.3)
+    if ( timestamps && message.timestamp.has_value() && first_index <= inbound_stream.bytes_pushed() ) {
+      ts_recent = message.timestamp;
+    }
+    reassembler.insert( first_index, move( message.payload ), message.FIN, inbound_stream );
+    if ( sack_permitted ) {
+      update_sack_ranges( first_index, reassembler );
+    }
   }
 }
 
 TCPReceiverMessage TCPReceiver::send( const Writer& inbound_stream ) const
 {
   TCPReceiverMessage rm;
-  rm.window_size = static_cast<uint16_t>(
-    inbound_stream.available_capacity() > UINT16_MAX ? UINT16_MAX : inbound_stream.available_capacity() );
+  const uint64_t window = inbound_stream.available_capacity() >> window_shift;
+  rm.window_size = static_cast<uint16_t>( window > UINT16_MAX ? UINT16_MAX : window );
   if ( syn_received ) {
     rm.ackno = Wrap32::wrap( inbound_stream.bytes_pushed() + ( inbound_stream.is_closed() ? 2 : 1 ), zero_point );
+    rm.timestamp_echo = ts_recent;
+    for ( const auto& [first, last] : sack_ranges ) {
+      rm.sack_blocks.emplace_back( Wrap32::wrap( first + 1, zero_point ), Wrap32::wrap( last + 1, zero_point ) );
+    }
   }
   return rm;
 }
+
+bool TCPReceiver::paws_reject( const TCPSenderMessage& message ) const
+{
+  return syn_received && !message.SYN && ts_recent.has_value() && message.timestamp.has_value()
+         && static_cast<int32_t>( message.timestamp.value() - ts_recent.value() ) < 0;
+}
+
+void TCPReceiver::update_sack_ranges( uint64_t first_index, const Reassembler& reassembler )
+{
+  const auto pending = reassembler.pending_ranges();
+  vector<pair<uint64_t, uint64_t>> ranges;
+  const auto add = [&]( const pair<uint64_t, uint64_t>& range ) {
+    if ( ranges.size() < TCPConfig::MAX_SACK_BLOCKS
+         && find( ranges.begin(), ranges.end(), range ) == ranges.end() ) {
+      ranges.push_back( range );
+    }
+  };
+
+  // the block holding the segment that just arrived goes first
+  for ( const auto& range : pending ) {
+    if ( range.first <= first_index && first_index < range.second ) {
+      add( range );
+    }
+  }
+  // then the blocks reported most recently (they may have grown since), then anything else, highest first
+  for ( const auto& [first, last] : sack_ranges ) {
+    for ( const auto& range : pending ) {
+      if ( range.first <= first && first < range.second ) {
+        add( range );
+      }
+    }
+  }
+  for ( auto it = pending.rbegin(); it != pending.rend(); ++it ) {
+    add( *it );
+  }
+  sack_ranges = move( ranges );
+}
@@ -4,11 +4,23 @@
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
+#include <optional>
+#include <utility>
+#include <vector>
+
 class TCPReceiver
 {
 private:
   Wrap32 zero_point = Wrap32( 0 );
   bool syn_received = false;
+  bool sack_permitted = false;
+  uint8_t window_shift = 0; // RFC 7323: right shift applied to the advertised window
+  std::vector<std::pair<uint64_t, uint64_t>> sack_ranges {}; // stream index ranges to report, most recent first
+  bool timestamps = false;              // RFC 7323: the peer's SYN carried a timestamp, so its later ones count
+  std::optional<uint32_t> ts_recent {}; // RFC 7323: the peer's latest timestamp, echoed back and used by PAWS
+
+  /* Choose which of the Reassembler's pending ranges to report, starting with the one holding `first_index` */
+  void update_sack_ranges( uint64_t first_index, const Reassembler& reassembler );
 
 public:
   /*
@@ -19,4 +31,14 @@ public:
 
   /* The TCPReceiver sends TCPReceiverMessages back to the TCPSender. */
   TCPReceiverMessage send( const Writer& inbound_stream ) const;
+
+  /*
+   * PAWS (RFC 7323): does the segment carry a timestamp older than one already accepted? Such a segment is a
+   * stale duplicate, possibly from before the sequence numbers wrapped, and is dropped. Only applies if the
+   * peer's SYN carried a timestamp.
+   */
+  bool paws_reject( const TCPSenderMessage& message ) const;
+
+  /* Advertise later windows in units of 2^shift bytes, as negotiated in the SYNs (RFC 7323) */
+  void set_window_shift( uint8_t shift ) { window_shift = shift; }
 };
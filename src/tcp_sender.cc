@@ -1,15 +1,35 @@
 #include "tcp_sender.hh"
 #include "tcp_config.hh"
 
+#include <algorithm>
 #include <random>
+#include <stdexcept>
+#include <string_view>
 
 using namespace std;
 
+/* Read up to `len` bytes from the stream into `out`, summing them for the TCP checksum as they are copied */
+static void read_and_sum( Reader& reader, uint64_t len, string& out, InternetChecksum& sum )
+{
+  out.clear();
+  while ( reader.bytes_buffered() && out.size() < len ) {
+    const string_view view = reader.peek().substr( 0, len - out.size() );
+    if ( view.empty() ) {
+      throw runtime_error( "Reader::peek() returned empty string_view" );
+    }
+    const size_t start = out.size();
+    out.resize( start + view.size() );
+    sum.add_copy( view, out.data() + start );
+    reader.pop( view.size() );
+  }
+}
+
 /* TCPSender constructor (uses a random ISN if none given) */
 TCPSender::TCPSender( uint64_t initial_RTO_ms, optional<Wrap32> fixed_isn )
   : isn_( fixed_isn.value_or( Wrap32 { random_device()() } ) )
   , initial_RTO_ms_( initial_RTO_ms )
   , zero_point( isn_ )
+  , max_payload_size( TCPConfig::MAX_PAYLOAD_SIZE )
 {
   timer.rto = initial_RTO_ms;
 }
@@ -30,116 +50,374 @@ optional<TCPSenderMessage> TCPSender::maybe_send()
     return {};
   }
   auto frame = segments_to_sent.top();
+  // while pacing, data waits for the token bucket; the bucket may go into debt by one segment
+  if ( pacing_rate() > 0 && frame.msg.payload.size() > 0 ) {
+    if ( pacing_credit <= 0 ) {
+      return {};
+    }
+    pacing_credit -= static_cast<int64_t>( frame.msg.payload.size() );
+  }
   segments_to_sent.pop();
-  segments_outstanding.push_back( frame );
+  frame.sent_at = now;
+  if ( timestamps ) {
+    frame.msg.timestamp = static_cast<uint32_t>( now );
+  }
+  // keep the outstanding segments ordered; only retransmissions land before the end
+  auto pos = segments_outstanding.end();
+  while ( pos != segments_outstanding.begin() && prev( pos )->checkpoint > frame.checkpoint ) {
+    --pos;
+  }
+  segments_outstanding.insert( pos, frame );
   timer.run();
   return frame.msg;
 }
 
 void TCPSender::push( Reader& outbound_stream )
 {
-  if ( fin_sent ) {
-    return;
-  }
-  uint64_t const ws = window_size > 0 ? window_size : 1;
-  string str;
-  read( outbound_stream, min( TCPConfig::MAX_PAYLOAD_SIZE, ws - sequence_numbers_in_flight() ), str );
-  TCPSenderMessage sm;
-  if ( str.empty() && sync_sent ) {
-    if ( outbound_stream.is_finished() && sequence_numbers_in_flight() + 1 <= ws ) {
-      sm = TCPSenderMessage { isn_, !sync_sent, Buffer {}, true };
-      fin_sent = true;
+  while ( !fin_sent ) {
+    uint64_t const ws = window_size > 0 ? window_size : 1;
+    if ( sequence_numbers_in_flight() >= ws ) {
+      return;
+    }
+    // less than a full segment to send and more may come: wait if corked, or with Nagle while anything is unacked
+    const size_t full_payload = payload_room( max_payload_size );
+    if ( sync_sent && outbound_stream.bytes_buffered() < full_payload && !outbound_stream.writer().is_closed()
+         && ( corked || ( nagle && sequence_numbers_in_flight() > 0 ) ) ) {
+      return;
+    }
+    // probe with the midpoint between the confirmed size and the limit, using a full segment of data
+    const size_t probe_payload = payload_room( ( max_payload_size + probe_limit + 1 ) / 2 );
+    const bool probe = sync_sent && !probe_outstanding && probe_limit > max_payload_size
+                       && outbound_stream.bytes_buffered() >= probe_payload
+                       && ws - sequence_numbers_in_flight() >= probe_payload;
+    const uint64_t len = min( probe ? probe_payload : full_payload, ws - sequence_numbers_in_flight() );
+    // a payload too big for its Buffer to hold inline is read into a slab from the packet pool
+    string str;
+    if ( min( len, outbound_stream.bytes_buffered() ) > Buffer::INLINE_CAPACITY ) {
+      str = PacketPool::local().take( len );
+    }
+    InternetChecksum payload_checksum;
+    read_and_sum( outbound_stream, len, str, payload_checksum );
+    TCPSenderMessage sm;
+    if ( str.empty() && sync_sent ) {
+      if ( outbound_stream.is_finished() && sequence_numbers_in_flight() + 1 <= ws ) {
+        sm = TCPSenderMessage { isn_, !sync_sent, Buffer {}, true };
+        fin_sent = true;
+      } else {
+        return;
+      }
     } else {
+      const bool fin = ( str.size() + 1 ) <= ( ws - sequence_numbers_in_flight() ) && outbound_stream.is_finished();
+      sm = TCPSenderMessage { isn_, !sync_sent, Buffer { move( str ) }, fin };
+      sm.payload_checksum = payload_checksum;
+      fin_sent = sm.FIN;
+    }
+    if ( !sync_sent ) {
+      sync_sent = true;
+    }
+    isn_ = isn_ + sm.sequence_length();
+    checkpoint += sm.sequence_length();
+    in_flight_cnt += sm.sequence_length();
+    Frame frame { checkpoint, sm, window_size == 0, false, probe };
+    frame.option_bytes = option_bytes;
+    segments_to_sent.push( frame );
+    probe_outstanding |= probe;
+    if ( outbound_stream.peek().empty() || ws - sequence_numbers_in_flight() == 0 ) {
       return;
     }
-  } else {
-    sm = TCPSenderMessage { isn_,
-                            !sync_sent,
-                            ( str.length() > 0 ) ? ( Buffer { string( str.begin(), str.end() ) } ) : Buffer {},
-                            ( str.size() + 1 ) <= ( ws - sequence_numbers_in_flight() )
-                              && outbound_stream.is_finished() };
-    fin_sent = sm.FIN;
-  }
-  if ( !sync_sent ) {
-    sync_sent = true;
-  }
-  isn_ = isn_ + sm.sequence_length();
-  checkpoint += sm.sequence_length();
-  in_flight_cnt += sm.sequence_length();
-  segments_to_sent.push( Frame { checkpoint, sm, window_size == 0 } );
-  if ( !outbound_stream.peek().empty() && ws - sequence_numbers_in_flight() > 0 ) {
-    push( outbound_stream );
   }
 }
 
 TCPSenderMessage TCPSender::send_empty_message() const
 {
-  if ( segments_outstanding.empty() ) {
-    return TCPSenderMessage { isn_, false, {}, false };
+  TCPSenderMessage sm { isn_, false, {}, false };
+  if ( !segments_outstanding.empty() ) {
+    const Frame& latest_frame = segments_outstanding.back();
+    sm.seqno = latest_frame.msg.seqno + latest_frame.msg.sequence_length();
   }
-  Frame latest_frame = segments_outstanding.front();
-  for ( const auto& frame : segments_outstanding ) {
-    if ( frame.checkpoint > latest_frame.checkpoint ) {
-      latest_frame = frame;
-    }
+  if ( timestamps ) {
+    sm.timestamp = static_cast<uint32_t>( now );
   }
-  return TCPSenderMessage { latest_frame.msg.seqno + latest_frame.msg.sequence_length(), false, {}, false };
+  return sm;
 }
 
-void TCPSender::receive( const TCPReceiverMessage& msg )
+void TCPSender::set_window_shift( uint8_t shift )
 {
-  window_size = msg.window_size;
+  window_shift = shift;
+}
+
+void TCPSender::set_mss( size_t mss, size_t probe_up_to )
+{
+  max_payload_size = mss;
+  probe_limit = probe_up_to;
+}
+
+void TCPSender::set_option_length( size_t bytes )
+{
+  option_bytes = bytes;
+}
+
+size_t TCPSender::payload_room( size_t segment_size ) const
+{
+  // always leave room for at least one byte, so that a tiny MSS still makes progress
+  return segment_size - min( option_bytes, segment_size - 1 );
+}
+
+void TCPSender::set_nagle( bool enabled )
+{
+  nagle = enabled;
+}
+
+void TCPSender::set_cork( bool enabled )
+{
+  corked = enabled;
+}
+
+void TCPSender::set_pacing( bool enabled )
+{
+  pacing = enabled;
+}
+
+void TCPSender::set_timestamps( bool enabled )
+{
+  timestamps = enabled;
+}
+
+void TCPSender::update_rtt( uint64_t sample )
+{
+  if ( !srtt.has_value() ) {
+    srtt = sample;
+    rttvar = sample / 2;
+    return;
+  }
+  const uint64_t deviation = srtt.value() > sample ? srtt.value() - sample : sample - srtt.value();
+  rttvar = ( 3 * rttvar + deviation ) / 4;
+  srtt = ( 7 * srtt.value() + sample ) / 8;
+}
+
+void TCPSender::receive( const TCPReceiverMessage& msg, bool carries_data )
+{
+  const uint64_t new_window_size = static_cast<uint64_t>( msg.window_size ) << window_shift;
+  const bool window_changed = new_window_size != window_size;
+  window_size = new_window_size;
+  if ( !msg.ackno.has_value() ) {
+    return;
+  }
   uint64_t const ack_no = msg.ackno->unwrap( zero_point, checkpoint );
-  if ( msg.ackno.has_value() && ack_no > max_checkpoint_in_flight() ) {
+  if ( ack_no > max_checkpoint_in_flight() ) {
     return;
   }
-  for ( auto it = segments_outstanding.begin(); it != segments_outstanding.end(); ) {
-    if ( it->checkpoint <= ack_no ) {
-      if ( it->msg.SYN ) {
-        sync_sent = true;
+  bool new_data_acked = false;
+  optional<uint64_t> rtt_sample;
+  while ( !segments_outstanding.empty() && segments_outstanding.front().checkpoint <= ack_no ) {
+    if ( !segments_outstanding.front().retransmitted ) {
+      rtt_sample = now - segments_outstanding.front().sent_at; // Karn: only segments sent once
+    }
+    if ( segments_outstanding.front().msg.SYN ) {
+      sync_sent = true;
+    }
+    if ( segments_outstanding.front().probe ) {
+      const Frame& probe = segments_outstanding.front();
+      max_payload_size = probe.msg.payload.size() + probe.option_bytes;
+      probe_outstanding = false;
+    }
+    in_flight_cnt -= segments_outstanding.front().msg.sequence_length();
+    segments_outstanding.pop_front();
+    new_data_acked = true;
+  }
+  if ( timestamps && new_data_acked && msg.timestamp_echo.has_value() ) {
+    // RFC 7323 RTTM: the echo says which transmission is being acknowledged, so retransmissions count too
+    rtt_sample = static_cast<uint32_t>( static_cast<uint32_t>( now ) - msg.timestamp_echo.value() );
+  }
+  if ( rtt_sample.has_value() ) {
+    update_rtt( rtt_sample.value() );
+  }
+  if ( new_data_acked ) {
+    timer.rto = initial_RTO_ms_;
+    timer.restart();
+    retransmission_cnt = 0;
+  }
+
+  const bool new_sack_info = update_scoreboard( msg );
+
+  if ( new_data_acked ) {
+    dup_ack_cnt = 0;
+    if ( in_fast_recovery ) {
+      if ( ack_no >= recover_point ) {
+        in_fast_recovery = false;
+      } else {
+        // partial ACK: the next hole is lost too, so resend it without waiting for more duplicates
+        retransmit_next_hole( ack_no );
       }
-      timer.rto = initial_RTO_ms_;
-      timer.restart();
-      in_flight_cnt -= it->msg.sequence_length();
-      it = segments_outstanding.erase( it );
-      retransmission_cnt = 0;
-    } else {
-      ++it;
+    }
+  } else if ( !carries_data && ( !window_changed || new_sack_info ) && ack_no == last_ack_no
+              && !segments_outstanding.empty() ) {
+    dup_ack_cnt++;
+    if ( in_fast_recovery ) {
+      retransmit_next_hole( ack_no );
+    } else if ( dup_ack_cnt == TCPConfig::DUP_ACK_THRESHOLD && ack_no >= recover_point ) {
+      in_fast_recovery = true;
+      recover_point = checkpoint;
+      high_rxt = ack_no;
+      retransmit_next_hole( ack_no );
     }
   }
+  last_ack_no = ack_no;
 }
 
 void TCPSender::tick( const size_t ms_since_last_tick )
 {
+  now += ms_since_last_tick;
+  if ( pacing_rate() > 0 ) {
+    // refill the bucket, holding at most a couple of segments (or one tick's worth) in reserve
+    const uint64_t refill = pacing_rate() * ms_since_last_tick / 1000;
+    const auto burst = static_cast<int64_t>( max( TCPConfig::PACING_BURST_SEGMENTS * max_payload_size, refill ) );
+    pacing_credit = min( pacing_credit + static_cast<int64_t>( refill ), burst );
+  }
   if ( segments_outstanding.empty() ) {
     timer.shutdown();
     return;
   }
   timer.elapse( ms_since_last_tick );
   if ( timer.expired() ) {
-    auto frame = segments_outstanding.begin();
-    for ( auto it = segments_outstanding.begin(); it != segments_outstanding.end(); ++it ) {
-      if ( it->checkpoint < frame->checkpoint ) {
-        frame = it;
-      }
-    }
-    segments_to_sent.push( *frame );
-    if ( !frame->dont_back_off_rto ) {
+    // a lost probe says the segment was too big, not that the network is congested
+    if ( !segments_outstanding.front().dont_back_off_rto && !segments_outstanding.front().probe ) {
       timer.rto *= 2;
     }
-    segments_outstanding.erase( frame );
+    // the receiver may have discarded what it SACKed, so start over from the left edge of the window
+    for ( auto& frame : segments_outstanding ) {
+      frame.sacked = false;
+    }
+    retransmit_earliest();
     retransmission_cnt++;
     timer.restart();
+    // a timeout ends fast recovery; duplicates of data sent before now must not start another one
+    in_fast_recovery = false;
+    dup_ack_cnt = 0;
+    recover_point = checkpoint;
+  }
+}
+
+void TCPSender::retransmit_earliest()
+{
+  if ( segments_outstanding.empty() ) {
+    return;
+  }
+  requeue( segments_outstanding.front() );
+  segments_outstanding.pop_front();
+}
+
+void TCPSender::requeue( Frame frame )
+{
+  frame.retransmitted = true;
+  if ( !frame.probe ) {
+    segments_to_sent.push( frame );
+    return;
+  }
+  probe_limit = frame.msg.payload.size() + frame.option_bytes - 1;
+  probe_outstanding = false;
+  const string_view payload = frame.msg.payload;
+  const size_t piece_size = payload_room( max_payload_size );
+  uint64_t start = frame.checkpoint - frame.msg.sequence_length();
+  for ( size_t offset = 0; offset < payload.size(); offset += piece_size ) {
+    const string_view piece = payload.substr( offset, piece_size );
+    const bool fin = frame.msg.FIN && offset + piece.size() == payload.size();
+    TCPSenderMessage sm { frame.msg.seqno + offset, false, Buffer { string( piece ) }, fin };
+    start += sm.sequence_length();
+    Frame resent { start, sm, frame.dont_back_off_rto, false, false, true };
+    resent.option_bytes = option_bytes;
+    segments_to_sent.push( resent );
+  }
+}
+
+bool TCPSender::update_scoreboard( const TCPReceiverMessage& msg )
+{
+  bool newly_sacked = false;
+  for ( const auto& [left, right] : msg.sack_blocks ) {
+    const uint64_t first = left.unwrap( zero_point, checkpoint );
+    const uint64_t last = right.unwrap( zero_point, checkpoint );
+    for ( auto& frame : segments_outstanding ) {
+      if ( !frame.sacked && first <= frame.checkpoint - frame.msg.sequence_length() && frame.checkpoint <= last ) {
+        frame.sacked = true;
+        newly_sacked = true;
+      }
+    }
+  }
+  return newly_sacked;
+}
+
+void TCPSender::retransmit_next_hole( uint64_t ack_no )
+{
+  uint64_t highest_sacked = 0;
+  for ( const auto& frame : segments_outstanding ) {
+    if ( frame.sacked ) {
+      highest_sacked = max( highest_sacked, frame.checkpoint );
+    }
+  }
+  auto hole = segments_outstanding.end();
+  for ( auto it = segments_outstanding.begin(); it != segments_outstanding.end(); ++it ) {
+    const bool missing = it->checkpoint - it->msg.sequence_length() == ack_no || it->checkpoint <= highest_sacked;
+    if ( !it->sacked && it->checkpoint > high_rxt && missing
+         && ( hole == segments_outstanding.end() || it->checkpoint < hole->checkpoint ) ) {
+      hole = it;
+    }
+  }
+  if ( hole == segments_outstanding.end() ) {
+    return;
   }
+  high_rxt = hole->checkpoint;
+  requeue( *hole );
+  segments_outstanding.erase( hole );
 }
 
 uint64_t TCPSender::max_checkpoint_in_flight() const
 {
-  uint64_t max_checkpoint = 0;
-  for ( const auto& it : segments_outstanding ) {
-    max_checkpoint = max( max_checkpoint, it.checkpoint );
+  return segments_outstanding.empty() ? 0 : segments_outstanding.back().checkpoint;
+}
+
+uint64_t TCPSender::duplicate_acks() const
+{
+  return dup_ack_cnt;
+}
+
+bool TCPSender::in_recovery() const
+{
+  return in_fast_recovery;
+}
+
+size_t TCPSender::mss() const
+{
+  return max_payload_size;
+}
+
+optional<uint64_t> TCPSender::next_deadline() const
+{
+  optional<uint64_t> deadline;
+  if ( !segments_outstanding.empty() ) {
+    deadline = timer.remaining();
+  }
+  // a paced segment waits until the bucket has refilled past zero
+  if ( pacing_rate() > 0 && !segments_to_sent.empty() && segments_to_sent.top().msg.payload.size() > 0
+       && pacing_credit <= 0 ) {
+    const uint64_t needed = static_cast<uint64_t>( 1 - pacing_credit );
+    const uint64_t wait = ( needed * 1000 + pacing_rate() - 1 ) / pacing_rate();
+    deadline = min( deadline.value_or( wait ), wait );
   }
-  return max_checkpoint;
+  return deadline;
+}
+
+optional<uint64_t> TCPSender::smoothed_rtt() const
+{
+  return srtt;
+}
+
+uint64_t TCPSender::pacing_rate() const
+{
+  if ( !pacing || !srtt.has_value() ) {
+    return 0;
+  }
+  // no congestion window here, so the receive window stands in for cwnd; a sub-millisecond RTT counts as 1 ms
+  return window_size * 1000 / max<uint64_t>( srtt.value(), 1 );
 }
 
 void RetransmissionTimer::elapse( uint64_t time )
@@ -174,4 +452,12 @@ void RetransmissionTimer::restart()
 {
   running = true;
   this->now = 0;
+}
+
+optional<uint64_t> RetransmissionTimer::remaining() const
+{
+  if ( !running ) {
+    return {};
+  }
+  return this->now >= this->rto ? 0 : this->rto - this->now;
 }
\ No newline at end of file
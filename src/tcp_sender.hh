@@ -4,6 +4,7 @@
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 #include <list>
+#include <optional>
 #include <unordered_set>
 #include <vector>
 
@@ -12,6 +13,11 @@ struct Frame
   uint64_t checkpoint {};
   TCPSenderMessage msg;
   bool dont_back_off_rto = false;
+  bool sacked = false; // has the receiver reported holding this segment in a SACK block?
+  bool probe = false;  // is this a PLPMTUD probe, larger than the confirmed segment size?
+  bool retransmitted = false;
+  uint64_t sent_at = 0; // sender's clock when this segment was last sent
+  size_t option_bytes = 0; // TCP options the segment was sized to leave room for
 
   bool operator<( const Frame& rhs ) const { return this->checkpoint < rhs.checkpoint; }
   bool operator>( const Frame& rhs ) const { return this->checkpoint > rhs.checkpoint; }
@@ -30,24 +36,60 @@ public:
   void run();
   void shutdown();
   void restart();
+  std::optional<uint64_t> remaining() const; // ms until expiry, if running
 };
 
 class TCPSender
 {
   Wrap32 isn_;
   uint64_t initial_RTO_ms_;
-  std::list<Frame> segments_outstanding = std::list<Frame>();
+  std::list<Frame> segments_outstanding = std::list<Frame>(); // ordered by checkpoint
   std::priority_queue<Frame, std::vector<Frame>, std::greater<>> segments_to_sent
     = std::priority_queue<Frame, std::vector<Frame>, std::greater<>>();
   bool sync_sent = false;
   bool fin_sent = false;
   Wrap32 zero_point;
   uint64_t checkpoint = 0;
-  uint16_t window_size = 1;
+  uint64_t window_size = 1;
+  uint8_t window_shift = 0; // RFC 7323: left shift applied to the peer's advertised windows
   uint64_t now = 0;
   uint64_t in_flight_cnt = 0;
   uint64_t retransmission_cnt = 0;
   RetransmissionTimer timer = RetransmissionTimer();
+  uint64_t last_ack_no = 0;
+  uint64_t dup_ack_cnt = 0;
+  bool in_fast_recovery = false;
+  uint64_t recover_point = 0; // NewReno: highest sequence number sent when loss recovery began
+  uint64_t high_rxt = 0;      // end of the last segment resent during this recovery
+  size_t max_payload_size;    // payload plus option bytes per segment known to reach the peer (the MSS)
+  size_t option_bytes = 0;    // RFC 6691: TCP options each segment carries, taken out of the MSS
+  size_t probe_limit = 0;     // PLPMTUD: largest payload size still worth probing for
+  bool probe_outstanding = false;
+  bool nagle = false;  // hold back small segments while data is unacknowledged (RFC 896)
+  bool corked = false; // hold back small segments until uncorked
+  std::optional<uint64_t> srtt {}; // smoothed round-trip time in ms (RFC 6298), from segments sent only once
+  uint64_t rttvar = 0;
+  bool pacing = false;
+  int64_t pacing_credit = 0; // token bucket, in bytes, refilled by tick()
+  bool timestamps = false;   // RFC 7323: stamp each segment, and sample the RTT from every ACK's echo
+
+  /* Fold in a round-trip time sample */
+  void update_rtt( uint64_t sample );
+
+  /* Payload bytes that fit in a segment of `segment_size`, after the options */
+  size_t payload_room( size_t segment_size ) const;
+
+  /* Queue an outstanding segment to be sent again; a lost probe is split into segments of the confirmed size */
+  void requeue( Frame frame );
+
+  /* Move the earliest outstanding segment back to the queue of segments to send */
+  void retransmit_earliest();
+
+  /* Mark segments covered by the message's SACK blocks; returns whether any were newly covered */
+  bool update_scoreboard( const TCPReceiverMessage& msg );
+
+  /* During recovery, resend the next segment known to be missing (at `ack_no` or below a SACKed one) */
+  void retransmit_next_hole( uint64_t ack_no );
 
 public:
   /* Construct TCP sender with given default Retransmission Timeout and possible ISN */
@@ -62,14 +104,47 @@ public:
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage send_empty_message() const;
 
-  /* Receive an act on a TCPReceiverMessage from the peer's receiver */
-  void receive( const TCPReceiverMessage& msg );
+  /*
+   * Receive an act on a TCPReceiverMessage from the peer's receiver.
+   * `carries_data` tells whether the segment also carried data; such ACKs never count as duplicates.
+   */
+  void receive( const TCPReceiverMessage& msg, bool carries_data = false );
+
+  /* Scale the peer's later window advertisements by 2^shift, as negotiated in the SYNs (RFC 7323) */
+  void set_window_shift( uint8_t shift );
+
+  /*
+   * Send segments of up to `mss` payload bytes. If `probe_up_to` is larger, occasionally send one bigger
+   * segment as a probe (RFC 4821) and adopt its size once it has been acknowledged.
+   */
+  void set_mss( size_t mss, size_t probe_up_to = 0 );
+
+  /* Size later segments so that their payload plus `bytes` of TCP options fits in the MSS (RFC 6691) */
+  void set_option_length( size_t bytes );
+
+  /* Coalesce small writes: with Nagle while data is in flight, or while corked (until set_cork( false )) */
+  void set_nagle( bool enabled );
+  void set_cork( bool enabled );
+
+  /* Spread segments over the round trip at window/RTT instead of sending each window as a burst */
+  void set_pacing( bool enabled );
+
+  /* Stamp segments with the timestamps option (RFC 7323), as negotiated in the SYNs */
+  void set_timestamps( bool enabled );
 
   /* Time has passed by the given # of milliseconds since the last time the tick() method was called. */
   void tick( uint64_t ms_since_last_tick );
 
+  /* How many ms until tick() next has work to do (a retransmission, or a paced segment to release), if any */
+  std::optional<uint64_t> next_deadline() const;
+
   /* Accessors for use in testing */
   uint64_t sequence_numbers_in_flight() const;  // How many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // How many consecutive *re*transmissions have happened?
   uint64_t max_checkpoint_in_flight() const;
+  uint64_t duplicate_acks() const;              // How many duplicate ACKs have been received in a row?
+  bool in_recovery() const;                     // Is the sender in fast recovery?
+  size_t mss() const;                           // How many payload and option bytes fit in a segment?
+  std::optional<uint64_t> smoothed_rtt() const; // Smoothed round-trip time in ms, once measured
+  uint64_t pacing_rate() const;                 // Bytes per second released while pacing (0 if not pacing)
 };
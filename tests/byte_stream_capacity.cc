@@ -97,6 +97,25 @@ int main()
       test.execute( BytesBuffered { 1 } );
     }
 
+    {
+      ByteStreamTestHarness test { "capacity can grow and shrink to what is buffered", 2 };
+      test.execute( Push { "cat" } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( SetCapacity { 5 } );
+      test.execute( AvailableCapacity { 3 } );
+      test.execute( Push { "tail" } );
+      test.execute( BytesPushed { 5 } );
+      test.execute( Peek { "catai" } );
+      test.execute( Pop { 3 } );
+      test.execute( SetCapacity { 1 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( BytesBuffered { 2 } );
+      test.execute( Pop { 2 } );
+      test.execute( AvailableCapacity { 2 } );
+      test.execute( SetCapacity { 1 } );
+      test.execute( AvailableCapacity { 1 } );
+    }
+
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << endl;
     return EXIT_FAILURE;
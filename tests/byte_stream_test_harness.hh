@@ -55,6 +55,15 @@ struct Pop : public Action<ByteStream>
   void execute( ByteStream& bs ) const override { bs.reader().pop( len_ ); }
 };
 
+struct SetCapacity : public Action<ByteStream>
+{
+  uint64_t capacity_;
+
+  explicit SetCapacity( uint64_t capacity ) : capacity_( capacity ) {}
+  std::string description() const override { return "set_capacity( " + std::to_string( capacity_ ) + " )"; }
+  void execute( ByteStream& bs ) const override { bs.writer().set_capacity( capacity_ ); }
+};
+
 /* expectations */
 
 struct Peek : public Expectation<ByteStream>
@@ -0,0 +1,284 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "socket.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+
+static void expect( bool condition, const string& backend, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( backend + " backend: " + what );
+  }
+}
+
+static pair<LocalStreamSocket, LocalStreamSocket> make_pair_of_sockets()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds.data() ) );
+  return { LocalStreamSocket { FileDescriptor { fds[0] } }, LocalStreamSocket { FileDescriptor { fds[1] } } };
+}
+
+static void test_backend( EventLoop::Backend backend, const string& name )
+{
+  EventLoop loop { backend };
+  const size_t category = loop.add_category( "read" );
+
+  // three readable sockets: poll serves one rule per call, epoll serves all of them
+  vector<pair<LocalStreamSocket, LocalStreamSocket>> pairs;
+  pairs.reserve( 3 );
+  vector<string> received( 3 );
+  vector<bool> cancelled( 3 );
+  vector<EventLoop::RuleHandle> handles;
+  for ( size_t i = 0; i < 3; i++ ) {
+    pairs.push_back( make_pair_of_sockets() );
+    auto& reader = pairs.back().first;
+    handles.push_back( loop.add_rule(
+      category,
+      reader,
+      Direction::In,
+      [&, i] {
+        string data;
+        pairs.at( i ).first.read( data );
+        received.at( i ) += data;
+      },
+      [] { return true; },
+      [&, i] { cancelled.at( i ) = true; } ) );
+  }
+  for ( size_t i = 0; i < 3; i++ ) {
+    pairs.at( i ).second.write( "hello" + to_string( i ) );
+  }
+
+  for ( size_t calls = 0; received.at( 0 ).empty() or received.at( 1 ).empty() or received.at( 2 ).empty(); ) {
+    expect( loop.wait_next_event( 1000 ) == EventLoop::Result::Success, name, "rule was not served" );
+    expect( ++calls <= 3, name, "took more than one call per ready rule" );
+    if ( backend == EventLoop::Backend::Epoll ) {
+      expect( calls == 1, name, "did not serve every ready rule in one call" );
+    }
+  }
+  for ( size_t i = 0; i < 3; i++ ) {
+    expect( received.at( i ) == "hello" + to_string( i ), name, "wrong data received" );
+  }
+
+  // nothing is ready
+  expect( loop.wait_next_event( 0 ) == EventLoop::Result::Timeout, name, "expected a timeout" );
+
+  // a rule cancelled through its handle is dropped without its cancel callback
+  handles.at( 0 ).cancel();
+  pairs.at( 0 ).second.write( "ignored" );
+  expect( loop.wait_next_event( 0 ) == EventLoop::Result::Timeout, name, "cancelled rule was served" );
+  expect( not cancelled.at( 0 ), name, "cancel callback called for a rule cancelled by its handle" );
+
+  // a hangup ends the rule once the data before it has been read
+  pairs.at( 1 ).second.write( "bye" );
+  pairs.at( 1 ).second.close();
+  for ( size_t calls = 0; not cancelled.at( 1 ); calls++ ) {
+    expect( calls < 4, name, "hangup not noticed" );
+    loop.wait_next_event( 0 );
+  }
+  expect( received.at( 1 ) == "hello1bye", name, "data before hangup lost" );
+
+  // an uninterested rule is not served, and the loop exits once no rule is interested
+  bool interested = true;
+  loop.add_rule(
+    category,
+    pairs.at( 2 ).first,
+    Direction::In,
+    [&] {
+      string data;
+      pairs.at( 2 ).first.read( data );
+      received.at( 2 ) += data;
+      interested = false;
+    },
+    [&] { return interested; } );
+  handles.at( 2 ).cancel();
+  pairs.at( 2 ).second.write( "!" );
+  expect( loop.wait_next_event( 1000 ) == EventLoop::Result::Success, name, "interested rule not served" );
+  expect( received.at( 2 ) == "hello2!", name, "wrong data received after replacing a rule" );
+  expect( loop.wait_next_event( 0 ) == EventLoop::Result::Exit, name, "expected exit with no interest" );
+}
+
+// A socket that always has data to read: served on every call, it would starve every rule after it
+static void test_service( EventLoop::Backend backend, const string& name )
+{
+  EventLoop loop { backend, EventLoop::Service::AllReady };
+  auto [busy_reader, busy_writer] = make_pair_of_sockets();
+  auto [quiet_reader, quiet_writer] = make_pair_of_sockets();
+  busy_writer.write( string( 1000, 'x' ) );
+  quiet_writer.write( "hello" );
+
+  // the busy rule reads one byte per callback, up to its budget of 4 callbacks per call
+  const size_t busy = loop.add_category( "busy", 4 );
+  const size_t quiet = loop.add_category( "quiet" );
+  const size_t ticker = loop.add_category( "ticker", 3 );
+  size_t busy_bytes = 0;
+  string quiet_data;
+  size_t ticks = 0;
+  loop.add_rule( busy, busy_reader, Direction::In, [&] {
+    string byte( 1, 0 );
+    busy_reader.read( byte );
+    busy_bytes += byte.size();
+  } );
+  loop.add_rule( quiet, quiet_reader, Direction::In, [&] { quiet_reader.read( quiet_data ); } );
+  loop.add_rule( ticker, [&] { ticks++; }, [&] { return ticks < 10; } );
+
+  expect( loop.wait_next_event( 1000 ) == EventLoop::Result::Success, name, "nothing served" );
+  expect( busy_bytes == 4, name, "busy rule not served up to its budget" );
+  expect( quiet_data == "hello", name, "quiet rule starved" );
+  expect( ticks == 3, name, "non-fd rule not served up to its budget" );
+
+  expect( loop.wait_next_event( 1000 ) == EventLoop::Result::Success, name, "nothing served" );
+  expect( busy_bytes == 8 and ticks == 6, name, "rules not served on the second call" );
+
+  expect( loop.stats( busy ).callbacks == 8 and loop.stats( busy ).waits == 2, name, "wrong stats for busy rule" );
+  expect( loop.stats( quiet ).callbacks == 1 and loop.stats( quiet ).waits == 1, name, "wrong stats for quiet" );
+  expect( loop.stats( ticker ).callbacks == 6 and loop.stats( ticker ).waits == 0, name, "wrong stats for ticker" );
+}
+
+// With Service::OneRule, the poll backend serves the first ready rule per call, and the wait shows in the stats
+static void test_starvation()
+{
+  EventLoop loop;
+  auto [busy_reader, busy_writer] = make_pair_of_sockets();
+  auto [quiet_reader, quiet_writer] = make_pair_of_sockets();
+  busy_writer.write( string( 10, 'x' ) );
+  quiet_writer.write( "hello" );
+
+  const size_t busy = loop.add_category( "busy" );
+  const size_t quiet = loop.add_category( "quiet" );
+  string quiet_data;
+  loop.add_rule( busy, busy_reader, Direction::In, [&] {
+    string byte( 1, 0 );
+    busy_reader.read( byte );
+  } );
+  loop.add_rule( quiet, quiet_reader, Direction::In, [&] { quiet_reader.read( quiet_data ); } );
+
+  for ( size_t i = 0; i < 10; i++ ) {
+    expect( loop.wait_next_event( 1000 ) == EventLoop::Result::Success, "poll", "nothing served" );
+  }
+  expect( quiet_data.empty() and loop.stats( quiet ).callbacks == 0, "poll", "quiet rule served too early" );
+  expect( loop.wait_next_event( 1000 ) == EventLoop::Result::Success, "poll", "nothing served" );
+  expect( quiet_data == "hello", "poll", "quiet rule not served once the busy one ran dry" );
+  expect( loop.stats( quiet ).waits == 1 and loop.stats( quiet ).max_latency >= loop.stats( busy ).max_latency,
+          "poll",
+          "starved rule's latency not reported" );
+}
+
+// Timers fire in deadline order, once each, and bound how long the loop waits for fds
+static void test_timers( EventLoop::Backend backend, const string& name )
+{
+  EventLoop loop { backend, EventLoop::Service::AllReady };
+  const size_t timers = loop.add_category( "timers" );
+  auto [reader, writer] = make_pair_of_sockets();
+  loop.add_rule( loop.add_category( "read" ), reader, Direction::In, [&] {
+    string data;
+    reader.read( data );
+  } );
+
+  vector<int> fired;
+  loop.add_timer( timers, 60, [&] { fired.push_back( 60 ); } );
+  loop.add_timer( timers, 20, [&] { fired.push_back( 20 ); } );
+  auto cancelled = loop.add_timer( timers, 40, [&] { fired.push_back( 40 ); } );
+  loop.add_timer( timers, 600, [&] { fired.push_back( 600 ); } ); // on the wheel's next turn
+  cancelled.cancel();
+
+  // with no fd ready, each call returns when the next timer is due, well before the timeout
+  const auto start = chrono::steady_clock::now();
+  while ( fired.size() < 3 ) {
+    expect( loop.wait_next_event( 5000 ) == EventLoop::Result::Success, name, "timer did not end the wait" );
+  }
+  const auto elapsed = chrono::steady_clock::now() - start;
+  expect( fired == vector<int> { 20, 60, 600 }, name, "timers fired out of order or after cancel" );
+  expect( elapsed >= chrono::milliseconds( 600 ) and elapsed < chrono::seconds( 5 ), name, "timers fired late" );
+  expect( loop.stats( timers ).callbacks == 3, name, "wrong stats for timers" );
+
+  // nothing armed: the wait runs to its timeout
+  expect( loop.wait_next_event( 10 ) == EventLoop::Result::Timeout, name, "expected a timeout" );
+
+  // a timer added by a timer's callback fires on a later call
+  loop.add_timer( timers, 0, [&] { loop.add_timer( timers, 0, [&] { fired.push_back( 0 ); } ); } );
+  expect( loop.wait_next_event( 1000 ) == EventLoop::Result::Success, name, "zero-delay timer not fired" );
+  for ( size_t calls = 0; fired.size() < 4 and calls < 10; calls++ ) {
+    loop.wait_next_event( 1000 );
+  }
+  expect( fired.back() == 0, name, "timer added by a callback never fired" );
+}
+
+// The epoll backend evaluates an idle rule's interest once, and a changed interest only when told
+static void test_recheck_interest()
+{
+  EventLoop loop { EventLoop::Backend::Epoll, EventLoop::Service::AllReady };
+  const size_t category = loop.add_category( "read" );
+
+  vector<pair<LocalStreamSocket, LocalStreamSocket>> idle;
+  idle.reserve( 100 );
+  size_t idle_checks = 0;
+  for ( size_t i = 0; i < 100; i++ ) {
+    idle.push_back( make_pair_of_sockets() );
+    loop.add_rule( category, idle.back().first, Direction::In, [] {}, [&] { return ++idle_checks > 0; } );
+  }
+
+  auto [reader, writer] = make_pair_of_sockets();
+  writer.write( "hello" );
+  bool open = false;
+  string data;
+  auto gated = loop.add_rule( category, reader, Direction::In, [&] { reader.read( data ); }, [&] { return open; } );
+
+  for ( size_t i = 0; i < 10; i++ ) {
+    expect( loop.wait_next_event( 0 ) == EventLoop::Result::Timeout, "epoll", "uninterested rule was served" );
+  }
+  expect( idle_checks == 100, "epoll", "idle rules' interest evaluated on every call" );
+
+  open = true;
+  gated.recheck_interest();
+  expect( loop.wait_next_event( 1000 ) == EventLoop::Result::Success, "epoll", "rechecked rule was not served" );
+  expect( data == "hello", "epoll", "wrong data received after recheck" );
+  expect( idle_checks == 100, "epoll", "idle rules' interest evaluated for another rule's recheck" );
+}
+
+// A pending timer keeps the loop going even when no fd rule is interested
+static void test_timer_exit()
+{
+  EventLoop loop;
+  auto [reader, writer] = make_pair_of_sockets();
+  bool done = false;
+  loop.add_rule( loop.add_category( "read" ), reader, Direction::In, [] {}, [&] { return not done; } );
+  done = true;
+
+  bool fired = false;
+  const size_t timer = loop.add_category( "timer" );
+  loop.add_timer( timer, 10, [&] { fired = true; } );
+  expect( loop.wait_next_event( -1 ) == EventLoop::Result::Success and fired, "poll", "timer did not fire" );
+  expect( loop.wait_next_event( 0 ) == EventLoop::Result::Exit, "poll", "expected exit once the timer fired" );
+
+  loop.add_timer( timer, 10, [&] { fired = false; } ).cancel();
+  expect( loop.wait_next_event( -1 ) == EventLoop::Result::Exit and fired, "poll", "cancelled timer kept loop" );
+}
+
+int main()
+{
+  try {
+    test_backend( EventLoop::Backend::Poll, "poll" );
+    test_backend( EventLoop::Backend::Epoll, "epoll" );
+    test_service( EventLoop::Backend::Poll, "poll" );
+    test_service( EventLoop::Backend::Epoll, "epoll" );
+    test_starvation();
+    test_recheck_interest();
+    test_timers( EventLoop::Backend::Poll, "poll" );
+    test_timers( EventLoop::Backend::Epoll, "epoll" );
+    test_timer_exit();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
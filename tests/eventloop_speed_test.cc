@@ -0,0 +1,88 @@
+#include "eventloop.hh"
+#include "exception.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static FileDescriptor make_eventfd()
+{
+  return FileDescriptor { CheckSystemCall( "eventfd", ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) };
+}
+
+// `idle` fds that never become readable, and `active` fds that each become readable once per round
+static void serve( EventLoop::Backend backend,
+                   EventLoop::Service service,
+                   const string& label,
+                   size_t idle,
+                   size_t active,
+                   size_t rounds )
+{
+  EventLoop loop { backend, service };
+  vector<FileDescriptor> fds;
+  fds.reserve( idle + active ); // the callbacks refer to their fds
+  const size_t category = loop.add_category( "eventfd" );
+  size_t served = 0;
+  for ( size_t i = 0; i < idle + active; i++ ) {
+    fds.push_back( make_eventfd() );
+    loop.add_rule( category, fds.back(), Direction::In, [&served, &fd = fds.back()] {
+      string counter( sizeof( uint64_t ), 0 );
+      fd.read( counter );
+      served++;
+    } );
+  }
+
+  const uint64_t one = 1;
+  size_t waits = 0;
+  const auto start = steady_clock::now();
+  for ( size_t round = 0; round < rounds; round++ ) {
+    for ( size_t i = idle; i < idle + active; i++ ) {
+      CheckSystemCall( "write", ::write( fds.at( i ).fd_num(), &one, sizeof( one ) ) );
+    }
+    while ( served < ( round + 1 ) * active ) {
+      if ( loop.wait_next_event( -1 ) != EventLoop::Result::Success ) {
+        throw runtime_error( "EventLoop stopped serving" );
+      }
+      waits++;
+    }
+  }
+  const double seconds = duration_cast<duration<double>>( steady_clock::now() - start ).count();
+
+  cout << "EventLoop (" << label << ", " << idle << " idle + " << active << " active fds): " << fixed
+       << setprecision( 2 ) << static_cast<double>( served ) / seconds / 1e3 << " k events/s, "
+       << static_cast<double>( served ) / static_cast<double>( waits ) << " events per wait.\n";
+}
+
+void program_body()
+{
+  using enum EventLoop::Backend;
+  using enum EventLoop::Service;
+  serve( Poll, OneRule, "poll", 10'000, 100, 20 );
+  serve( Poll, AllReady, "poll, all ready", 10'000, 100, 2000 );
+  serve( Epoll, AllReady, "epoll", 10'000, 100, 2000 );
+  serve( Poll, OneRule, "poll", 0, 100, 2000 );
+  serve( Poll, AllReady, "poll, all ready", 0, 100, 2000 );
+  serve( Epoll, AllReady, "epoll", 0, 100, 2000 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+#include "buffer.hh"
+#include "byte_stream.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "reassembler.hh"
+
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+int main()
+{
+  try {
+    PacketPool& pool = PacketPool::local();
+
+    // a slab given back is handed out again, with its storage intact
+    string slab = pool.take( 1500 );
+    expect( slab.empty() and slab.capacity() == PacketPool::MTU_SLAB, "MTU-sized request did not get an MTU slab" );
+    const char* const storage = slab.data();
+    pool.give( move( slab ) );
+    string again = pool.take( 100 );
+    expect( again.data() == storage, "slab was not reused" );
+    expect( pool.stats().requests == 2 and pool.stats().hits == 1, "wrong request and hit counts" );
+
+    // a Buffer holding a slab gives it back when its last copy goes away
+    again.assign( 1000, 'x' );
+    {
+      const Buffer first { move( again ) };
+      const Buffer second = first.substr( 10 );
+      expect( pool.stats().in_use == 1, "slab not counted as in use" );
+    }
+    expect( pool.stats().in_use == 0, "Buffer did not give back its slab" );
+    expect( pool.take( PacketPool::MTU_SLAB ).data() == storage, "slab from Buffer was not reused" );
+
+    // a short payload is kept inline, and its slab goes straight back
+    string short_payload = pool.take( PacketPool::JUMBO_SLAB );
+    short_payload = "hello";
+    const Buffer inline_buffer { move( short_payload ) };
+    expect( string_view { inline_buffer } == "hello", "inline Buffer has the wrong contents" );
+    expect( pool.stats().in_use == 1 and pool.stats().peak_in_use == 2, "wrong in-use counts" );
+
+    // larger requests are not pooled
+    expect( pool.take( 100'000 ).capacity() >= 100'000, "oversized request not satisfied" );
+    expect( pool.stats().requests == 4, "oversized request counted as a pool request" );
+
+    // reads from a FileDescriptor land in slabs, which come back once the Buffers are gone
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+    FileDescriptor reader { fds[0] };
+    FileDescriptor writer { fds[1] };
+    const uint64_t hits_before = pool.stats().hits;
+    for ( size_t i = 0; i < 10; i++ ) {
+      writer.write( string( 1000, 'y' ) );
+      vector<string> strs( 1 );
+      reader.read( strs );
+      const Buffer datagram { move( strs.front() ) };
+      expect( datagram.size() == 1000, "read the wrong number of bytes" );
+    }
+    expect( pool.stats().hits - hits_before >= 9, "reads did not reuse slabs" );
+
+    // a datagram that fits goes in an MTU slab; a longer one is gathered into a jumbo slab
+    for ( const size_t size : { PacketPool::MTU_SLAB, PacketPool::MTU_SLAB + 1, size_t { 9000 } } ) {
+      string sent( size, 0 );
+      for ( size_t i = 0; i < size; i++ ) {
+        sent[i] = static_cast<char>( i * 7 );
+      }
+      writer.write( sent );
+      vector<string> strs( 2 );
+      strs.front().resize( 20 );
+      reader.read( strs );
+      expect( strs.front() + strs.back() == sent, "read the wrong bytes" );
+      const size_t expected = size - 20 <= PacketPool::MTU_SLAB ? PacketPool::MTU_SLAB : PacketPool::JUMBO_SLAB;
+      expect( strs.back().capacity() == expected, "datagram of " + to_string( size ) + " bytes in the wrong slab" );
+    }
+
+    // a change made through std::string& is never seen through a copy, whether the bytes are inline or not
+    for ( const size_t size : { size_t { 10 }, Buffer::INLINE_CAPACITY + 1, size_t { 1000 } } ) {
+      Buffer original { string( size, 'a' ) };
+      const Buffer copy = original;
+      static_cast<string&>( original ).front() = 'b';
+      expect( string_view { copy } == string( size, 'a' ), "change made through a Buffer showed in its copy" );
+      expect( string_view { original }.front() == 'b', "change made through a Buffer was lost" );
+    }
+
+    // a short payload read into a jumbo slab is copied out when a ByteStream or a Reassembler holds on to it, so
+    // the slab goes back to the pool; a payload that fills most of its string is kept as it is
+    {
+      const size_t in_use_before = pool.stats().in_use;
+      string in_order = pool.take( PacketPool::JUMBO_SLAB );
+      in_order.assign( 1000, 's' );
+      string out_of_order = pool.take( PacketPool::JUMBO_SLAB );
+      out_of_order.assign( 8000, 'o' );
+      expect( pool.stats().in_use == in_use_before + 2, "slabs not counted as in use" );
+
+      ByteStream stream { 100'000 };
+      Reassembler reassembler;
+      reassembler.insert( 0, Buffer { move( in_order ) }.substr( 0, 600 ), false, stream.writer() );
+      reassembler.insert( 5000, Buffer { string { "tail" } }, false, stream.writer() );
+      reassembler.insert( 4600, Buffer { move( out_of_order ) }.substr( 100, 400 ), false, stream.writer() );
+      expect( pool.stats().in_use == in_use_before, "a short payload kept its slab" );
+
+      Buffer kept { string( 8000, 'k' ) };
+      const char* const kept_data = string_view { kept }.data();
+      kept.compact();
+      expect( string_view { kept }.data() == kept_data, "a payload filling most of its string was copied" );
+
+      reassembler.insert( 600, Buffer { string( 4000, 'm' ) }, false, stream.writer() );
+      expect( stream.reader().bytes_buffered() == 5004, "compacted payloads lost bytes" );
+      expect( stream.reader().peek() == string( 600, 's' ), "compacted payload has the wrong bytes" );
+    }
+
+    // each thread has its own pool
+    thread other { [] { expect( PacketPool::local().stats().requests == 0, "pool shared between threads" ); } };
+    other.join();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+#include "arp_message.hh"
+#include "ethernet_header.hh"
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Run `body` many times and report how many times per second it ran
+template<typename F>
+static void rate( const string& name, F&& body )
+{
+  constexpr size_t repetitions = 1'000'000;
+  const auto start = steady_clock::now();
+  for ( size_t i = 0; i < repetitions; i++ ) {
+    body();
+  }
+  const double seconds = duration_cast<duration<double>>( steady_clock::now() - start ).count();
+  cout << left << setw( 32 ) << name << right << fixed << setprecision( 2 ) << setw( 6 )
+       << static_cast<double>( repetitions ) / seconds / 1e6 << " M/s\n";
+}
+
+// Join serialized Buffers into one, as an object arrives from the network
+static vector<Buffer> contiguous( const vector<Buffer>& buffers )
+{
+  string joined;
+  for ( const auto& buffer : buffers ) {
+    joined.append( buffer );
+  }
+  return { joined };
+}
+
+// The IPv4 header read and written field by field through the byte stream, as before wire::Layout, for comparison
+static void byte_stream_parse( IPv4Header& header, Parser& parser )
+{
+  uint8_t first_byte {};
+  parser.integer( first_byte );
+  header.ver = first_byte >> 4;
+  header.hlen = first_byte & 0x0f;
+  parser.integer( header.tos );
+  parser.integer( header.len );
+  parser.integer( header.id );
+  uint16_t fo_val {};
+  parser.integer( fo_val );
+  header.df = static_cast<bool>( fo_val & 0x4000 );
+  header.mf = static_cast<bool>( fo_val & 0x2000 );
+  header.offset = fo_val & 0x1fff;
+  parser.integer( header.ttl );
+  parser.integer( header.proto );
+  parser.integer( header.cksum );
+  parser.integer( header.src );
+  parser.integer( header.dst );
+}
+
+static void byte_stream_serialize( const IPv4Header& header, Serializer& serializer )
+{
+  const uint8_t first_byte = ( static_cast<uint32_t>( header.ver ) << 4 ) | ( header.hlen & 0xfU );
+  serializer.integer( first_byte );
+  serializer.integer( header.tos );
+  serializer.integer( header.len );
+  serializer.integer( header.id );
+  const uint16_t fo_val = ( header.df ? 0x4000U : 0 ) | ( header.mf ? 0x2000U : 0 ) | ( header.offset & 0x1fffU );
+  serializer.integer( fo_val );
+  serializer.integer( header.ttl );
+  serializer.integer( header.proto );
+  serializer.integer( header.cksum );
+  serializer.integer( header.src );
+  serializer.integer( header.dst );
+}
+
+void program_body()
+{
+  IPv4Header header;
+  header.len = 1040;
+  header.src = 0x0a000001;
+  header.dst = 0x0a000002;
+  header.compute_checksum();
+
+  TCPSegment seg;
+  seg.udinfo.src_port = 10000;
+  seg.udinfo.dst_port = 80;
+  seg.sender_message.seqno = Wrap32 { 12345 };
+  seg.sender_message.payload = string( 1000, 'x' );
+  seg.sender_message.timestamp = 1;
+  seg.receiver_message.ackno = Wrap32 { 1000 };
+  seg.receiver_message.window_size = 65535;
+  seg.receiver_message.timestamp_echo = 2;
+  seg.compute_checksum( header.pseudo_checksum() );
+
+  EthernetHeader frame_header { { 1, 2, 3, 4, 5, 6 }, { 7, 8, 9, 10, 11, 12 }, EthernetHeader::TYPE_IPv4 };
+
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = frame_header.src;
+  arp.sender_ip_address = header.src;
+  arp.target_ethernet_address = frame_header.dst;
+  arp.target_ip_address = header.dst;
+
+  size_t total = 0;
+  rate( "EthernetHeader serialize", [&] { total += serialize( frame_header ).size(); } );
+
+  const vector<Buffer> frame_header_wire = serialize( frame_header );
+  rate( "EthernetHeader parse", [&] {
+    EthernetHeader parsed {};
+    if ( not parse( parsed, frame_header_wire ) ) {
+      throw runtime_error( "EthernetHeader did not parse" );
+    }
+    total += parsed.type;
+  } );
+
+  rate( "ARPMessage serialize", [&] { total += serialize( arp ).size(); } );
+
+  const vector<Buffer> arp_wire = serialize( arp );
+  rate( "ARPMessage parse", [&] {
+    ARPMessage parsed;
+    if ( not parse( parsed, arp_wire ) ) {
+      throw runtime_error( "ARPMessage did not parse" );
+    }
+    total += parsed.opcode;
+  } );
+
+  rate( "IPv4Header serialize", [&] { total += serialize( header ).size(); } );
+
+  const vector<Buffer> header_wire = contiguous( serialize( header ) );
+  rate( "IPv4Header parse", [&] {
+    IPv4Header parsed;
+    if ( not parse( parsed, header_wire ) ) {
+      throw runtime_error( "IPv4Header did not parse" );
+    }
+    total += parsed.len;
+  } );
+
+  // a round trip of just the header fields, without the checksum verification
+  rate( "IPv4 fields, byte stream", [&] {
+    Serializer serializer;
+    byte_stream_serialize( header, serializer );
+    Parser parser { serializer.output() };
+    IPv4Header parsed;
+    byte_stream_parse( parsed, parser );
+    total += parsed.len;
+  } );
+  rate( "IPv4 fields, wire::Layout", [&] {
+    Serializer serializer;
+    IPv4Header::Layout::serialize( serializer, header );
+    Parser parser { serializer.output() };
+    IPv4Header parsed;
+    IPv4Header::Layout::parse( parser, parsed );
+    total += parsed.len;
+  } );
+
+  rate( "TCPSegment serialize", [&] { total += serialize( seg ).size(); } );
+
+  const vector<Buffer> seg_wire = contiguous( serialize( seg ) );
+  rate( "TCPSegment parse", [&] {
+    TCPSegment parsed;
+    if ( not parse( parsed, seg_wire, header.pseudo_checksum() ) ) {
+      throw runtime_error( "TCPSegment did not parse" );
+    }
+    total += parsed.sender_message.payload.size();
+  } );
+
+  // as read from a TUN device, with the first 20 bytes in a buffer of their own
+  const string seg_joined { seg_wire.front() };
+  const vector<Buffer> seg_fragments { seg_joined.substr( 0, 20 ), seg_joined.substr( 20 ) };
+  rate( "TCPSegment parse, 2 fragments", [&] {
+    TCPSegment parsed;
+    if ( not parse( parsed, seg_fragments, header.pseudo_checksum() ) ) {
+      throw runtime_error( "TCPSegment did not parse" );
+    }
+    total += parsed.sender_message.payload.size();
+  } );
+
+  TCPSegment ack = seg;
+  ack.sender_message.payload = {};
+  ack.compute_checksum( header.pseudo_checksum() );
+  const vector<Buffer> ack_wire = contiguous( serialize( ack ) );
+  rate( "TCPSegment parse, bare ACK", [&] {
+    TCPSegment parsed;
+    if ( not parse( parsed, ack_wire, header.pseudo_checksum() ) ) {
+      throw runtime_error( "TCPSegment did not parse" );
+    }
+    total += parsed.receiver_message.window_size;
+  } );
+  rate( "TCPSegmentView decode, bare ACK", [&] {
+    TCPSegment parsed;
+    if ( not TCPSegmentView { ack_wire, header.pseudo_checksum() }.decode( parsed ) ) {
+      throw runtime_error( "TCPSegment did not decode" );
+    }
+    total += parsed.receiver_message.window_size;
+  } );
+  rate( "TCPSegmentView ports, bare ACK", [&] {
+    const TCPSegmentView view { ack_wire, header.pseudo_checksum() };
+    if ( not view.valid() ) {
+      throw runtime_error( "TCPSegment was not valid" );
+    }
+    total += view.dst_port();
+  } );
+
+  if ( total == 0 ) {
+    throw runtime_error( "nothing was serialized or parsed" );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -8,6 +8,7 @@
 #include <optional>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 using ReceiverSet = std::pair<StreamAndReassembler, TCPReceiver>;
 
@@ -49,6 +50,18 @@ public:
   using TestHarness<ReceiverSet>::execute;
 };
 
+struct SetWindowShift : public Action<ReceiverSet>
+{
+  uint8_t shift_;
+
+  explicit SetWindowShift( uint8_t shift ) : shift_( shift ) {}
+  std::string description() const override
+  {
+    return "window scale negotiated with shift " + std::to_string( shift_ );
+  }
+  void execute( ReceiverSet& rs ) const override { rs.second.set_window_shift( shift_ ); }
+};
+
 struct ExpectWindow : public ExpectNumber<ReceiverSet, uint16_t>
 {
   using ExpectNumber::ExpectNumber;
@@ -94,6 +107,45 @@ struct ExpectAcknoBetween : public Expectation<ReceiverSet>
   }
 };
 
+struct ExpectSackBlocks : public Expectation<ReceiverSet>
+{
+  std::vector<std::pair<Wrap32, Wrap32>> blocks_;
+
+  explicit ExpectSackBlocks( std::vector<std::pair<Wrap32, Wrap32>> blocks ) : blocks_( std::move( blocks ) ) {}
+
+  static std::string to_string( const std::vector<std::pair<Wrap32, Wrap32>>& blocks )
+  {
+    std::ostringstream ss;
+    ss << "[";
+    for ( const auto& [left, right] : blocks ) {
+      ss << " " << left << "-" << right;
+    }
+    ss << " ]";
+    return ss.str();
+  }
+
+  std::string description() const override { return "SACK blocks = " + to_string( blocks_ ); }
+
+  void execute( ReceiverSet& rs ) const override
+  {
+    const auto blocks = rs.second.send( rs.first.first.writer() ).sack_blocks;
+    if ( blocks != blocks_ ) {
+      throw ExpectationViolation( "The TCPReceiver should have sent SACK blocks " + to_string( blocks_ )
+                                  + ", but instead it sent " + to_string( blocks ) + "." );
+    }
+  }
+};
+
+struct ExpectTimestampEcho : public ExpectNumber<ReceiverSet, std::optional<uint32_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "timestamp_echo"; }
+  std::optional<uint32_t> value( ReceiverSet& rs ) const override
+  {
+    return rs.second.send( rs.first.first.writer() ).timestamp_echo;
+  }
+};
+
 struct HasAckno : public ExpectBool<ReceiverSet>
 {
   using ExpectBool::ExpectBool;
@@ -115,6 +167,12 @@ struct SegmentArrives : public Action<ReceiverSet>
     return *this;
   }
 
+  SegmentArrives& with_sack_permitted()
+  {
+    msg_.sack_permitted = true;
+    return *this;
+  }
+
   SegmentArrives& with_fin()
   {
     msg_.FIN = true;
@@ -135,6 +193,12 @@ struct SegmentArrives : public Action<ReceiverSet>
     return *this;
   }
 
+  SegmentArrives& with_timestamp( uint32_t tsval )
+  {
+    msg_.timestamp = tsval;
+    return *this;
+  }
+
   SegmentArrives& without_ackno()
   {
     ackno_expected_ = HasAckno { false };
@@ -155,12 +219,18 @@ struct SegmentArrives : public Action<ReceiverSet>
     if ( msg_.SYN ) {
       ss << " +SYN";
     }
+    if ( msg_.sack_permitted ) {
+      ss << " +SACK-permitted";
+    }
     if ( not msg_.payload.empty() ) {
       ss << " payload=\"" << Printer::prettify( msg_.payload ) << "\"";
     }
     if ( msg_.FIN ) {
       ss << " +FIN";
     }
+    if ( msg_.timestamp.has_value() ) {
+      ss << " tsval=" << msg_.timestamp.value();
+    }
     ss << ")";
 
     if ( ackno_expected_.value_ ) {
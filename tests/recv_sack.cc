@@ -0,0 +1,81 @@
+#include "random.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "out-of-order data is reported in SACK blocks", 2358 };
+      test.execute( SegmentArrives {}.with_syn().with_sack_permitted().with_seqno( isn ) );
+      test.execute( ExpectSackBlocks { {} } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efgh" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 1 } } );
+      test.execute( ExpectSackBlocks { { { Wrap32 { isn + 5 }, Wrap32 { isn + 9 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 13 ).with_data( "mnop" ) );
+      test.execute( ExpectSackBlocks {
+        { { Wrap32 { isn + 13 }, Wrap32 { isn + 17 } }, { Wrap32 { isn + 5 }, Wrap32 { isn + 9 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 9 ).with_data( "ijkl" ) );
+      test.execute( ExpectSackBlocks { { { Wrap32 { isn + 5 }, Wrap32 { isn + 17 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abcd" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 17 } } );
+      test.execute( ExpectSackBlocks { {} } );
+      test.execute( ReadAll { "abcdefghijklmnop" } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "no SACK blocks unless the SYN permitted them", 2358 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efgh" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 1 } } );
+      test.execute( BytesPending { 4 } );
+      test.execute( ExpectSackBlocks { {} } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "most recent block first, then recently reported ones", 2358 };
+      test.execute( SegmentArrives {}.with_syn().with_sack_permitted().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "e" ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 13 ).with_data( "m" ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 21 ).with_data( "u" ) );
+      test.execute( ExpectSackBlocks { { { Wrap32 { isn + 21 }, Wrap32 { isn + 22 } },
+                                         { Wrap32 { isn + 13 }, Wrap32 { isn + 14 } },
+                                         { Wrap32 { isn + 5 }, Wrap32 { isn + 6 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 13 ).with_data( "m" ) );
+      test.execute( ExpectSackBlocks { { { Wrap32 { isn + 13 }, Wrap32 { isn + 14 } },
+                                         { Wrap32 { isn + 21 }, Wrap32 { isn + 22 } },
+                                         { Wrap32 { isn + 5 }, Wrap32 { isn + 6 } } } } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "at most four SACK blocks", 2358 };
+      test.execute( SegmentArrives {}.with_syn().with_sack_permitted().with_seqno( isn ) );
+      for ( uint32_t i = 1; i <= 5; i++ ) {
+        test.execute( SegmentArrives {}.with_seqno( isn + 1 + 2 * i ).with_data( "x" ) );
+      }
+      test.execute( ExpectSackBlocks { { { Wrap32 { isn + 11 }, Wrap32 { isn + 12 } },
+                                         { Wrap32 { isn + 9 }, Wrap32 { isn + 10 } },
+                                         { Wrap32 { isn + 7 }, Wrap32 { isn + 8 } },
+                                         { Wrap32 { isn + 5 }, Wrap32 { isn + 6 } } } } );
+      test.execute( BytesPending { 5 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#include "random.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "the latest timestamp is echoed", 4000 };
+      test.execute( ExpectTimestampEcho { optional<uint32_t> {} } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_timestamp( 100 ) );
+      test.execute( ExpectTimestampEcho { 100 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_timestamp( 105 ) );
+      test.execute( ExpectTimestampEcho { 105 } );
+      test.execute( ExpectAckno { Wrap32 { isn + 4 } } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "no echo without timestamps", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectTimestampEcho { optional<uint32_t> {} } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "no PAWS unless the SYN carried a timestamp", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_timestamp( 200 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ).with_timestamp( 150 ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 7 } } );
+      test.execute( ExpectTimestampEcho { optional<uint32_t> {} } );
+      test.execute( ReadAll { "abcdef" } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "PAWS drops an old duplicate that looks in order", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_timestamp( 100 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_timestamp( 200 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "xyz" ).with_timestamp( 150 ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 4 } } );
+      test.execute( ExpectTimestampEcho { 200 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ).with_timestamp( 200 ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 7 } } );
+      test.execute( ReadAll { "abcdef" } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "PAWS drops out-of-order data too", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_timestamp( 100 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efg" ).with_timestamp( 99 ) );
+      test.execute( BytesPending { 0 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efg" ).with_timestamp( 101 ) );
+      test.execute( BytesPending { 3 } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "out-of-order segments don't update the echoed timestamp", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_timestamp( 100 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efg" ).with_timestamp( 300 ) );
+      test.execute( ExpectTimestampEcho { 100 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abcd" ).with_timestamp( 250 ) );
+      test.execute( ExpectTimestampEcho { 250 } );
+      test.execute( ExpectAckno { Wrap32 { isn + 8 } } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      const uint32_t ts = UINT32_MAX - 5;
+      TCPReceiverTestHarness test { "timestamps are compared modulo 2^32", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_timestamp( ts ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_timestamp( ts + 10 ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 4 } } );
+      test.execute( ExpectTimestampEcho { ts + 10 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ).with_timestamp( ts ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 4 } } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
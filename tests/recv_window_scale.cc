@@ -0,0 +1,53 @@
+#include "random.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "window beyond 64 KiB is advertised scaled", 1 << 20 };
+      test.execute( ExpectWindow { UINT16_MAX } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SetWindowShift { 5 } );
+      test.execute( ExpectWindow { ( 1 << 20 ) >> 5 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 100, 'x' ) ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 101 } } );
+      test.execute( ExpectWindow { ( ( 1 << 20 ) - 100 ) >> 5 } );
+      test.execute( ReadAll { string( 100, 'x' ) } );
+      test.execute( ExpectWindow { ( 1 << 20 ) >> 5 } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "scaled window rounds down", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SetWindowShift { 3 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectWindow { 3997 >> 3 } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "scaled window still clamps at 16 bits", 1 << 30 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SetWindowShift { 2 } );
+      test.execute( ExpectWindow { UINT16_MAX } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
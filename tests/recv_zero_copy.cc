@@ -0,0 +1,273 @@
+#include "byte_stream.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "parser.hh"
+#include "random.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_receiver.hh"
+#include "tcp_segment.hh"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Serialize a segment into one contiguous datagram, as it would arrive from the network
+static Buffer datagram( TCPSenderMessage msg )
+{
+  TCPSegment seg;
+  seg.sender_message = move( msg );
+  seg.compute_checksum( 0 );
+  string wire;
+  for ( const auto& piece : serialize( seg ) ) {
+    wire.append( piece );
+  }
+  return wire;
+}
+
+static TCPSenderMessage parse_datagram( const Buffer& dgram )
+{
+  TCPSegment seg;
+  if ( not parse( seg, { dgram }, uint32_t { 0 } ) ) {
+    throw runtime_error( "datagram did not parse" );
+  }
+  return move( seg.sender_message );
+}
+
+static void expect_inside( string_view view, const Buffer& dgram, const string& what )
+{
+  const string_view whole { dgram };
+  if ( view.empty() or view.data() < whole.data() or view.data() + view.size() > whole.data() + whole.size() ) {
+    throw runtime_error( what + " was copied out of the datagram it arrived in" );
+  }
+}
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const Wrap32 isn { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+      const Buffer dgram = datagram( { isn + 1, false, string( 1000, 'x' ), false } );
+      const TCPSenderMessage msg = parse_datagram( dgram );
+      if ( msg.payload.size() != 1000 ) {
+        throw runtime_error( "parsed payload has the wrong size" );
+      }
+      expect_inside( msg.payload, dgram, "parsed payload" );
+    }
+
+    {
+      const Wrap32 isn { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+      TCPReceiver receiver;
+      Reassembler reassembler;
+      ByteStream stream { 4000 };
+      receiver.receive( { isn, true, {}, false }, reassembler, stream.writer() );
+
+      vector<Buffer> dgrams;
+      for ( size_t i = 0; i < 3; i++ ) {
+        const string payload( 1000, static_cast<char>( 'a' + i ) );
+        dgrams.push_back( datagram( { isn + 1 + i * 1000, false, payload, false } ) );
+        receiver.receive( parse_datagram( dgrams.back() ), reassembler, stream.writer() );
+      }
+      for ( const auto& dgram : dgrams ) {
+        expect_inside( stream.reader().peek(), dgram, "in-order payload" );
+        stream.reader().pop( 1000 );
+      }
+    }
+
+    {
+      const Wrap32 isn { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+      TCPReceiver receiver;
+      Reassembler reassembler;
+      ByteStream stream { 4000 };
+      receiver.receive( { isn, true, {}, false }, reassembler, stream.writer() );
+
+      // out of order and overlapping: each byte is written from the first segment that carried it
+      const Buffer third = datagram( { isn + 501, false, string( 500, 'c' ), false } );
+      receiver.receive( parse_datagram( third ), reassembler, stream.writer() );
+      const Buffer second = datagram( { isn + 251, false, string( 250, 'b' ) + string( 250, 'c' ), false } );
+      receiver.receive( parse_datagram( second ), reassembler, stream.writer() );
+      if ( stream.reader().bytes_buffered() != 0 or reassembler.bytes_pending() != 750 ) {
+        throw runtime_error( "Reassembler held back the wrong bytes" );
+      }
+      const Buffer first = datagram( { isn + 1, false, string( 500, 'a' ), false } );
+      receiver.receive( parse_datagram( first ), reassembler, stream.writer() );
+      if ( stream.reader().bytes_buffered() != 1000 or reassembler.bytes_pending() != 0 ) {
+        throw runtime_error( "Reassembler did not release the held-back bytes" );
+      }
+      for ( const auto& [dgram, len] : { pair { first, 250 }, pair { second, 250 }, pair { third, 500 } } ) {
+        expect_inside( stream.reader().peek(), dgram, "reassembled payload" );
+        if ( stream.reader().peek().size() != static_cast<size_t>( len ) ) {
+          throw runtime_error( "reassembled payload has the wrong size" );
+        }
+        stream.reader().pop( len );
+      }
+    }
+
+    {
+      // full-sized segments read from a file descriptor into pool slabs stay in those slabs, both in order and
+      // after waiting in the Reassembler
+      array<int, 2> fds {};
+      CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+      FileDescriptor network { fds[0] };
+      FileDescriptor host { fds[1] };
+      const auto read_datagram = [&]( TCPSenderMessage msg ) {
+        host.write( string_view { datagram( move( msg ) ) } );
+        vector<string> strs( 1 );
+        network.read( strs );
+        return Buffer { move( strs.front() ) };
+      };
+
+      const Wrap32 isn { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+      TCPReceiver receiver;
+      Reassembler reassembler;
+      ByteStream stream { 10000 };
+      receiver.receive( { isn, true, {}, false }, reassembler, stream.writer() );
+
+      const Buffer later = read_datagram( { isn + 1461, false, string( 1000, 'l' ), false } );
+      receiver.receive( parse_datagram( later ), reassembler, stream.writer() );
+      const Buffer first = read_datagram( { isn + 1, false, string( 1460, 'f' ), false } );
+      receiver.receive( parse_datagram( first ), reassembler, stream.writer() );
+      if ( stream.reader().bytes_buffered() != 2460 ) {
+        throw runtime_error( "segments read from a file descriptor were not reassembled" );
+      }
+      expect_inside( stream.reader().peek(), first, "payload read from a file descriptor" );
+      stream.reader().pop( 1460 );
+      expect_inside( stream.reader().peek(), later, "reassembled payload read from a file descriptor" );
+    }
+
+    {
+      // a segment split across fragments, with its header straddling the first two
+      TCPSegment seg;
+      seg.udinfo.src_port = 1234;
+      seg.udinfo.dst_port = 80;
+      seg.sender_message.seqno = Wrap32 { 77 };
+      seg.sender_message.payload = string( 1000, 'p' );
+      seg.sender_message.timestamp = 5;
+      seg.receiver_message.ackno = Wrap32 { 99 };
+      seg.receiver_message.window_size = 1000;
+      seg.receiver_message.timestamp_echo = 6;
+      seg.compute_checksum( 0 );
+      string joined;
+      for ( const auto& piece : serialize( seg ) ) {
+        joined.append( piece );
+      }
+      const vector<Buffer> fragments { joined.substr( 0, 10 ), joined.substr( 10, 490 ), joined.substr( 500 ) };
+
+      const TCPSegmentView view { fragments, 0 };
+      if ( not view.valid() or view.header_length() != 32 ) {
+        throw runtime_error( "fragmented segment was not valid" );
+      }
+      if ( view.src_port() != 1234 or view.dst_port() != 80 or view.seqno() != Wrap32 { 77 }
+           or view.ackno() != Wrap32 { 99 } or view.window_size() != 1000 or view.SYN() or view.FIN()
+           or view.RST() ) {
+        throw runtime_error( "view decoded the wrong header fields" );
+      }
+      const vector<Buffer> payload = view.payload();
+      if ( payload.size() != 2 or payload.at( 0 ).size() != 468 or payload.at( 1 ).size() != 532 ) {
+        throw runtime_error( "view payload has the wrong slices" );
+      }
+      expect_inside( payload.at( 0 ), fragments.at( 1 ), "first payload slice" );
+      expect_inside( payload.at( 1 ), fragments.at( 2 ), "second payload slice" );
+
+      TCPSegment decoded;
+      if ( not view.decode( decoded ) or decoded.sender_message.timestamp != 5
+           or decoded.receiver_message.timestamp_echo != 6
+           or string_view { decoded.sender_message.payload } != string( 1000, 'p' ) ) {
+        throw runtime_error( "fragmented segment decoded wrongly" );
+      }
+
+      // a corrupted byte fails the checksum
+      string corrupted = joined;
+      corrupted.at( 700 ) ^= 1;
+      if ( TCPSegmentView { { corrupted.substr( 0, 300 ), corrupted.substr( 300 ) }, 0 }.valid() ) {
+        throw runtime_error( "corrupted segment was valid" );
+      }
+    }
+
+    {
+      // a 10 MB transfer between two TCPPeers, with every data segment serialized and read back through a file
+      // descriptor as it would arrive from the network (and every 100th lost the first time it is sent): no
+      // payload is copied between the datagram it arrives in and the application's peek
+      array<int, 2> fds {};
+      CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+      FileDescriptor network { fds[0] };
+      FileDescriptor host { fds[1] };
+      TCPConfig cfg;
+      cfg.rt_timeout = 10;
+      TCPPeer sender { cfg }, receiver { cfg };
+      const PacketPool::Stats before = PacketPool::local().stats();
+
+      constexpr size_t total = 10'000'000;
+      const auto pattern = []( size_t index ) { return static_cast<char>( index % 251 ); };
+      size_t written = 0, received = 0, data_segments = 0;
+      sender.push();
+      for ( uint64_t ms = 0; received < total; ms++ ) {
+        if ( ms > 1'000'000 ) {
+          throw runtime_error( "transfer stalled after " + to_string( received ) + " bytes" );
+        }
+        Writer& writer = sender.outbound_writer();
+        while ( sender.has_ackno() and written < total and writer.available_capacity() > 0 ) {
+          string piece( min( { writer.available_capacity(), total - written, size_t { 4096 } } ), 0 );
+          for ( auto& ch : piece ) {
+            ch = pattern( written++ );
+          }
+          writer.push( move( piece ) );
+        }
+        sender.push();
+
+        while ( auto seg = sender.maybe_send() ) {
+          if ( not seg->sender_message.payload.empty() and ++data_segments % 100 == 0 ) {
+            continue; // lost
+          }
+          seg->compute_checksum( 0 );
+          host.write( serialize( seg.value() ) );
+          vector<string> strs( 1 );
+          network.read( strs );
+          TCPSegment arrived;
+          if ( not parse( arrived, { Buffer { move( strs.front() ) } }, uint32_t { 0 } ) ) {
+            throw runtime_error( "segment did not parse" );
+          }
+          receiver.receive( move( arrived ) );
+        }
+        while ( auto ack = receiver.maybe_send() ) {
+          sender.receive( move( ack.value() ) );
+        }
+
+        Reader& reader = receiver.inbound_reader();
+        while ( reader.bytes_buffered() > 0 ) {
+          const string_view view = reader.peek();
+          for ( const char ch : view ) {
+            if ( ch != pattern( received++ ) ) {
+              throw runtime_error( "wrong byte at index " + to_string( received - 1 ) );
+            }
+          }
+          reader.pop( view.size() );
+        }
+        sender.tick( 1 );
+        receiver.tick( 1 );
+      }
+
+      const PacketPool::Stats& after = PacketPool::local().stats();
+      if ( after.copies != before.copies ) {
+        throw runtime_error( to_string( after.copied_bytes - before.copied_bytes ) + " payload bytes copied" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
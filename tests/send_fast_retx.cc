@@ -0,0 +1,171 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Three duplicate ACKs trigger a fast retransmit", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ).with_seqno( isn + 4 ) );
+      test.execute( Push { "ghi" } );
+      test.execute( ExpectMessage {}.with_data( "ghi" ).with_seqno( isn + 7 ) );
+      test.execute( Push { "jkl" } );
+      test.execute( ExpectMessage {}.with_data( "jkl" ).with_seqno( isn + 10 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 12 } );
+      test.execute( AckReceived { Wrap32 { isn + 13 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Partial ACK in fast recovery resends the next hole", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( Push { "ghi" } );
+      test.execute( ExpectMessage {}.with_data( "ghi" ) );
+      test.execute( Push { "jkl" } );
+      test.execute( ExpectMessage {}.with_data( "jkl" ) );
+      test.execute( Push { "mno" } );
+      test.execute( ExpectMessage {}.with_data( "mno" ) );
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      }
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 7 } }.with_win( 1000 ) );
+      test.execute( ExpectMessage {}.with_data( "ghi" ).with_seqno( isn + 7 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 16 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Further duplicates during recovery don't resend again", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      for ( const auto* const data : { "abc", "def", "ghi", "jkl", "mno", "pqr" } ) {
+        test.execute( Push { data } );
+        test.execute( ExpectMessage {}.with_data( data ) );
+      }
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      }
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+        test.execute( ExpectNoSegment {} );
+      }
+      test.execute( AckReceived { Wrap32 { isn + 19 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Window updates are not duplicate ACKs", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 999 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 998 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 997 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = retx_timeout;
+
+      TCPSenderTestHarness test { "Fast retransmit doesn't back off the RTO", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      for ( const auto* const data : { "abc", "def", "ghi", "jkl" } ) {
+        test.execute( Push { data } );
+        test.execute( ExpectMessage {}.with_data( data ) );
+      }
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      }
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( Tick { retx_timeout - 1U }.with_max_retx_exceeded( false ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 }.with_max_retx_exceeded( false ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Duplicate ACKs with nothing outstanding are ignored", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1000 ) );
+      for ( int i = 0; i < 4; i++ ) {
+        test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1000 ) );
+        test.execute( ExpectNoSegment {} );
+      }
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
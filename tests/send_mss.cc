@@ -0,0 +1,98 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Segments are sized by the negotiated MSS", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMss { 1460 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push { string( 3000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1460 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1460 ).with_seqno( isn + 1461 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 80 ).with_seqno( isn + 2921 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "An acknowledged probe raises the MSS", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMss { 1000, 9000 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 20000 ) );
+      test.execute( Push { string( 7000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 5000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 5001 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 6001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectMss { 1000 } );
+      test.execute( AckReceived { Wrap32 { isn + 5001 } }.with_win( 20000 ) );
+      test.execute( ExpectMss { 5000 } );
+      test.execute( Push { string( 12000, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 7000 ).with_seqno( isn + 7001 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 5000 ).with_seqno( isn + 14001 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "A lost probe is resent in MSS-sized pieces", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMss { 1000, 9000 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 20000 ) );
+      test.execute( Push { string( 5500, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 5000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 500 ).with_seqno( isn + 5001 ) );
+      test.execute( Tick { cfg.rt_timeout }.with_max_retx_exceeded( false ) );
+      for ( uint32_t i = 0; i < 5; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 + i * 1000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectMss { 1000 } );
+      test.execute( ExpectSeqnosInFlight { 5500 } );
+
+      // the lost probe didn't back off the RTO
+      test.execute( Tick { cfg.rt_timeout - 1U }.with_max_retx_exceeded( false ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 }.with_max_retx_exceeded( false ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+
+      // the next probe aims lower
+      test.execute( AckReceived { Wrap32 { isn + 5501 } }.with_win( 20000 ) );
+      test.execute( Push { string( 4000, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 3000 ).with_seqno( isn + 5501 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 8501 ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Nagle holds small writes while data is unacknowledged", cfg };
+      test.execute( SetNagle { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ).with_seqno( isn + 1 ) );
+      test.execute( Push { "b" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push { "c" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 2 } }.with_win( 5000 ) );
+      test.execute( ExpectMessage {}.with_data( "bc" ).with_seqno( isn + 2 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Nagle still sends full segments and the FIN", cfg };
+      test.execute( SetNagle { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ).with_seqno( isn + 1 ) );
+      test.execute( Push { string( 1500, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 2 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Close {} );
+      test.execute( ExpectMessage {}.with_payload_size( 500 ).with_fin( true ).with_seqno( isn + 1002 ) );
+      test.execute( ExpectSeqnosInFlight { 1502 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Cork holds partial segments until uncorked", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( SetCork { true } );
+      test.execute( Push { "ab" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push { "cd" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push { string( 1200, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SetCork { false } );
+      test.execute( ExpectMessage {}.with_payload_size( 204 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Without Nagle or cork, small writes go out at once", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Push { "b" } );
+      test.execute( ExpectMessage {}.with_data( "b" ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
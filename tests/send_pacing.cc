@@ -0,0 +1,123 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "RTT is measured from acknowledged segments", cfg };
+      test.execute( ExpectSmoothedRtt { optional<uint64_t> {} } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 40 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectSmoothedRtt { 40 } );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 8 } );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1000 ) );
+      test.execute( ExpectSmoothedRtt { ( 7 * 40 + 8 ) / 8 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Retransmitted segments give no RTT sample", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 5 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectSmoothedRtt { optional<uint64_t> {} } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Pacing spreads the window over the RTT", cfg };
+      test.execute( SetPacing { true } );
+      test.execute( ExpectPacingRate { 0 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( ExpectPacingRate { 100000 } );
+      test.execute( Push { string( 10000, 'x' ) } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 10 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 5 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 5 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 5 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 2001 ) );
+      test.execute( ExpectSeqnosInFlight { 10000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Pacing saves up at most a small burst", cfg };
+      test.execute( SetPacing { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      for ( int i = 0; i < 100; i++ ) {
+        test.execute( Tick { 10 } );
+      }
+      test.execute( Push { string( 10000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Without pacing the window goes out at once", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 3000 ) );
+      test.execute( ExpectPacingRate { 0 } );
+      test.execute( Push { string( 3000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Only the holes are resent during SACK recovery", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      for ( const auto* const data : { "abc", "def", "ghi", "jkl", "mno" } ) {
+        test.execute( Push { data } );
+        test.execute( ExpectMessage {}.with_data( data ) );
+      }
+      // "abc" and "ghi" are lost
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_sack( isn + 4, isn + 7 ) );
+      test.execute(
+        AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_sack( isn + 10, isn + 13 ).with_sack( isn + 4,
+                                                                                                       isn + 7 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute(
+        AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_sack( isn + 10, isn + 16 ).with_sack( isn + 4,
+                                                                                                       isn + 7 ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute(
+        AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_sack( isn + 10, isn + 16 ).with_sack( isn + 4,
+                                                                                                       isn + 7 ) );
+      test.execute( ExpectMessage {}.with_data( "ghi" ).with_seqno( isn + 7 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute(
+        AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_sack( isn + 10, isn + 16 ).with_sack( isn + 4,
+                                                                                                       isn + 7 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 15 } );
+      test.execute( AckReceived { Wrap32 { isn + 16 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "SACKed segment above a partial ACK is not resent", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      for ( const auto* const data : { "abc", "def", "ghi", "jkl", "mno" } ) {
+        test.execute( Push { data } );
+        test.execute( ExpectMessage {}.with_data( data ) );
+      }
+      // "abc" and "jkl" are lost
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_sack( isn + 4, isn + 10 ) );
+      }
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 10 } }.with_win( 1000 ).with_sack( isn + 13, isn + 16 ) );
+      test.execute( ExpectMessage {}.with_data( "jkl" ).with_seqno( isn + 10 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 16 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = retx_timeout;
+
+      TCPSenderTestHarness test { "Timeout resends the left edge even after SACK", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_sack( isn + 4, isn + 7 ) );
+      test.execute( ExpectSeqnosInFlight { 6 } );
+      test.execute( Tick { retx_timeout } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Segments carry the sender's clock when it is sent", cfg };
+      test.execute( SetTimestamps { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ).with_timestamp( 0 ) );
+      test.execute( Tick { 7 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_timestamp_echo( 0 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_timestamp( 7 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_timestamp( 7 + cfg.rt_timeout ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Without timestamps, segments carry none", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( nullopt ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_timestamp( nullopt ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "A retransmitted segment is timed by its echo", cfg };
+      test.execute( SetTimestamps { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( 0 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( cfg.rt_timeout ) );
+      test.execute( Tick { 30 } );
+      // the ACK echoes the retransmission, so the RTT is 30 ms (Karn's rule would have taken no sample)
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_timestamp_echo( cfg.rt_timeout ) );
+      test.execute( ExpectSmoothedRtt { 30 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Every ACK of new data gives a sample", cfg };
+      test.execute( SetTimestamps { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 40 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_timestamp_echo( 0 ) );
+      test.execute( ExpectSmoothedRtt { 40 } );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_timestamp( 40 ) );
+      test.execute( Tick { 8 } );
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ).with_timestamp( 48 ) );
+      test.execute( Tick { 8 } );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1000 ).with_timestamp_echo( 40 ) );
+      test.execute( ExpectSmoothedRtt { ( 7 * 40 + 16 ) / 8 } );
+      test.execute( Tick { 8 } );
+      test.execute( AckReceived { Wrap32 { isn + 7 } }.with_win( 1000 ).with_timestamp_echo( 48 ) );
+      test.execute( ExpectSmoothedRtt { ( 7 * ( ( 7 * 40 + 16 ) / 8 ) + 16 ) / 8 } );
+
+      // a duplicate ACK acknowledges nothing new, so its echo is not a sample
+      test.execute( Tick { 500 } );
+      test.execute( AckReceived { Wrap32 { isn + 7 } }.with_win( 1000 ).with_timestamp_echo( 48 ) );
+      test.execute( ExpectSmoothedRtt { ( 7 * ( ( 7 * 40 + 16 ) / 8 ) + 16 ) / 8 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Echoes are ignored unless timestamps are in use", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 30 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_timestamp_echo( cfg.rt_timeout ) );
+      test.execute( ExpectSmoothedRtt { optional<uint64_t> {} } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.send_capacity = 1 << 20;
+
+      TCPSenderTestHarness test { "Scaled window lets the sender fill more than 64 KiB", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetWindowShift { 2 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 50000 ) );
+      test.execute( Push { string( 200000, 'x' ) } );
+      for ( size_t i = 0; i < 200; i++ ) {
+        test.execute(
+          ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ).with_seqno( isn + 1 + i * 1000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 200000 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 + 200000 } }.with_win( 50000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Scaled window is respected exactly", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetWindowShift { 3 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1 ) );
+      test.execute( Push { "abcdefghijkl" } );
+      test.execute( ExpectMessage {}.with_data( "abcdefgh" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 9 } }.with_win( 1 ) );
+      test.execute( ExpectMessage {}.with_data( "ijkl" ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "Shrinking a scaled window below what is in flight", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetWindowShift { 1 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10 ) );
+      test.execute( Push { "abcdefghijklmnopqrst" } );
+      test.execute( ExpectMessage {}.with_data( "abcdefghijklmnopqrst" ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5 ) );
+      test.execute( Push { "uvw" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 20 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
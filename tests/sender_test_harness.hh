@@ -6,6 +6,7 @@
 #include "tcp_sender.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <optional>
 #include <sstream>
 #include <utility>
@@ -54,6 +55,27 @@ struct ExpectSeqnosInFlight : public ExpectNumber<StreamAndSender, uint64_t>
   uint64_t value( StreamAndSender& ss ) const override { return ss.second.sequence_numbers_in_flight(); }
 };
 
+struct ExpectMss : public ExpectNumber<StreamAndSender, size_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "mss"; }
+  size_t value( StreamAndSender& ss ) const override { return ss.second.mss(); }
+};
+
+struct ExpectSmoothedRtt : public ExpectNumber<StreamAndSender, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "smoothed_rtt"; }
+  std::optional<uint64_t> value( StreamAndSender& ss ) const override { return ss.second.smoothed_rtt(); }
+};
+
+struct ExpectPacingRate : public ExpectNumber<StreamAndSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pacing_rate"; }
+  uint64_t value( StreamAndSender& ss ) const override { return ss.second.pacing_rate(); }
+};
+
 struct ExpectNoSegment : public Expectation<StreamAndSender>
 {
   std::string description() const override { return "nothing to send"; }
@@ -154,7 +176,14 @@ struct Receive : public Action<StreamAndSender>
   std::string description() const override
   {
     std::ostringstream desc;
-    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ")";
+    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size;
+    for ( const auto& [left, right] : msg_.sack_blocks ) {
+      desc << ", sack=" << left << "-" << right;
+    }
+    if ( msg_.timestamp_echo.has_value() ) {
+      desc << ", tsecr=" << msg_.timestamp_echo.value();
+    }
+    desc << ")";
     if ( push_ ) {
       desc << ", then push stream to TCPSender";
     }
@@ -175,6 +204,18 @@ struct Receive : public Action<StreamAndSender>
     }
   }
 
+  Receive& with_sack( Wrap32 left, Wrap32 right )
+  {
+    msg_.sack_blocks.emplace_back( left, right );
+    return *this;
+  }
+
+  Receive& with_timestamp_echo( uint32_t tsecr )
+  {
+    msg_.timestamp_echo = tsecr;
+    return *this;
+  }
+
   Receive& without_push()
   {
     push_ = false;
@@ -182,6 +223,79 @@ struct Receive : public Action<StreamAndSender>
   }
 };
 
+struct SetWindowShift : public Action<StreamAndSender>
+{
+  uint8_t shift_;
+
+  explicit SetWindowShift( uint8_t shift ) : shift_( shift ) {}
+  std::string description() const override
+  {
+    return "window scale negotiated with shift " + std::to_string( shift_ );
+  }
+  void execute( StreamAndSender& ss ) const override { ss.second.set_window_shift( shift_ ); }
+};
+
+struct SetMss : public Action<StreamAndSender>
+{
+  size_t mss_;
+  size_t probe_up_to_;
+
+  explicit SetMss( size_t mss, size_t probe_up_to = 0 ) : mss_( mss ), probe_up_to_( probe_up_to ) {}
+  std::string description() const override
+  {
+    std::ostringstream desc;
+    desc << "MSS negotiated as " << mss_;
+    if ( probe_up_to_ > mss_ ) {
+      desc << ", probing up to " << probe_up_to_;
+    }
+    return desc.str();
+  }
+  void execute( StreamAndSender& ss ) const override { ss.second.set_mss( mss_, probe_up_to_ ); }
+};
+
+struct SetNagle : public Action<StreamAndSender>
+{
+  bool enabled_;
+
+  explicit SetNagle( bool enabled ) : enabled_( enabled ) {}
+  std::string description() const override { return enabled_ ? "enable Nagle" : "disable Nagle"; }
+  void execute( StreamAndSender& ss ) const override { ss.second.set_nagle( enabled_ ); }
+};
+
+struct SetPacing : public Action<StreamAndSender>
+{
+  bool enabled_;
+
+  explicit SetPacing( bool enabled ) : enabled_( enabled ) {}
+  std::string description() const override { return enabled_ ? "enable pacing" : "disable pacing"; }
+  void execute( StreamAndSender& ss ) const override { ss.second.set_pacing( enabled_ ); }
+};
+
+struct SetTimestamps : public Action<StreamAndSender>
+{
+  bool enabled_;
+
+  explicit SetTimestamps( bool enabled ) : enabled_( enabled ) {}
+  std::string description() const override { return enabled_ ? "enable timestamps" : "disable timestamps"; }
+  void execute( StreamAndSender& ss ) const override { ss.second.set_timestamps( enabled_ ); }
+};
+
+struct SetCork : public Action<StreamAndSender>
+{
+  bool enabled_;
+
+  explicit SetCork( bool enabled ) : enabled_( enabled ) {}
+  std::string description() const override
+  {
+    return enabled_ ? "cork" : "uncork, then push stream to TCPSender";
+  }
+  void execute( StreamAndSender& ss ) const override
+  {
+    ss.second.set_cork( enabled_ );
+    ss.second.push( ss.first.reader() );
+  }
+};
+
 struct AckReceived : public Receive
 {
   explicit AckReceived( Wrap32 ackno ) : Receive( { ackno, DEFAULT_TEST_WINDOW } ) {}
@@ -199,6 +313,7 @@ struct ExpectMessage : public Expectation<StreamAndSender>
   std::optional<Wrap32> seqno {};
   std::optional<std::string> data {};
   std::optional<size_t> payload_size {};
+  std::optional<std::optional<uint32_t>> timestamp {};
 
   ExpectMessage& with_syn( bool syn_ )
   {
@@ -233,6 +348,12 @@ struct ExpectMessage : public Expectation<StreamAndSender>
     return *this;
   }
 
+  ExpectMessage& with_timestamp( std::optional<uint32_t> timestamp_ )
+  {
+    timestamp = timestamp_;
+    return *this;
+  }
+
   ExpectMessage& with_data( std::string data_ )
   {
     data = std::move( data_ );
@@ -261,6 +382,9 @@ struct ExpectMessage : public Expectation<StreamAndSender>
     if ( fin.has_value() ) {
       o << ( fin.value() ? " +FIN" : " (no FIN)" );
     }
+    if ( timestamp.has_value() ) {
+      o << " tsval=" << to_string( timestamp.value() );
+    }
     return o.str();
   }
 
@@ -287,10 +411,16 @@ struct ExpectMessage : public Expectation<StreamAndSender>
     if ( seqno.has_value() and seg.seqno != seqno.value() ) {
       throw ExpectationViolation( "sequence number", seqno.value(), seg.seqno );
     }
+    if ( timestamp.has_value() and seg.timestamp != timestamp.value() ) {
+      throw ExpectationViolation( "timestamp", timestamp.value(), seg.timestamp );
+    }
     if ( payload_size.has_value() and seg.payload.size() != payload_size.value() ) {
       throw ExpectationViolation( "payload_size", payload_size.value(), seg.payload.size() );
     }
-    if ( seg.payload.size() > TCPConfig::MAX_PAYLOAD_SIZE ) {
+    // a larger MSS can be negotiated, and a PLPMTUD probe may exceed it when the test expects one
+    const size_t max_payload
+      = std::max( { TCPConfig::MAX_PAYLOAD_SIZE, ss.second.mss(), payload_size.value_or( 0 ) } );
+    if ( seg.payload.size() > max_payload ) {
       throw ExpectationViolation( "payload has length (" + std::to_string( seg.payload.size() )
                                   + ") greater than the maximum" );
     }
@@ -0,0 +1,280 @@
+#include "exception.hh"
+#include "ipv4_datagram.hh"
+#include "random.hh"
+#include "tcp_multiplexer.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Two multiplexers joined by a datagram socket pair, standing in for a TUN device and the host on its other side
+static pair<FileDescriptor, FileDescriptor> datagram_pair()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+// A bare TCP segment in an IPv4 datagram, as a host with no TCP state would send it
+static vector<Buffer> raw_segment( const Address& src, const Address& dst, TCPSegment seg )
+{
+  seg.udinfo.src_port = src.port();
+  seg.udinfo.dst_port = dst.port();
+  InternetDatagram dgram;
+  dgram.header.src = src.ipv4_numeric();
+  dgram.header.dst = dst.ipv4_numeric();
+  dgram.header.len = dgram.header.hlen * 4 + seg.header_length();
+  seg.compute_checksum( dgram.header.pseudo_checksum() );
+  dgram.header.compute_checksum();
+  dgram.payload = serialize( seg );
+  return serialize( dgram );
+}
+
+// One end of a connection as the application sees it
+struct AppEnd
+{
+  LocalStreamSocket socket;
+  string received {};
+  bool eof {};
+
+  explicit AppEnd( LocalStreamSocket&& s ) : socket( move( s ) ) { socket.set_blocking( false ); }
+
+  void read_available()
+  {
+    while ( not eof ) {
+      string data;
+      const auto reads_before = socket.read_count();
+      socket.read( data );
+      if ( socket.read_count() == reads_before ) {
+        return; // would block
+      }
+      eof = socket.eof();
+      received += data;
+    }
+  }
+};
+
+// Each of `count` client connections sends a random message to port 80, and the server echoes it back
+static void echo_messages( TCPMultiplexer& client,
+                           TCPMultiplexer& server,
+                           size_t count,
+                           default_random_engine& rd )
+{
+  vector<AppEnd> clients;
+  vector<string> messages;
+  for ( size_t i = 0; i < count; i++ ) {
+    clients.emplace_back(
+      client.connect( Address { "10.0.0.2", static_cast<uint16_t>( 10000 + i ) }, Address { "10.0.0.1", 80 } ) );
+    string message( uniform_int_distribution<size_t> { 1, 3000 }( rd ), 0 );
+    for ( auto& ch : message ) {
+      ch = static_cast<char>( rd() );
+    }
+    clients.back().socket.write( message );
+    clients.back().socket.shutdown( SHUT_WR );
+    messages.push_back( move( message ) );
+  }
+  if ( client.connection_count() != count ) {
+    throw runtime_error( "client should have one TCPPeer per connection" );
+  }
+
+  vector<AppEnd> servers;
+  vector<size_t> echoed;
+  const auto deadline = chrono::steady_clock::now() + chrono::seconds( 4 );
+  while ( client.connection_count() > 0 or server.connection_count() > 0 ) {
+    if ( chrono::steady_clock::now() > deadline ) {
+      throw runtime_error( "connections did not finish: " + to_string( client.connection_count() ) + " client, "
+                           + to_string( server.connection_count() ) + " server still open" );
+    }
+    client.wait_next_event( 0 );
+    server.wait_next_event( 0 );
+
+    while ( auto accepted = server.accept() ) {
+      if ( accepted->second.ip() != "10.0.0.2" ) {
+        throw runtime_error( "accepted connection from unexpected address " + accepted->second.to_string() );
+      }
+      servers.emplace_back( move( accepted->first ) );
+      echoed.push_back( 0 );
+    }
+
+    for ( size_t i = 0; i < servers.size(); i++ ) {
+      auto& s = servers.at( i );
+      if ( s.eof and echoed.at( i ) == s.received.size() ) {
+        continue;
+      }
+      s.read_available();
+      if ( echoed.at( i ) < s.received.size() ) {
+        echoed.at( i ) += s.socket.write( string_view { s.received }.substr( echoed.at( i ) ) );
+      }
+      if ( s.eof and echoed.at( i ) == s.received.size() ) {
+        s.socket.shutdown( SHUT_WR );
+      }
+    }
+
+    for ( auto& c : clients ) {
+      c.read_available();
+    }
+  }
+
+  if ( servers.size() != count ) {
+    throw runtime_error( "server accepted " + to_string( servers.size() ) + " connections" );
+  }
+  for ( size_t i = 0; i < count; i++ ) {
+    if ( not clients.at( i ).eof or clients.at( i ).received != messages.at( i ) ) {
+      throw runtime_error( "connection " + to_string( i ) + " did not echo its message" );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    TCPConfig cfg;
+    cfg.rt_timeout = 100;
+
+    {
+      auto [client_fd, server_fd] = datagram_pair();
+      TCPMultiplexer client { move( client_fd ), cfg };
+      TCPMultiplexer server { move( server_fd ), cfg };
+      server.listen( Address { "0", 80 } );
+      echo_messages( client, server, 32, rd );
+    }
+
+    {
+      // with no room for half-open connections, every handshake is completed from a SYN cookie
+      auto [client_fd, server_fd] = datagram_pair();
+      TCPMultiplexer client { move( client_fd ), cfg };
+      TCPMultiplexer server { move( server_fd ), cfg };
+      server.listen( Address { "10.0.0.1", 80 }, 0 );
+      echo_messages( client, server, 32, rd );
+    }
+
+    {
+      auto [client_fd, server_fd] = datagram_pair();
+      TCPMultiplexer client { move( client_fd ) };
+      TCPMultiplexer server { move( server_fd ) };
+      server.listen( Address { "10.0.0.1", 80 } );
+
+      // a SYN to a port nobody listens on doesn't create a connection
+      AppEnd refused { client.connect( Address { "10.0.0.2", 10000 }, Address { "10.0.0.1", 81 } ) };
+      for ( size_t i = 0; i < 20; i++ ) {
+        client.wait_next_event( 0 );
+        server.wait_next_event( 0 );
+      }
+      if ( server.connection_count() != 0 or server.accept().has_value() ) {
+        throw runtime_error( "SYN to a closed port was accepted" );
+      }
+    }
+
+    {
+      // with nothing answering, the SYN is retransmitted from the connection's timer while the loop waits
+      // without a timeout
+      auto [client_fd, silent_fd] = datagram_pair();
+      TCPConfig quick;
+      quick.rt_timeout = 20;
+      TCPMultiplexer client { move( client_fd ), quick };
+      silent_fd.set_blocking( false );
+      AppEnd unanswered { client.connect( Address { "10.0.0.2", 10000 }, Address { "10.0.0.1", 80 } ) };
+      size_t syns = 0;
+      const auto deadline = chrono::steady_clock::now() + chrono::seconds( 2 );
+      while ( syns < 3 ) {
+        if ( chrono::steady_clock::now() > deadline ) {
+          throw runtime_error( "SYN was sent " + to_string( syns ) + " times without a reply" );
+        }
+        client.wait_next_event( -1 );
+        while ( true ) {
+          string datagram;
+          const auto reads_before = silent_fd.read_count();
+          silent_fd.read( datagram );
+          if ( silent_fd.read_count() == reads_before ) {
+            break; // would block
+          }
+          syns++;
+        }
+      }
+    }
+
+    {
+      // a burst of datagrams is read in one call, and its replies are written in the next
+      auto [host_fd, server_fd] = datagram_pair();
+      TCPMultiplexer server { move( server_fd ) };
+      server.listen( Address { "10.0.0.1", 80 }, 64 );
+      for ( uint16_t i = 0; i < 40; i++ ) {
+        TCPSegment syn;
+        syn.sender_message.seqno = Wrap32 { static_cast<uint32_t>( rd() ) };
+        syn.sender_message.SYN = true;
+        host_fd.write( raw_segment( Address { "10.0.1.1", static_cast<uint16_t>( 20000 + i ) },
+                                    Address { "10.0.0.1", 80 },
+                                    syn ) );
+      }
+      server.wait_next_event( 0 );
+      if ( server.connection_count() != 40 ) {
+        throw runtime_error( "one call read " + to_string( server.connection_count() ) + " of 40 SYNs" );
+      }
+      server.wait_next_event( 0 );
+      host_fd.set_blocking( false );
+      size_t replies = 0;
+      while ( true ) {
+        string datagram;
+        const auto reads_before = host_fd.read_count();
+        host_fd.read( datagram );
+        if ( host_fd.read_count() == reads_before ) {
+          break; // would block
+        }
+        replies++;
+      }
+      if ( replies != 40 ) {
+        throw runtime_error( "one call wrote " + to_string( replies ) + " of 40 SYN-ACKs" );
+      }
+    }
+
+    {
+      auto [flood_fd, server_fd] = datagram_pair();
+      TCPMultiplexer server { move( server_fd ) };
+      server.listen( Address { "10.0.0.1", 80 }, 8 );
+      server.listen( Address { "10.0.0.1", 81 }, 8, false );
+
+      // a flood of SYNs from hosts that never finish the handshake holds at most `backlog` connections
+      for ( const uint16_t port : { 80, 81 } ) {
+        for ( uint16_t i = 0; i < 50; i++ ) {
+          TCPSegment syn;
+          syn.sender_message.seqno = Wrap32 { static_cast<uint32_t>( rd() ) };
+          syn.sender_message.SYN = true;
+          flood_fd.write( raw_segment( Address { "10.0.1.1", static_cast<uint16_t>( 20000 + i ) },
+                                       Address { "10.0.0.1", port },
+                                       syn ) );
+          server.wait_next_event( 0 );
+        }
+      }
+      if ( server.connection_count() != 16 ) {
+        throw runtime_error( "SYN flood left " + to_string( server.connection_count() )
+                             + " connections instead of the two backlogs' 16" );
+      }
+
+      // an ACK that doesn't carry a valid cookie opens nothing
+      for ( size_t i = 0; i < 50; i++ ) {
+        TCPSegment ack;
+        ack.sender_message.seqno = Wrap32 { static_cast<uint32_t>( rd() ) };
+        ack.receiver_message.ackno = Wrap32 { static_cast<uint32_t>( rd() ) };
+        flood_fd.write( raw_segment( Address { "10.0.1.2", 20000 }, Address { "10.0.0.1", 80 }, ack ) );
+        server.wait_next_event( 0 );
+      }
+      if ( server.connection_count() != 16 or server.accept().has_value() ) {
+        throw runtime_error( "forged SYN cookie was accepted" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+#include "exception.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_multiplexer.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+struct FloodStats
+{
+  size_t accepted {};         // legitimate connections accepted
+  size_t flood_syns {};       // spoofed SYNs that made it into the server's queue
+  size_t peak_connections {}; // most connections (half-open included) the server held at once
+  double seconds {};
+};
+
+// A SYN from a spoofed source that will never answer the SYN/ACK
+static vector<Buffer> spoofed_syn( default_random_engine& rd )
+{
+  TCPSegment seg;
+  seg.sender_message.seqno = Wrap32 { static_cast<uint32_t>( rd() ) };
+  seg.sender_message.SYN = true;
+  seg.udinfo.src_port = static_cast<uint16_t>( rd() );
+  seg.udinfo.dst_port = 80;
+
+  InternetDatagram dgram;
+  dgram.header.src = ( 11U << 24U ) | ( rd() & 0xffffffU );
+  dgram.header.dst = Address { "10.0.0.1" }.ipv4_numeric();
+  dgram.header.len = dgram.header.hlen * 4 + seg.header_length();
+  seg.compute_checksum( dgram.header.pseudo_checksum() );
+  dgram.header.compute_checksum();
+  dgram.payload = serialize( seg );
+  return serialize( dgram );
+}
+
+// Legitimate clients connect one at a time, with `flood_per_connect` spoofed SYNs sent alongside each, until
+// `connections` are accepted or `limit` has passed
+static FloodStats flood( size_t connections,
+                         size_t flood_per_connect,
+                         size_t backlog,
+                         bool syn_cookies,
+                         milliseconds limit )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  FileDescriptor network { fds[0] };
+
+  TCPConfig client_cfg;
+  client_cfg.rt_timeout = 50;
+  TCPMultiplexer client { network.duplicate(), client_cfg };
+  TCPMultiplexer server { FileDescriptor { fds[1] } };
+  server.listen( Address { "10.0.0.1", 80 }, backlog, syn_cookies );
+
+  default_random_engine rd { 1729 };
+  vector<LocalStreamSocket> app_ends;
+  FloodStats stats;
+  size_t connects = 0;
+  const auto start = steady_clock::now();
+  while ( stats.accepted < connections and steady_clock::now() - start < limit ) {
+    for ( size_t i = 0; i < flood_per_connect; i++ ) {
+      string dgram;
+      for ( const auto& piece : spoofed_syn( rd ) ) {
+        dgram.append( piece );
+      }
+      // a full queue drops the datagram, as a congested link would
+      if ( ::send( network.fd_num(), dgram.data(), dgram.size(), MSG_DONTWAIT ) > 0 ) {
+        stats.flood_syns++;
+      }
+    }
+    if ( connects < connections ) {
+      const auto port = static_cast<uint16_t>( 1024 + connects++ );
+      app_ends.push_back( client.connect( Address { "10.0.0.2", port }, Address { "10.0.0.1", 80 } ) );
+    }
+
+    for ( size_t i = 0; i < 4 * ( flood_per_connect + 1 ); i++ ) {
+      client.wait_next_event( 0 );
+      server.wait_next_event( 0 );
+    }
+    while ( auto accepted = server.accept() ) {
+      app_ends.push_back( move( accepted->first ) );
+      stats.accepted++;
+    }
+    stats.peak_connections = max( stats.peak_connections, server.connection_count() );
+  }
+  stats.seconds = duration_cast<duration<double>>( steady_clock::now() - start ).count();
+  return stats;
+}
+
+static void report( const string& label, size_t flood_per_connect, size_t backlog, bool syn_cookies )
+{
+  const FloodStats stats = flood( 500, flood_per_connect, backlog, syn_cookies, milliseconds { 2000 } );
+  cout << "SYN flood (" << label << "): " << stats.accepted << " accepted in " << fixed << setprecision( 2 )
+       << stats.seconds << " s (" << static_cast<double>( stats.accepted ) / stats.seconds << " accepts/s), "
+       << stats.flood_syns << " spoofed SYNs, peak of " << stats.peak_connections << " connections held.\n";
+}
+
+void program_body()
+{
+  report( "no flood", 0, 128, true );
+  report( "backlog 128 with SYN cookies", 16, 128, true );
+  report( "backlog 128 without SYN cookies", 16, 128, false );
+  report( "unbounded backlog", 16, SIZE_MAX, false );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,206 @@
+#include "random.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+struct OptionStats
+{
+  size_t largest_payload {};
+  size_t data_segments_with_sack {};
+};
+
+// Exchange `data` in both directions between two TCPPeers configured with `client_cfg` and `server_cfg`,
+// dropping every tenth data segment from the client the first time it is sent (so the server reports SACK blocks
+// on its own data), and check that no segment's payload and options together exceed the MSS
+static OptionStats exchange( const string& name,
+                             const TCPConfig& client_cfg,
+                             const TCPConfig& server_cfg,
+                             const string& data )
+{
+  TCPPeer client { client_cfg }, server { server_cfg };
+  queue<TCPSegment> to_server, to_client;
+  OptionStats stats;
+  size_t client_data_segments = 0;
+
+  const auto collect = [&]( TCPPeer& peer, queue<TCPSegment>& link, bool is_client ) {
+    while ( auto seg = peer.maybe_send() ) {
+      const size_t payload = seg->sender_message.payload.size();
+      const size_t options = seg->options_length();
+      size_t serialized = 0;
+      for ( const auto& buf : serialize( seg.value() ) ) {
+        serialized += buf.size();
+      }
+      if ( serialized != seg->header_length() + payload ) {
+        throw runtime_error( name + ": options_length() disagrees with the serialized segment" );
+      }
+      if ( not seg->sender_message.SYN and payload + options > client_cfg.mss ) {
+        throw runtime_error( name + ": segment of " + to_string( payload ) + " payload and "
+                             + to_string( options ) + " option bytes exceeds the MSS" );
+      }
+      stats.largest_payload = max( stats.largest_payload, payload );
+      if ( payload > 0 and not seg->receiver_message.sack_blocks.empty() ) {
+        stats.data_segments_with_sack++;
+      }
+      if ( is_client and payload > 0 and not seg->sender_message.timestamp.has_value() ) {
+        throw runtime_error( name + ": data segment without a timestamp" );
+      }
+      if ( is_client and payload > 0 and ++client_data_segments % 10 == 0 ) {
+        continue; // lost
+      }
+      link.push( move( seg.value() ) );
+    }
+  };
+
+  const auto drain = []( TCPPeer& peer, string& received ) {
+    Reader& reader = peer.inbound_reader();
+    while ( reader.bytes_buffered() ) {
+      received.append( reader.peek() );
+      reader.pop( reader.peek().size() );
+    }
+  };
+
+  // each application keeps its outbound stream full, so both directions carry data the whole time
+  const auto write = [&data]( TCPPeer& peer, size_t& written ) {
+    Writer& writer = peer.outbound_writer();
+    if ( peer.has_ackno() and not writer.is_closed() ) {
+      const size_t len = min( data.size() - written, writer.available_capacity() );
+      writer.push( data.substr( written, len ) );
+      written += len;
+      if ( written == data.size() ) {
+        writer.close();
+      }
+    }
+  };
+
+  size_t client_written = 0, server_written = 0;
+  string client_received, server_received;
+  client.push();
+  for ( uint64_t ms = 0; client.active() or server.active(); ms++ ) {
+    if ( ms > 100'000 ) {
+      throw runtime_error( name + ": exchange did not finish" );
+    }
+    write( client, client_written );
+    write( server, server_written );
+    collect( client, to_server, true );
+    collect( server, to_client, false );
+    while ( not to_server.empty() or not to_client.empty() ) {
+      if ( not to_server.empty() ) {
+        server.receive( move( to_server.front() ) );
+        to_server.pop();
+      }
+      if ( not to_client.empty() ) {
+        client.receive( move( to_client.front() ) );
+        to_client.pop();
+      }
+      drain( server, server_received );
+      drain( client, client_received );
+      write( client, client_written );
+      write( server, server_written );
+      collect( client, to_server, true );
+      collect( server, to_client, false );
+    }
+    client.tick( 1 );
+    server.tick( 1 );
+  }
+
+  if ( client_received != data or server_received != data ) {
+    throw runtime_error( name + ": mismatch between data written and read" );
+  }
+  return stats;
+}
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    string data( 300'000, 0 );
+    for ( auto& ch : data ) {
+      ch = static_cast<char>( rd() );
+    }
+
+    // the default config's SYN carries no options at all; an MSS other than the default is offered
+    TCPConfig cfg;
+    for ( const size_t mss : { TCPConfig::MAX_PAYLOAD_SIZE, size_t { 1460 } } ) {
+      cfg.mss = static_cast<uint16_t>( mss );
+      TCPPeer peer { cfg };
+      peer.push();
+      const auto syn = peer.maybe_send();
+      if ( not syn.has_value() or not syn->sender_message.SYN ) {
+        throw runtime_error( "peer did not send a SYN" );
+      }
+      const auto offered = syn->receiver_message.mss;
+      if ( offered.has_value() != ( mss != TCPConfig::MAX_PAYLOAD_SIZE ) or offered.value_or( mss ) != mss ) {
+        throw runtime_error( "SYN with an MSS of " + to_string( mss ) + " has the wrong MSS option" );
+      }
+      if ( mss == TCPConfig::MAX_PAYLOAD_SIZE and syn->options_length() != 0 ) {
+        throw runtime_error( "default SYN carries options" );
+      }
+    }
+
+    cfg.timestamps = true;
+    cfg.sack = true;
+    cfg.rt_timeout = 10;
+
+    // full-sized segments carry 1448 bytes beside the 12 bytes of the timestamps option
+    const OptionStats stats = exchange( "timestamps and SACK", cfg, cfg, data );
+    if ( stats.largest_payload != 1448 ) {
+      throw runtime_error( "largest payload was " + to_string( stats.largest_payload ) + ", not 1448" );
+    }
+    if ( stats.data_segments_with_sack == 0 ) {
+      throw runtime_error( "no data segment carried SACK blocks" );
+    }
+
+    // PLPMTUD probes leave the same room (and some are lost, so probing may stop short of the MSS)
+    cfg.mtu_probing = true;
+    const OptionStats probed = exchange( "timestamps and SACK, probing", cfg, cfg, data );
+    if ( probed.largest_payload <= TCPConfig::MAX_PAYLOAD_SIZE ) {
+      throw runtime_error( "probing never raised the segment size" );
+    }
+
+    // SACK offered by one side only is never used, in either direction
+    cfg.mtu_probing = false;
+    TCPConfig no_sack = cfg;
+    no_sack.sack = false;
+    if ( exchange( "SACK offered by the client only", cfg, no_sack, data ).data_segments_with_sack != 0
+         or exchange( "SACK offered by the server only", no_sack, cfg, data ).data_segments_with_sack != 0 ) {
+      throw runtime_error( "SACK blocks sent though only one SYN offered SACK" );
+    }
+
+    // a peer that didn't offer timestamps ignores the other side's, so PAWS drops nothing
+    {
+      TCPPeer peer { TCPConfig {} };
+      const Wrap32 isn { 1000 };
+      const auto arrive = [&]( Wrap32 seqno, bool syn, string payload, uint32_t timestamp ) {
+        TCPSegment seg;
+        seg.sender_message = { seqno, syn, move( payload ), false };
+        seg.sender_message.timestamp = timestamp;
+        peer.receive( move( seg ) );
+      };
+      arrive( isn, true, {}, 100 );
+      arrive( isn + 1, false, "abc", 200 );
+      arrive( isn + 4, false, "def", 150 );
+      if ( peer.inbound_reader().bytes_buffered() != 6 ) {
+        throw runtime_error( "PAWS applied though timestamps were not negotiated" );
+      }
+      const auto reply = peer.maybe_send();
+      if ( not reply.has_value() or reply->receiver_message.timestamp_echo.has_value()
+           or reply->sender_message.timestamp.has_value() ) {
+        throw runtime_error( "timestamps sent though they were not negotiated" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,328 @@
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+using namespace std::chrono;
+
+struct TransferStats
+{
+  size_t data_segments {};  // segments from the sender carrying payload
+  size_t other_segments {}; // everything else in either direction (handshake, ACKs, FINs)
+  size_t drops {};          // segments dropped at a full bottleneck queue
+  uint64_t recv_capacity {}; // the server's receive capacity at the end
+  uint64_t simulated_ms {};
+  double seconds {};
+};
+
+// How the client application writes: every `period_ms`, `writes_per_round` writes of up to `write_size` bytes,
+// each handed to the TCPPeer right away (as TCPMinnowSocket does), optionally corking around the batch.
+struct Workload
+{
+  size_t write_size = SIZE_MAX;
+  size_t writes_per_round = 1;
+  bool cork = false;
+  uint64_t period_ms = 1;
+};
+
+// One direction of the network path: a bottleneck of `bytes_per_ms` (0 = unlimited) with room for
+// `queue_limit` segments, followed by `delay_ms` of propagation delay.
+struct LinkModel
+{
+  uint64_t delay_ms = 0;
+  uint64_t bytes_per_ms = 0;
+  size_t queue_limit = SIZE_MAX;
+};
+
+class Link
+{
+  LinkModel model_;
+  queue<TCPSegment> waiting_ {};
+  queue<pair<uint64_t, TCPSegment>> propagating_ {}; // with arrival times
+  uint64_t credit_ {};
+
+  static uint64_t wire_size( const TCPSegment& seg )
+  {
+    return seg.header_length() + seg.sender_message.payload.size();
+  }
+
+public:
+  size_t drops {};
+
+  explicit Link( const LinkModel& model ) : model_( model ) {}
+
+  void send( TCPSegment seg, uint64_t now )
+  {
+    if ( model_.bytes_per_ms == 0 ) {
+      propagating_.emplace( now + model_.delay_ms, move( seg ) );
+    } else if ( waiting_.size() >= model_.queue_limit ) {
+      drops++;
+    } else {
+      waiting_.push( move( seg ) );
+    }
+  }
+
+  // Let one millisecond's worth of bytes through the bottleneck
+  void advance( uint64_t now )
+  {
+    credit_ += model_.bytes_per_ms;
+    while ( not waiting_.empty() and credit_ >= wire_size( waiting_.front() ) ) {
+      credit_ -= wire_size( waiting_.front() );
+      propagating_.emplace( now + model_.delay_ms, move( waiting_.front() ) );
+      waiting_.pop();
+    }
+    if ( waiting_.empty() ) {
+      credit_ = min( credit_, model_.bytes_per_ms );
+    }
+  }
+
+  optional<TCPSegment> receive( uint64_t now )
+  {
+    if ( propagating_.empty() or propagating_.front().first > now ) {
+      return {};
+    }
+    TCPSegment seg = move( propagating_.front().second );
+    propagating_.pop();
+    return seg;
+  }
+};
+
+// Serialize the segment and parse it back, the way it would cross a real network
+static TCPSegment over_the_wire( TCPSegment seg )
+{
+  seg.compute_checksum( 0 );
+  TCPSegment ret;
+  if ( not parse( ret, serialize( seg ), uint32_t { 0 } ) ) {
+    throw runtime_error( "TCPSegment did not survive serialization" );
+  }
+  return ret;
+}
+
+// Carry `data` from one TCPPeer to another. Like TCPMinnowSocket, each peer is asked for outgoing segments after
+// every segment it receives. Each round advances the clock by one millisecond; by default the link delivers
+// everything sent in a round.
+static TransferStats transfer( const string& data,
+                               const TCPConfig& cfg,
+                               const Workload& workload,
+                               const LinkModel& path )
+{
+  TCPPeer client { cfg }, server { cfg };
+  Link to_server { path }, to_client { path };
+  TransferStats stats;
+  string received;
+  received.reserve( data.size() );
+  size_t written = 0;
+
+  const auto collect = [&stats]( TCPPeer& peer, Link& link ) {
+    while ( auto seg = peer.maybe_send() ) {
+      ( seg->sender_message.payload.empty() ? stats.other_segments : stats.data_segments )++;
+      link.send( over_the_wire( move( seg.value() ) ), stats.simulated_ms );
+    }
+  };
+
+  const auto deliver = [&collect, &stats]( Link& link, TCPPeer& peer, Link& reply_link ) {
+    while ( auto seg = link.receive( stats.simulated_ms ) ) {
+      peer.receive( move( seg.value() ) );
+      collect( peer, reply_link );
+    }
+  };
+
+  const auto start_time = steady_clock::now();
+  client.push();
+  while ( client.active() or server.active() ) {
+    if ( stats.simulated_ms > 600'000 ) {
+      throw runtime_error( "loopback transfer did not finish" );
+    }
+    to_server.advance( stats.simulated_ms );
+    to_client.advance( stats.simulated_ms );
+
+    // The client application writes as much as fits, then closes.
+    if ( stats.simulated_ms % workload.period_ms == 0 ) {
+      if ( workload.cork ) {
+        client.cork();
+      }
+      for ( size_t i = 0; i < workload.writes_per_round and written < data.size(); i++ ) {
+        const size_t len
+          = min( { data.size() - written, workload.write_size, client.outbound_writer().available_capacity() } );
+        client.outbound_writer().push( data.substr( written, len ) );
+        written += len;
+        if ( written == data.size() ) {
+          client.outbound_writer().close();
+        }
+        client.push();
+        collect( client, to_server );
+      }
+      if ( workload.cork ) {
+        client.uncork();
+      }
+    }
+    collect( client, to_server );
+    deliver( to_server, server, to_client );
+
+    // The server application reads everything, and closes its side once the client has finished.
+    Reader& reader = server.inbound_reader();
+    while ( reader.bytes_buffered() ) {
+      const auto peeked = reader.peek();
+      received.append( peeked );
+      reader.pop( peeked.size() );
+    }
+    if ( reader.is_finished() and not server.outbound_writer().is_closed() ) {
+      server.outbound_writer().close();
+    }
+    collect( server, to_client );
+    deliver( to_client, client, to_server );
+
+    client.tick( 1 );
+    server.tick( 1 );
+    collect( client, to_server );
+    collect( server, to_client );
+    stats.simulated_ms++;
+  }
+  stats.seconds = duration_cast<duration<double>>( steady_clock::now() - start_time ).count();
+  stats.drops = to_server.drops + to_client.drops;
+  stats.recv_capacity = server.inbound_reader().writer().capacity();
+
+  if ( received != data ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  return stats;
+}
+
+static TransferStats report( const string& label,
+                             const string& data,
+                             const TCPConfig& cfg,
+                             const Workload& workload = {},
+                             const LinkModel& path = {} )
+{
+  const TransferStats stats = transfer( data, cfg, workload, path );
+  const double kilobytes = static_cast<double>( data.size() ) / 1000;
+  const double packets = static_cast<double>( stats.data_segments + stats.other_segments );
+
+  cout << "TCPPeer loopback (" << label << "): " << stats.data_segments << " data + " << stats.other_segments
+       << " other segments, " << fixed << setprecision( 2 ) << packets / kilobytes << " packets/KB, "
+       << stats.drops << " drops, " << stats.recv_capacity << " byte receive buffer, " << stats.simulated_ms
+       << " ms simulated, "
+       << static_cast<double>( data.size() ) * 8 / stats.seconds / 1e9 << " Gbit/s.\n";
+
+  return stats;
+}
+
+void program_body()
+{
+  const string data = [] {
+    default_random_engine rd { 1729 };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < 10'000'000; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  TCPConfig immediate;
+  immediate.ack_delay_ms = 0;
+  const auto baseline = report( "ACK every segment", data, immediate );
+
+  TCPConfig delayed;
+  delayed.ack_delay_ms = 40;
+  const auto coalesced = report( "delayed ACK, 40 ms", data, delayed );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "      TCPPeer delayed ACK saves: " << baseline.other_segments - coalesced.other_segments
+               << " of " << baseline.other_segments << " ACKs\n";
+
+  if ( coalesced.other_segments * 10 > baseline.other_segments * 6 ) {
+    throw runtime_error( "Delayed ACKs did not cut the ACK count by at least 40%." );
+  }
+
+  size_t previous_segments = SIZE_MAX;
+  for ( const uint16_t mss : { 1000, 1460, 8960 } ) {
+    TCPConfig cfg;
+    cfg.mss = mss;
+    const auto stats = report( "MSS " + to_string( mss ), data, cfg );
+    if ( stats.data_segments >= previous_segments ) {
+      throw runtime_error( "A larger MSS did not reduce the number of segments." );
+    }
+    previous_segments = stats.data_segments;
+  }
+
+  TCPConfig probing;
+  probing.mss = 8960;
+  probing.mtu_probing = true;
+  report( "MSS 8960, probing up from 1000", data, probing );
+
+  // A chatty application: 16 writes of 10 bytes every millisecond
+  const string chatter = data.substr( 0, 200'000 );
+  const Workload small_writes { 10, 16, false, 1 };
+  const auto uncoalesced = report( "10-byte writes", chatter, TCPConfig {}, small_writes );
+
+  TCPConfig nagle;
+  nagle.nagle = true;
+  const auto nagled = report( "10-byte writes, Nagle", chatter, nagle, small_writes );
+  report( "10-byte writes, corked per batch", chatter, TCPConfig {}, { 10, 16, true, 1 } );
+
+  if ( nagled.data_segments * 4 > uncoalesced.data_segments ) {
+    throw runtime_error( "Nagle did not coalesce small writes." );
+  }
+
+  // 16 KB responses every 100 ms over a 1 KB/ms bottleneck with a 4-segment queue and a 20 ms RTT
+  const string responses = data.substr( 0, 800'000 );
+  const Workload bursty { 16'000, 1, false, 100 };
+  const LinkModel shallow { 10, 1000, 4 };
+  TCPConfig unpaced;
+  unpaced.recv_capacity = 16'000;
+  const auto bursts = report( "bursty, shallow queue", responses, unpaced, bursty, shallow );
+
+  TCPConfig paced = unpaced;
+  paced.pacing = true;
+  const auto smoothed = report( "bursty, shallow queue, paced", responses, paced, bursty, shallow );
+
+  if ( smoothed.drops * 4 > bursts.drops ) {
+    throw runtime_error( "Pacing did not reduce burst losses." );
+  }
+
+  // 2 MB over a 10 KB/ms path with a 20 ms RTT (200 KB in flight to fill it), starting from a 16 KB window
+  const string bulk = data.substr( 0, 2'000'000 );
+  const LinkModel long_fat { 10, 10'000, SIZE_MAX };
+  TCPConfig small_window;
+  small_window.recv_capacity = 16'000;
+  small_window.window_scale = true; // to advertise a window grown past 64 KB
+  const auto fixed_window = report( "long fat path, 16 KB window", bulk, small_window, {}, long_fat );
+
+  TCPConfig autotuned = small_window;
+  autotuned.recv_capacity_max = 1'000'000;
+  const auto tuned = report( "long fat path, 16 KB window autotuned", bulk, autotuned, {}, long_fat );
+
+  if ( tuned.simulated_ms * 4 > fixed_window.simulated_ms ) {
+    throw runtime_error( "Receive-window autotuning did not speed up the transfer." );
+  }
+  if ( tuned.recv_capacity >= autotuned.recv_capacity_max ) {
+    throw runtime_error( "Receive-window autotuning grew past what the path needs." );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
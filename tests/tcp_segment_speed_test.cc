@@ -0,0 +1,94 @@
+#include "parser.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+// Count every heap allocation made by the program
+static size_t allocations = 0;
+
+void* operator new( size_t size )
+{
+  allocations++;
+  if ( void* const ret = malloc( max<size_t>( size, 1 ) ) ) { // NOLINT(*-no-malloc)
+    return ret;
+  }
+  throw bad_alloc {};
+}
+
+void operator delete( void* ptr ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc)
+}
+
+void operator delete( void* ptr, size_t /* size */ ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc)
+}
+
+// Serialize `seg` many times, reporting the heap allocations and time per segment
+static void serialize_test( const string& name, const TCPSegment& seg )
+{
+  constexpr size_t repetitions = 1'000'000;
+  size_t total_size = 0;
+
+  const size_t allocations_before = allocations;
+  const auto start = steady_clock::now();
+  for ( size_t i = 0; i < repetitions; i++ ) {
+    for ( const auto& buffer : serialize( seg ) ) {
+      total_size += buffer.size();
+    }
+  }
+  const auto elapsed = steady_clock::now() - start;
+  const size_t allocations_made = allocations - allocations_before;
+
+  if ( total_size != repetitions * ( seg.header_length() + seg.sender_message.payload.size() ) ) {
+    throw runtime_error( name + ": serialized segment had the wrong length" );
+  }
+
+  cout << "TCPSegment::serialize, " << left << setw( 20 ) << name << right << fixed << setprecision( 2 )
+       << static_cast<double>( allocations_made ) / repetitions << " allocations/segment, " << setprecision( 0 )
+       << static_cast<double>( duration_cast<nanoseconds>( elapsed ).count() ) / repetitions << " ns/segment\n";
+}
+
+void program_body()
+{
+  TCPSegment ack;
+  ack.receiver_message.ackno = Wrap32 { 1000 };
+  ack.receiver_message.window_size = 65535;
+  ack.sender_message.seqno = Wrap32 { 12345 };
+  serialize_test( "bare ACK", ack );
+
+  TCPSegment small = ack;
+  small.sender_message.payload = string( 1, 'x' );
+  serialize_test( "1-byte payload", small );
+
+  TCPSegment full = ack;
+  full.sender_message.payload = string( 1000, 'x' );
+  serialize_test( "1000-byte payload", full );
+
+  TCPSegment stamped = full;
+  stamped.sender_message.timestamp = 1;
+  stamped.receiver_message.timestamp_echo = 2;
+  serialize_test( "with timestamps", stamped );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
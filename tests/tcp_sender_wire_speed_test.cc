@@ -0,0 +1,91 @@
+#include "byte_stream.hh"
+#include "tcp_config.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_sender.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+using namespace std::chrono;
+
+// Stream `segments` full-sized segments from a TCPSender onto the wire: each is wrapped in an IPv4 datagram (which
+// computes its TCP checksum) and serialized, and then acknowledged at once. With `resum`, the sum the sender took
+// of each payload while reading it from the stream is dropped, so the checksum has to sum the payload again.
+static void transfer( const string& name, size_t segments, bool resum )
+{
+  TCPOverIPv4Adapter adapter;
+  adapter.config_mut().source = Address { "10.0.0.2", 10000 };
+  adapter.config_mut().destination = Address { "10.0.0.1", 80 };
+
+  ByteStream stream { 64 * TCPConfig::MAX_PAYLOAD_SIZE };
+  TCPSender sender { TCPConfig::TIMEOUT_DFLT, Wrap32 { 0 } };
+  const string chunk( TCPConfig::MAX_PAYLOAD_SIZE, 'x' );
+
+  size_t sent = 0;
+  size_t wire_bytes = 0;
+  bool checked = false;
+  const auto start = steady_clock::now();
+  while ( sent < segments ) {
+    while ( stream.writer().available_capacity() >= chunk.size() ) {
+      stream.writer().push( chunk );
+    }
+    sender.push( stream.reader() );
+
+    Wrap32 ackno { 0 };
+    while ( auto msg = sender.maybe_send() ) {
+      TCPSegment seg;
+      seg.sender_message = move( msg.value() );
+      if ( resum ) {
+        seg.sender_message.payload_checksum.reset();
+      }
+      ackno = seg.sender_message.seqno + seg.sender_message.sequence_length();
+
+      const InternetDatagram dgram = adapter.wrap_tcp_in_ip( seg );
+      for ( const auto& buffer : serialize( dgram ) ) {
+        wire_bytes += buffer.size();
+      }
+      if ( not checked and not seg.sender_message.payload.empty() ) {
+        if ( not TCPSegmentView { dgram.payload, dgram.header.pseudo_checksum() }.valid() ) {
+          throw runtime_error( name + ": segment on the wire has a bad checksum" );
+        }
+        checked = true;
+      }
+      sent++;
+    }
+    sender.receive( { ackno, UINT16_MAX } );
+  }
+  const double seconds = duration_cast<duration<double>>( steady_clock::now() - start ).count();
+
+  if ( not checked or wire_bytes < segments * TCPConfig::MAX_PAYLOAD_SIZE / 2 ) {
+    throw runtime_error( name + ": too little was sent" );
+  }
+
+  cout << "TCPSender to wire, " << left << setw( 28 ) << name << right << fixed << setprecision( 2 ) << setw( 6 )
+       << static_cast<double>( sent ) / seconds / 1e6 << " M segments/s, " << setprecision( 1 ) << setw( 5 )
+       << static_cast<double>( wire_bytes ) * 8 / seconds / 1e9 << " Gbit/s\n";
+}
+
+void program_body()
+{
+  constexpr size_t segments = 200'000;
+  transfer( "summed while read", segments, false );
+  transfer( "summed again at the wire", segments, true );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+#include "exception.hh"
+#include "random.hh"
+#include "tcp_sharded_runtime.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static string read_to_eof( LocalStreamSocket& socket )
+{
+  string ret;
+  while ( not socket.eof() ) {
+    string data;
+    socket.read( data );
+    ret += data;
+  }
+  return ret;
+}
+
+static void write_all( LocalStreamSocket& socket, string_view data )
+{
+  while ( not data.empty() ) {
+    data.remove_prefix( socket.write( data ) );
+  }
+}
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      constexpr size_t shard_count = 4;
+      constexpr size_t connection_count = 32;
+
+      // each client queue is joined to the server queue with the same index, as a multi-queue TUN device
+      // would be to a host whose flows hash the same way
+      vector<FileDescriptor> client_queues;
+      vector<FileDescriptor> server_queues;
+      for ( size_t i = 0; i < shard_count; i++ ) {
+        array<int, 2> fds {};
+        CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+        client_queues.emplace_back( fds[0] );
+        server_queues.emplace_back( fds[1] );
+      }
+      TCPConfig cfg;
+      cfg.rt_timeout = 100;
+      TCPShardedRuntime client { move( client_queues ), cfg };
+      TCPShardedRuntime server { move( server_queues ), cfg };
+      if ( client.shard_count() != shard_count ) {
+        throw runtime_error( "wrong number of shards" );
+      }
+      server.listen( Address { "10.0.0.1", 80 } );
+
+      vector<string> messages;
+      vector<string> echoes( connection_count );
+      for ( size_t i = 0; i < connection_count; i++ ) {
+        string message( uniform_int_distribution<size_t> { 1, 20000 }( rd ), 0 );
+        for ( auto& ch : message ) {
+          ch = static_cast<char>( rd() );
+        }
+        messages.push_back( move( message ) );
+      }
+
+      vector<thread> clients;
+      for ( size_t i = 0; i < connection_count; i++ ) {
+        const Address local { "10.0.0.2", static_cast<uint16_t>( 10000 + i ) };
+        LocalStreamSocket socket = client.connect( local, Address { "10.0.0.1", 80 } );
+        clients.emplace_back( [&, i, s = move( socket )]() mutable {
+          write_all( s, messages.at( i ) );
+          s.shutdown( SHUT_WR );
+          echoes.at( i ) = read_to_eof( s );
+        } );
+      }
+
+      // the server echoes each connection from its own application thread
+      vector<thread> servers;
+      for ( size_t i = 0; i < connection_count; i++ ) {
+        auto [socket, peer] = server.accept();
+        if ( peer.ip() != "10.0.0.2" ) {
+          throw runtime_error( "accepted connection from unexpected address " + peer.to_string() );
+        }
+        servers.emplace_back( [s = move( socket )]() mutable {
+          write_all( s, read_to_eof( s ) );
+          s.shutdown( SHUT_WR );
+        } );
+      }
+
+      for ( auto& t : clients ) {
+        t.join();
+      }
+      for ( auto& t : servers ) {
+        t.join();
+      }
+      for ( size_t i = 0; i < connection_count; i++ ) {
+        if ( echoes.at( i ) != messages.at( i ) ) {
+          throw runtime_error( "connection " + to_string( i ) + " did not echo its message" );
+        }
+      }
+    }
+
+    {
+      // a shard whose queue fails stops, and calls waiting on it (or made later) fail instead of hanging
+      array<int, 2> fds {};
+      CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+      vector<FileDescriptor> queues;
+      queues.emplace_back( fds[0] );
+      FileDescriptor { fds[1] }.close(); // so the shard's first write is refused
+      TCPShardedRuntime runtime { move( queues ) };
+
+      thread acceptor { [&] {
+        try {
+          runtime.accept();
+        } catch ( const exception& ) {
+          return;
+        }
+        throw runtime_error( "accept() returned from a failed runtime" );
+      } };
+
+      const Address local { "10.0.0.2", 10000 };
+      const Address remote { "10.0.0.1", 80 };
+      bool failed = false;
+      for ( uint16_t i = 0; i < 100 and not failed; i++ ) {
+        try {
+          runtime.connect( Address { "10.0.0.2", static_cast<uint16_t>( local.port() + i ) }, remote );
+          this_thread::sleep_for( chrono::milliseconds( 10 ) );
+        } catch ( const exception& ) {
+          failed = true;
+        }
+      }
+      acceptor.join();
+      if ( not failed ) {
+        throw runtime_error( "connect() kept succeeding on a failed shard" );
+      }
+      bool listen_failed = false;
+      try {
+        runtime.listen( local );
+      } catch ( const exception& ) {
+        listen_failed = true;
+      }
+      if ( not listen_failed ) {
+        throw runtime_error( "listen() succeeded on a failed shard" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
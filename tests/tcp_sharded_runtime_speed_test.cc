@@ -0,0 +1,93 @@
+#include "exception.hh"
+#include "tcp_sharded_runtime.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// `connections` clients each send `bytes_per_connection` to the server, over `shards` pairs of datagram queues;
+// returns the aggregate throughput in Gbit/s
+static double transfer( size_t shards, size_t connections, size_t bytes_per_connection )
+{
+  vector<FileDescriptor> client_queues;
+  vector<FileDescriptor> server_queues;
+  for ( size_t i = 0; i < shards; i++ ) {
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+    client_queues.emplace_back( fds[0] );
+    server_queues.emplace_back( fds[1] );
+  }
+  TCPShardedRuntime client { move( client_queues ) };
+  TCPShardedRuntime server { move( server_queues ) };
+  server.listen( Address { "10.0.0.1", 80 } );
+
+  const string chunk( 65536, 'x' );
+  vector<size_t> received( connections );
+  vector<thread> threads;
+
+  const auto start = steady_clock::now();
+  for ( size_t i = 0; i < connections; i++ ) {
+    LocalStreamSocket socket
+      = client.connect( Address { "10.0.0.2", static_cast<uint16_t>( 10000 + i ) }, Address { "10.0.0.1", 80 } );
+    threads.emplace_back( [&, s = move( socket )]() mutable {
+      for ( size_t sent = 0; sent < bytes_per_connection; ) {
+        sent += s.write( string_view { chunk }.substr( 0, bytes_per_connection - sent ) );
+      }
+      s.shutdown( SHUT_WR );
+    } );
+  }
+  for ( size_t i = 0; i < connections; i++ ) {
+    threads.emplace_back( [&, i, s = server.accept().first]() mutable {
+      string data;
+      while ( not s.eof() ) {
+        data.clear();
+        s.read( data );
+        received.at( i ) += data.size();
+      }
+    } );
+  }
+  for ( auto& t : threads ) {
+    t.join();
+  }
+  const double seconds = duration_cast<duration<double>>( steady_clock::now() - start ).count();
+
+  for ( const auto r : received ) {
+    if ( r != bytes_per_connection ) {
+      throw runtime_error( "connection delivered " + to_string( r ) + " bytes" );
+    }
+  }
+  return static_cast<double>( connections * bytes_per_connection ) * 8 / seconds / 1e9;
+}
+
+void program_body()
+{
+  cout << "(" << thread::hardware_concurrency() << " hardware threads)\n";
+  for ( const size_t shards : { 1, 2, 4 } ) {
+    const double gbps = transfer( shards, 16, 1'000'000 );
+    cout << "TCPShardedRuntime with " << shards << " shard" << ( shards == 1 ? "" : "s" )
+         << ", 16 connections: " << fixed << setprecision( 2 ) << gbps << " Gbit/s.\n";
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "exception.hh"
+#include "io_uring.hh"
+#include "random.hh"
+#include "tcp_minnow_socket.hh"
+
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+static string read_to_eof( LocalStreamSocket& socket )
+{
+  string ret;
+  while ( not socket.eof() ) {
+    string data;
+    socket.read( data );
+    ret += data;
+  }
+  return ret;
+}
+
+static void write_all( LocalStreamSocket& socket, string_view data )
+{
+  while ( not data.empty() ) {
+    data.remove_prefix( socket.write( data ) );
+  }
+}
+
+// Transfer a message each way between a socket whose adapter uses io_uring (or falls back to system calls if
+// io_uring is unavailable) and one whose adapter makes a system call per read and write
+static void echo_test( const string& message )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  TCPOverIPv4MinnowSocket client { TCPOverIPv4OverTunFdAdapter { TunFD { FileDescriptor { fds[0] } }, true } };
+  TCPOverIPv4MinnowSocket server { TCPOverIPv4OverTunFdAdapter { TunFD { FileDescriptor { fds[1] } } } };
+
+  FdAdapterConfig server_config;
+  server_config.source = Address { "10.0.0.1", 80 };
+  thread server_thread { [&] {
+    server.listen_and_accept( {}, server_config );
+    server.set_blocking( true );
+    write_all( server, read_to_eof( server ) );
+    server.wait_until_closed();
+  } };
+
+  FdAdapterConfig client_config;
+  client_config.source = Address { "10.0.0.2", 12345 };
+  client_config.destination = server_config.source;
+  client.connect( {}, client_config );
+  client.set_blocking( true );
+  write_all( client, message );
+  client.shutdown( SHUT_WR );
+  const string echo = read_to_eof( client );
+  client.wait_until_closed();
+  server_thread.join();
+
+  if ( echo != message ) {
+    throw runtime_error( "echo of " + to_string( message.size() ) + " bytes came back as "
+                         + to_string( echo.size() ) + " bytes" );
+  }
+}
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    if ( not IOUring::supported() ) {
+      cerr << "Note: io_uring is not available; testing the fallback to system calls.\n";
+    }
+
+    // the adapter reports which engine it ended up with
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+    const TCPOverIPv4OverTunFdAdapter with_uring { TunFD { FileDescriptor { fds[0] } }, true };
+    const TCPOverIPv4OverTunFdAdapter without_uring { TunFD { FileDescriptor { fds[1] } } };
+    if ( with_uring.uses_io_uring() != IOUring::supported() or without_uring.uses_io_uring() ) {
+      throw runtime_error( "adapter chose the wrong I/O engine" );
+    }
+
+    for ( const size_t size : { 0, 1, 1000, 100000 } ) {
+      string message( size, 0 );
+      for ( auto& ch : message ) {
+        ch = static_cast<char>( rd() );
+      }
+      echo_test( message );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
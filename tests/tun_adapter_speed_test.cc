@@ -0,0 +1,101 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "io_uring.hh"
+#include "tuntap_adapter.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+
+using namespace std;
+using namespace std::chrono;
+
+// Send `packets` TCP segments through a pair of TCPOverIPv4OverTunFdAdapters joined by a datagram socketpair
+// (standing in for a TUN device), in bursts of `burst`, with the receiver waiting on an EventLoop
+static void transfer( bool use_io_uring, size_t packets, size_t burst )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  TCPOverIPv4OverTunFdAdapter sender { TunFD { FileDescriptor { fds[0] } }, use_io_uring };
+  TCPOverIPv4OverTunFdAdapter receiver { TunFD { FileDescriptor { fds[1] } }, use_io_uring };
+  sender.config_mut().source = Address { "10.0.0.2", 10000 };
+  sender.config_mut().destination = Address { "10.0.0.1", 80 };
+  receiver.config_mut().source = sender.config().destination;
+  receiver.config_mut().destination = sender.config().source;
+
+  EventLoop loop;
+  size_t received = 0;
+  loop.add_rule( "receive TCP segment", receiver.fd(), Direction::In, [&] {
+    do {
+      if ( receiver.read() ) {
+        received++;
+      }
+    } while ( receiver.read_pending() );
+  } );
+
+  TCPSegment seg;
+  seg.sender_message.payload = string( 1000, 'x' );
+
+  size_t waits = 0;
+  const PacketPool::Stats pool_before = PacketPool::local().stats();
+  const auto start = steady_clock::now();
+  for ( size_t sent = 0; sent < packets; ) {
+    for ( size_t i = 0; i < burst and sent < packets; i++, sent++ ) {
+      sender.write( seg );
+    }
+    sender.flush();
+
+    while ( received < sent ) {
+      if ( loop.wait_next_event( 1000 ) != EventLoop::Result::Success ) {
+        throw runtime_error( "datagrams lost" );
+      }
+      waits++;
+      receiver.flush();
+    }
+
+    // retire the sender's completed writes
+    while ( sender.read_pending() ) {
+      sender.read();
+    }
+  }
+  const double seconds = duration_cast<duration<double>>( steady_clock::now() - start ).count();
+
+  const size_t syscalls = sender.syscall_count() + receiver.syscall_count() + waits;
+  const PacketPool::Stats& pool = PacketPool::local().stats();
+  const auto pool_requests = static_cast<double>( pool.requests - pool_before.requests );
+  cout << ( sender.uses_io_uring() ? "io_uring" : "syscalls" ) << ", burst " << setw( 2 ) << burst << ": "
+       << fixed << setprecision( 2 ) << static_cast<double>( syscalls ) / static_cast<double>( packets )
+       << " syscalls/packet, " << setprecision( 0 ) << static_cast<double>( packets ) / seconds / 1e3
+       << " k packets/s, packet pool slabs reused "
+       << ( pool_requests > 0 ? 100 * static_cast<double>( pool.hits - pool_before.hits ) / pool_requests : 0 )
+       << "% with at most " << pool.peak_in_use << " in use.\n";
+}
+
+void program_body()
+{
+  if ( not IOUring::supported() ) {
+    cout << "(io_uring is not available; the io_uring runs fall back to system calls)\n";
+  }
+  // bursts stay under the smallest default queue length of an AF_UNIX datagram socket
+  for ( const size_t burst : { 1, 8 } ) {
+    transfer( false, 100'000, burst );
+    transfer( true, 100'000, burst );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
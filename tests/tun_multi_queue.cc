@@ -0,0 +1,102 @@
+#include "ipv4_datagram.hh"
+#include "parser.hh"
+#include "socket.hh"
+#include "tun.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <net/if.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// A device set up by `scripts/tun.sh start 144`, routing 169.254.144.0/24
+static constexpr const char* TUN_DEV = "tun144";
+static constexpr uint8_t PROTO_UDP = 17;
+
+void program_body()
+{
+  constexpr size_t queue_count = 4;
+  constexpr size_t flow_count = 64;
+
+  vector<TunFD> queues = TunFD::open_queues( TUN_DEV, queue_count );
+  if ( queues.size() != queue_count ) {
+    throw runtime_error( "wrong number of queues" );
+  }
+  // a single-queue open of the same device joins it as one more queue
+  queues.emplace_back( TUN_DEV );
+  for ( auto& queue : queues ) {
+    queue.set_blocking( false );
+  }
+
+  // one datagram per flow, each from its own source port to its own destination
+  const string marker = "multi-queue test";
+  for ( size_t i = 0; i < flow_count; i++ ) {
+    UDPSocket socket;
+    socket.sendto( Address { "169.254.144.2", static_cast<uint16_t>( 9000 + i ) }, marker );
+  }
+
+  // read every queue until each flow's datagram has turned up on one of them
+  vector<size_t> per_queue( queues.size() );
+  size_t received = 0;
+  const auto deadline = steady_clock::now() + seconds( 5 );
+  while ( received < flow_count ) {
+    if ( steady_clock::now() > deadline ) {
+      throw runtime_error( "only " + to_string( received ) + " of " + to_string( flow_count )
+                           + " datagrams came out of the device" );
+    }
+    bool idle = true;
+    for ( size_t q = 0; q < queues.size(); q++ ) {
+      const unsigned int reads_before = queues[q].read_count();
+      string packet;
+      queues[q].read( packet );
+      if ( queues[q].read_count() == reads_before ) {
+        continue; // nothing waiting on this queue
+      }
+      idle = false;
+
+      InternetDatagram dgram;
+      if ( not parse( dgram, vector<Buffer> { packet } ) or dgram.header.proto != PROTO_UDP ) {
+        continue; // other traffic on the device
+      }
+      const string_view payload = dgram.payload.empty() ? string_view {} : string_view { dgram.payload.front() };
+      if ( payload.ends_with( marker ) ) {
+        per_queue[q]++;
+        received++;
+      }
+    }
+    if ( idle ) {
+      this_thread::sleep_for( milliseconds( 1 ) );
+    }
+  }
+
+  size_t queues_used = 0;
+  for ( size_t q = 0; q < queues.size(); q++ ) {
+    cout << "queue " << q << ": " << per_queue[q] << " flows\n";
+    queues_used += per_queue[q] > 0;
+  }
+  if ( queues_used < 2 ) {
+    throw runtime_error( "the kernel did not spread flows across the queues" );
+  }
+}
+
+int main()
+{
+  try {
+    if ( if_nametoindex( TUN_DEV ) == 0 ) {
+      cerr << "Skipping: no " << TUN_DEV << " device (run `scripts/tun.sh start 144` to create it).\n";
+      return EXIT_SUCCESS;
+    }
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#include "socket.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+static void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+int main()
+{
+  try {
+    UDPSocket receiver;
+    receiver.bind( Address { "127.0.0.1", 0 } );
+    UDPSocket sender;
+    sender.bind( Address { "127.0.0.1", 0 } );
+    sender.connect( receiver.local_address() );
+
+    // one system call sends several datagrams, each gathered from its pieces
+    const vector<vector<Buffer>> datagrams { { string { "hello" } }, { string { "wor" }, string { "ld" } }, {} };
+    expect( sender.send_batch( datagrams ) == 3, "not every datagram was sent" );
+    expect( sender.write_count() == 1, "send_batch took more than one system call" );
+
+    // and one receives them, with their sender, up to the limit asked for
+    vector<DatagramSocket::Received> received;
+    expect( receiver.recv_batch( received, 2 ) == 2, "recv_batch received the wrong number of datagrams" );
+    expect( receiver.read_count() == 1, "recv_batch took more than one system call" );
+    expect( received.at( 0 ).payload == "hello" and received.at( 1 ).payload == "world",
+            "recv_batch received the wrong payloads" );
+    expect( received.at( 0 ).source == sender.local_address(), "recv_batch reported the wrong source" );
+
+    // the rest are left for the next call, which appends them
+    expect( receiver.recv_batch( received, 8 ) == 1 and received.size() == 3 and received.back().payload.empty(),
+            "the empty datagram was not received" );
+
+    // a non-blocking socket with nothing waiting receives nothing; each call takes slabs only to replace the ones
+    // the call before handed out (here, the empty datagram's)
+    receiver.set_blocking( false );
+    uint64_t requests_before = PacketPool::local().stats().requests;
+    expect( receiver.recv_batch( received, 8 ) == 0 and received.size() == 3, "received from an empty socket" );
+    expect( PacketPool::local().stats().requests == requests_before + 1, "recv_batch took slabs it already had" );
+    requests_before = PacketPool::local().stats().requests;
+
+    // unconnected, the destination is given with the batch
+    UDPSocket other;
+    const string_view payload = "to an address";
+    expect( other.sendto_batch( receiver.local_address(), { { Buffer { string { payload } } } } ) == 1,
+            "sendto_batch did not send" );
+    receiver.set_blocking( true );
+    expect( receiver.recv_batch( received, 8 ) == 1 and received.back().payload == payload,
+            "sendto_batch sent the wrong payload" );
+    expect( PacketPool::local().stats().requests == requests_before,
+            "recv_batch took slabs after a call that handed none out" );
+
+    // a datagram too long for `max_size` is dropped and counted, and the ones after it still arrive
+    expect( sender.send_batch( { { string( 100, 'x' ) }, { string { "fits" } } } ) == 2,
+            "send_batch did not send" );
+    expect( receiver.recv_batch( received, 8, 10 ) == 1 and received.back().payload == "fits",
+            "recv_batch did not skip the oversized datagram" );
+    expect( receiver.truncated_count() == 1, "the oversized datagram was not counted" );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
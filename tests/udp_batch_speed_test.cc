@@ -0,0 +1,96 @@
+#include "eventloop.hh"
+#include "socket.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Send `packets` datagrams over a loopback UDP pair, in bursts of up to 64 (which the socket buffers hold without
+// dropping), moving `batch` datagrams per system call on each side; the receiver waits on an EventLoop whose rule
+// drains up to a batch per readiness event. A batch of 0 uses the one-datagram sendto() and recv() instead.
+static void transfer( size_t packets, size_t batch )
+{
+  constexpr size_t burst = 64;
+  constexpr size_t payload_size = 100;
+
+  UDPSocket receiver;
+  receiver.bind( Address { "127.0.0.1", 0 } );
+  UDPSocket sender;
+  const Address destination = receiver.local_address();
+
+  EventLoop loop;
+  size_t received = 0;
+  loop.add_rule( "receive datagrams", receiver, Direction::In, [&] {
+    if ( batch == 0 ) {
+      Address source { "127.0.0.1" };
+      string payload;
+      receiver.recv( source, payload );
+      received++;
+      return;
+    }
+    vector<DatagramSocket::Received> datagrams;
+    received += receiver.recv_batch( datagrams, batch, PacketPool::MTU_SLAB );
+    for ( auto& datagram : datagrams ) {
+      PacketPool::local().give( move( datagram.payload ) ); // as a Buffer holding it would, once done with it
+    }
+  } );
+
+  const vector<Buffer> datagram { string( payload_size, 'x' ) };
+  const size_t syscalls_before = sender.write_count() + receiver.read_count();
+  const auto start = steady_clock::now();
+  for ( size_t sent = 0; sent < packets; ) {
+    const size_t this_burst = min( burst, packets - sent );
+    for ( size_t i = 0; i < this_burst; ) {
+      if ( batch == 0 ) {
+        sender.sendto( destination, string_view { datagram.front() } );
+        i++;
+        continue;
+      }
+      const vector<vector<Buffer>> datagrams( min( batch, this_burst - i ), datagram );
+      i += sender.sendto_batch( destination, datagrams );
+    }
+    sent += this_burst;
+
+    while ( received < sent ) {
+      if ( loop.wait_next_event( 1000 ) != EventLoop::Result::Success ) {
+        throw runtime_error( "datagrams lost" );
+      }
+    }
+  }
+  const double seconds = duration_cast<duration<double>>( steady_clock::now() - start ).count();
+  const size_t syscalls = sender.write_count() + receiver.read_count() - syscalls_before;
+
+  const string name = batch == 0 ? "sendto/recv" : "batch of " + to_string( batch );
+  cout << left << setw( 13 ) << name << right << fixed << setprecision( 2 ) << setw( 6 )
+       << static_cast<double>( packets ) / seconds / 1e6 << " M packets/s, "
+       << static_cast<double>( syscalls ) / static_cast<double>( packets ) << " send/recv calls per packet\n";
+}
+
+void program_body()
+{
+  constexpr size_t packets = 200'000;
+  for ( const size_t batch : { 0UL, 1UL, 8UL, 64UL } ) {
+    transfer( packets, batch );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -30,30 +30,15 @@ string ARPMessage::to_string() const
   return ss.str();
 }
 
+static_assert( ARPMessage::serialized_length() == ARPMessage::LENGTH );
+
 void ARPMessage::parse( Parser& parser )
 {
-  parser.integer( hardware_type );
-  parser.integer( protocol_type );
-  parser.integer( hardware_address_size );
-  parser.integer( protocol_address_size );
-  parser.integer( opcode );
+  Layout::parse( parser, *this );
 
   if ( not supported() ) {
     parser.set_error();
-    return;
-  }
-
-  // read sender addresses (Ethernet and IP)
-  for ( auto& b : sender_ethernet_address ) {
-    parser.integer( b );
-  }
-  parser.integer( sender_ip_address );
-
-  // read target addresses (Ethernet and IP)
-  for ( auto& b : target_ethernet_address ) {
-    parser.integer( b );
   }
-  parser.integer( target_ip_address );
 }
 
 void ARPMessage::serialize( Serializer& serializer ) const
@@ -62,21 +47,5 @@ void ARPMessage::serialize( Serializer& serializer ) const
     throw runtime_error( "ARPMessage: unsupported field combination (must be Ethernet/IP, and request or reply)" );
   }
 
-  serializer.integer( hardware_type );
-  serializer.integer( protocol_type );
-  serializer.integer( hardware_address_size );
-  serializer.integer( protocol_address_size );
-  serializer.integer( opcode );
-
-  // read sender addresses (Ethernet and IP)
-  for ( const auto& b : sender_ethernet_address ) {
-    serializer.integer( b );
-  }
-  serializer.integer( sender_ip_address );
-
-  // read target addresses (Ethernet and IP)
-  for ( const auto& b : target_ethernet_address ) {
-    serializer.integer( b );
-  }
-  serializer.integer( target_ip_address );
+  Layout::serialize( serializer, *this );
 }
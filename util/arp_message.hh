@@ -3,6 +3,7 @@
 #include "ethernet_header.hh"
 #include "ipv4_header.hh"
 #include "parser.hh"
+#include "wire_layout.hh"
 
 // [ARP](\ref rfc::rfc826) message
 struct ARPMessage
@@ -12,6 +13,8 @@ struct ARPMessage
   static constexpr uint16_t OPCODE_REQUEST = 1;
   static constexpr uint16_t OPCODE_REPLY = 2;
 
+  static constexpr uint64_t serialized_length() { return Layout::length; }
+
   uint16_t hardware_type = TYPE_ETHERNET;             // Type of the link-layer protocol (generally Ethernet/Wi-Fi)
   uint16_t protocol_type = EthernetHeader::TYPE_IPv4; // Type of the Internet-layer protocol (generally IPv4)
   uint8_t hardware_address_size = sizeof( EthernetHeader::src );
@@ -32,4 +35,14 @@ struct ARPMessage
 
   void parse( Parser& parser );
   void serialize( Serializer& serializer ) const;
+
+  using Layout = wire::Layout<wire::Integer<0, &ARPMessage::hardware_type>,
+                              wire::Integer<2, &ARPMessage::protocol_type>,
+                              wire::Integer<4, &ARPMessage::hardware_address_size>,
+                              wire::Integer<5, &ARPMessage::protocol_address_size>,
+                              wire::Integer<6, &ARPMessage::opcode>,
+                              wire::Bytes<8, &ARPMessage::sender_ethernet_address>,
+                              wire::Integer<14, &ARPMessage::sender_ip_address>,
+                              wire::Bytes<18, &ARPMessage::target_ethernet_address>,
+                              wire::Integer<24, &ARPMessage::target_ip_address>>;
 };
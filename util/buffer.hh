@@ -1,23 +1,274 @@
 #pragma once
 
-#include <memory>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+// A per-thread pool of packet-sized strings ("slabs") of two fixed capacities: one for a datagram of up to an
+// Ethernet MTU (where a datagram read from a FileDescriptor lands), and one for the largest read of a
+// FileDescriptor (a jumbo frame, or a stream read). A Buffer holding a slab gives it back to the pool of the thread
+// that drops the last reference to it.
+class PacketPool
+{
+public:
+  static constexpr size_t MTU_SLAB = 2048;
+  static constexpr size_t JUMBO_SLAB = 16384;
+
+  struct Stats
+  {
+    uint64_t requests {};     // slabs asked for with take()
+    uint64_t hits {};         // of those, how many were reused from the pool
+    size_t in_use {};         // slabs taken and not yet given back
+    size_t peak_in_use {};    // the most slabs in use at once
+    uint64_t copies {};       // payloads copied out of the storage they arrived in (see count_copy())
+    uint64_t copied_bytes {}; // the bytes those copies took
+  };
+
+  static PacketPool& local()
+  {
+    thread_local PacketPool pool;
+    return pool;
+  }
+
+  // An empty string with room for at least `capacity` bytes, from a slab if it fits in one
+  std::string take( size_t capacity )
+  {
+    std::vector<std::string>* const slabs = free_list( capacity );
+    if ( not slabs ) {
+      std::string ret;
+      ret.reserve( capacity );
+      return ret;
+    }
+
+    stats_.requests++;
+    stats_.in_use++;
+    stats_.peak_in_use = std::max( stats_.peak_in_use, stats_.in_use );
+    if ( not slabs->empty() ) {
+      stats_.hits++;
+      std::string ret = std::move( slabs->back() );
+      slabs->pop_back();
+      return ret;
+    }
+    std::string ret;
+    ret.reserve( capacity <= MTU_SLAB ? MTU_SLAB : JUMBO_SLAB );
+    return ret;
+  }
+
+  // Keep `str` for reuse if it is a slab (and the pool is not full)
+  void give( std::string&& str )
+  {
+    const size_t capacity = str.capacity();
+    if ( capacity != MTU_SLAB and capacity != JUMBO_SLAB ) {
+      return;
+    }
+    stats_.in_use -= std::min<size_t>( stats_.in_use, 1 ); // taken on another thread, if none are out here
+    std::vector<std::string>& slabs = capacity == MTU_SLAB ? mtu_slabs_ : jumbo_slabs_;
+    if ( slabs.size() < MAX_FREE_SLABS ) {
+      str.clear();
+      slabs.push_back( std::move( str ) );
+    }
+  }
+
+  // Note that a Buffer's bytes were copied into new storage (by compact(), by unsharing it, or by joining a
+  // payload that arrived in pieces), so tests can check that data moves through without being copied
+  void count_copy( size_t bytes )
+  {
+    stats_.copies++;
+    stats_.copied_bytes += bytes;
+  }
+
+  const Stats& stats() const { return stats_; }
+  double hit_rate() const
+  {
+    return stats_.requests ? static_cast<double>( stats_.hits ) / static_cast<double>( stats_.requests ) : 0;
+  }
+
+private:
+  static constexpr size_t MAX_FREE_SLABS = 64; // of each capacity
+
+  std::vector<std::string> mtu_slabs_ {};
+  std::vector<std::string> jumbo_slabs_ {};
+  Stats stats_ {};
+
+  std::vector<std::string>* free_list( size_t capacity )
+  {
+    if ( capacity <= MTU_SLAB ) {
+      return &mtu_slabs_;
+    }
+    return capacity <= JUMBO_SLAB ? &jumbo_slabs_ : nullptr;
+  }
+};
+
+// A reference-counted string. Copies share the same storage, and substr() or remove_prefix() narrow a Buffer to a
+// slice of that storage without copying any bytes.
+//
+// A string of up to INLINE_CAPACITY bytes (a header, an empty payload, a bare ACK) is kept inside the Buffer
+// itself, so it needs no allocation and a copy just copies its bytes. A larger string is moved into a single heap
+// block together with the count of Buffers sharing it. That count is atomic, unless the program is built with
+// BUFFER_NONATOMIC_REFCOUNT defined (for programs that never share a Buffer between threads).
+//
+// Either way, a Buffer behaves as a value: the mutable std::string& (and release()) first give the Buffer storage
+// of its own, copying the bytes if they are inline, a slice, or shared with another Buffer, so a change made
+// through one Buffer is never seen through a copy of it.
+//
+// A slice keeps the whole string it was cut from alive, however few bytes it views. A Buffer that is going to be
+// held for a while (queued in a ByteStream or a Reassembler) can compact() itself so that a small payload doesn't
+// pin a whole slab.
 class Buffer
 {
-  std::shared_ptr<std::string> buffer_;
+public:
+  static constexpr size_t INLINE_CAPACITY = 64;
+
+private:
+#ifdef BUFFER_NONATOMIC_REFCOUNT
+  using RefCount = size_t;
+#else
+  using RefCount = std::atomic<size_t>;
+#endif
+
+  struct Storage
+  {
+    std::string str;
+    RefCount refs { 1 };
+  };
+
+  Storage* storage_ {}; // nullptr: the string is inline
+  size_t offset_ {};
+  size_t length_ { std::string::npos }; // npos: through the end of the string
+  uint8_t inline_size_ {};
+  std::array<char, INLINE_CAPACITY> inline_ {};
+
+  std::string_view whole() const
+  {
+    return storage_ ? std::string_view { storage_->str } : std::string_view { inline_.data(), inline_size_ };
+  }
+
+  void drop()
+  {
+    if ( storage_ and --storage_->refs == 0 ) {
+      PacketPool::local().give( std::move( storage_->str ) );
+      delete storage_; // NOLINT(*-owning-memory)
+    }
+    storage_ = nullptr;
+  }
+
+  // Before handing out the underlying string, give a slice, an inline string or storage shared with other Buffers
+  // storage of its own holding just the viewed bytes
+  void unshare()
+  {
+    if ( not storage_ or offset_ != 0 or length_ != std::string::npos or storage_->refs != 1 ) {
+      PacketPool::local().count_copy( size() );
+      auto* const storage = new Storage { std::string { std::string_view { *this } } }; // NOLINT(*-owning-memory)
+      drop();
+      storage_ = storage;
+      offset_ = 0;
+      length_ = std::string::npos;
+    }
+  }
 
 public:
   // NOLINTBEGIN(*-explicit-*)
 
-  Buffer( std::string str = {} ) : buffer_( make_shared<std::string>( std::move( str ) ) ) {}
-  operator std::string_view() const { return *buffer_; }
-  operator std::string&() { return *buffer_; }
+  Buffer( std::string str = {} )
+  {
+    if ( str.size() <= INLINE_CAPACITY ) {
+      std::ranges::copy( str, inline_.begin() );
+      inline_size_ = static_cast<uint8_t>( str.size() );
+      PacketPool::local().give( std::move( str ) );
+    } else {
+      storage_ = new Storage { std::move( str ) }; // NOLINT(*-owning-memory)
+    }
+  }
+  operator std::string_view() const { return whole().substr( offset_, length_ ); }
+  operator std::string&()
+  {
+    unshare();
+    return storage_->str;
+  }
 
   // NOLINTEND(*-explicit-*)
 
-  std::string&& release() { return std::move( *buffer_ ); }
-  size_t size() const { return buffer_->size(); }
-  size_t length() const { return buffer_->length(); }
-  bool empty() const { return buffer_->empty(); }
+  Buffer( const Buffer& other )
+    : storage_( other.storage_ )
+    , offset_( other.offset_ )
+    , length_( other.length_ )
+    , inline_size_( other.inline_size_ )
+    , inline_( other.inline_ )
+  {
+    if ( storage_ ) {
+      ++storage_->refs;
+    }
+  }
+
+  Buffer( Buffer&& other ) noexcept
+    : storage_( std::exchange( other.storage_, nullptr ) )
+    , offset_( other.offset_ )
+    , length_( other.length_ )
+    , inline_size_( other.inline_size_ )
+    , inline_( other.inline_ )
+  {}
+
+  Buffer& operator=( const Buffer& other )
+  {
+    if ( this != &other ) {
+      Buffer copy { other };
+      *this = std::move( copy );
+    }
+    return *this;
+  }
+
+  Buffer& operator=( Buffer&& other ) noexcept
+  {
+    if ( this != &other ) {
+      drop();
+      storage_ = std::exchange( other.storage_, nullptr );
+      offset_ = other.offset_;
+      length_ = other.length_;
+      inline_size_ = other.inline_size_;
+      inline_ = other.inline_;
+    }
+    return *this;
+  }
+
+  ~Buffer() { drop(); }
+
+  std::string&& release()
+  {
+    unshare();
+    return std::move( storage_->str );
+  }
+  size_t size() const { return std::string_view { *this }.size(); }
+  size_t length() const { return size(); }
+  bool empty() const { return size() == 0; }
+
+  Buffer substr( size_t pos, size_t count = std::string::npos ) const
+  {
+    Buffer ret = *this;
+    ret.remove_prefix( pos );
+    ret.length_ = std::min( count, ret.size() );
+    return ret;
+  }
+
+  // Copy the viewed bytes into storage of their own if they take up less than a quarter of the string behind them
+  void compact()
+  {
+    if ( storage_ and size() * 4 < storage_->str.capacity() ) {
+      PacketPool::local().count_copy( size() );
+      *this = Buffer { std::string { std::string_view { *this } } };
+    }
+  }
+
+  void remove_prefix( size_t n )
+  {
+    n = std::min( n, size() );
+    offset_ += n;
+    if ( length_ != std::string::npos ) {
+      length_ -= n;
+    }
+  }
 };
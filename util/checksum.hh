@@ -2,8 +2,11 @@
 
 #include "buffer.hh"
 
+#include <bit>
 #include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 
 //! The internet checksum algorithm
@@ -13,31 +16,81 @@ private:
   uint32_t sum_;
   bool parity_ {};
 
-public:
-  explicit InternetChecksum( const uint32_t sum = 0 ) : sum_( sum ) {}
-  void add( std::string_view data )
+  static uint16_t fold( uint64_t sum )
   {
-    for ( const uint8_t i : data ) {
-      uint16_t val = i;
-      if ( not parity_ ) {
-        val <<= 8;
-      }
-      sum_ += val;
-      parity_ = !parity_;
+    while ( sum > 0xffff ) {
+      sum = ( sum >> 16 ) + static_cast<uint16_t>( sum );
     }
+    return static_cast<uint16_t>( sum );
   }
 
-  uint16_t value() const
+  // The ones'-complement sum of `data` as big-endian 16-bit words (an odd last byte padded with zero), added eight
+  // bytes at a time in native order and byte-swapped at the end; with Copy, the bytes are copied to `out` as they
+  // are summed
+  template<bool Copy>
+  static uint16_t sum_words( std::string_view data, char* out )
   {
-    uint32_t ret = sum_;
+    uint64_t sum = 0;
+    size_t i = 0;
+    for ( ; i + sizeof( uint64_t ) <= data.size(); i += sizeof( uint64_t ) ) {
+      uint64_t word {};
+      std::memcpy( &word, data.data() + i, sizeof( word ) );
+      if constexpr ( Copy ) {
+        std::memcpy( out + i, &word, sizeof( word ) );
+      }
+      sum += word;
+      sum += sum < word; // end-around carry
+    }
+    if ( i < data.size() ) {
+      uint64_t word = 0;
+      std::memcpy( &word, data.data() + i, data.size() - i );
+      if constexpr ( Copy ) {
+        std::memcpy( out + i, data.data() + i, data.size() - i );
+      }
+      sum += word;
+      sum += sum < word;
+    }
 
-    while ( ret > 0xffff ) {
-      ret = ( ret >> 16 ) + static_cast<uint16_t>( ret );
+    const uint16_t folded = fold( sum );
+    return std::endian::native == std::endian::big ? folded : __builtin_bswap16( folded );
+  }
+
+  template<bool Copy>
+  void add_words( std::string_view data, char* out )
+  {
+    const bool odd_length = data.size() % 2;
+    if ( data.empty() ) {
+      return;
     }
+    if ( parity_ ) { // finish the word begun by the last byte added
+      sum_ += static_cast<uint8_t>( data.front() );
+      if constexpr ( Copy ) {
+        *out++ = data.front();
+      }
+      data.remove_prefix( 1 );
+    }
+    sum_ = fold( sum_ + static_cast<uint64_t>( sum_words<Copy>( data, out ) ) );
+    parity_ = parity_ != odd_length;
+  }
+
+public:
+  explicit InternetChecksum( const uint32_t sum = 0 ) : sum_( sum ) {}
+
+  void add( std::string_view data ) { add_words<false>( data, nullptr ); }
+
+  // Add `data` while copying it to `out` (which must have room for all of it), in a single pass over the bytes
+  void add_copy( std::string_view data, char* out ) { add_words<true>( data, out ); }
 
-    return ~ret;
+  // Add the bytes summed by `other`, as though they followed the bytes already added here
+  void add( const InternetChecksum& other )
+  {
+    const uint16_t other_sum = fold( other.sum_ );
+    sum_ = fold( static_cast<uint64_t>( sum_ ) + ( parity_ ? __builtin_bswap16( other_sum ) : other_sum ) );
+    parity_ = parity_ != other.parity_;
   }
 
+  uint16_t value() const { return static_cast<uint16_t>( ~fold( sum_ ) ); }
+
   void add( const std::vector<Buffer>& data )
   {
     for ( const auto& x : data ) {
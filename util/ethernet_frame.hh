@@ -19,6 +19,7 @@ struct EthernetFrame
 
   void serialize( Serializer& serializer ) const
   {
+    serializer.reserve( header.serialized_length() );
     header.serialize( serializer );
     serializer.buffer( payload );
   }
@@ -41,34 +41,14 @@ string EthernetHeader::to_string() const
   return ss.str();
 }
 
+static_assert( EthernetHeader::serialized_length() == EthernetHeader::LENGTH );
+
 void EthernetHeader::parse( Parser& parser )
 {
-  // read destination address
-  for ( auto& b : dst ) {
-    parser.integer( b );
-  }
-
-  // read source address
-  for ( auto& b : src ) {
-    parser.integer( b );
-  }
-
-  // read frame type (e.g. IPv4, ARP, or something else)
-  parser.integer( type );
+  Layout::parse( parser, *this );
 }
 
 void EthernetHeader::serialize( Serializer& serializer ) const
 {
-  // write destination address
-  for ( const auto& b : dst ) {
-    serializer.integer( b );
-  }
-
-  // write source address
-  for ( const auto& b : src ) {
-    serializer.integer( b );
-  }
-
-  // write frame type (e.g. IPv4, ARP, or something else)
-  serializer.integer( type );
+  Layout::serialize( serializer, *this );
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "parser.hh"
+#include "wire_layout.hh"
 
 #include <array>
 #include <cstdint>
@@ -23,6 +24,8 @@ struct EthernetHeader
   static constexpr uint16_t TYPE_IPv4 = 0x800; //!< Type number for [IPv4](\ref rfc::rfc791)
   static constexpr uint16_t TYPE_ARP = 0x806;  //!< Type number for [ARP](\ref rfc::rfc826)
 
+  static constexpr uint64_t serialized_length() { return Layout::length; }
+
   EthernetAddress dst;
   EthernetAddress src;
   uint16_t type;
@@ -32,4 +35,8 @@ struct EthernetHeader
 
   void parse( Parser& parser );
   void serialize( Serializer& serializer ) const;
+
+  using Layout = wire::Layout<wire::Bytes<0, &EthernetHeader::dst>,
+                              wire::Bytes<6, &EthernetHeader::src>,
+                              wire::Integer<12, &EthernetHeader::type>>;
 };
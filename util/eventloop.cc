@@ -5,24 +5,56 @@
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <span>
 
 using namespace std;
 
+EventLoop::EventLoop( Backend backend, Service service )
+  : _timer_wheel( TIMER_WHEEL_SLOTS )
+  , _timers_fired_through_ms( now_ms() )
+  , _backend( backend )
+  , _service( service )
+{
+  _rule_categories.reserve( 64 );
+  if ( _backend == Backend::Epoll ) {
+    _epoll_fd.emplace( CheckSystemCall( "epoll_create1", ::epoll_create1( EPOLL_CLOEXEC ) ) );
+  }
+}
+
 unsigned int EventLoop::FDRule::service_count() const
 {
   return direction == Direction::In ? fd.read_count() : fd.write_count();
 }
 
-size_t EventLoop::add_category( const string& name )
+size_t EventLoop::add_category( const string& name, unsigned budget )
 {
   if ( _rule_categories.size() >= _rule_categories.capacity() ) {
     throw runtime_error( "maximum categories reached" );
   }
+  if ( budget == 0 ) {
+    throw runtime_error( "EventLoop: category \"" + name + "\" needs a budget of at least one callback" );
+  }
 
-  _rule_categories.push_back( { name } );
+  _rule_categories.push_back( { name, budget } );
   return _rule_categories.size() - 1;
 }
 
+void EventLoop::summary( ostream& out ) const
+{
+  out << "EventLoop categories:\n";
+  for ( const auto& category : _rule_categories ) {
+    const auto& stats = category.stats;
+    const auto ms = []( chrono::nanoseconds t ) { return chrono::duration<double, milli>( t ).count(); };
+    out << "   " << left << setw( 40 ) << category.name << right << setw( 10 ) << stats.callbacks << " callbacks, "
+        << fixed << setprecision( 3 ) << ms( stats.callback_time ) << " ms in callbacks";
+    if ( stats.waits > 0 ) {
+      out << ", latency mean " << ms( stats.total_latency ) / static_cast<double>( stats.waits ) << " ms, max "
+          << ms( stats.max_latency ) << " ms";
+    }
+    out << "\n";
+  }
+}
+
 EventLoop::BasicRule::BasicRule( size_t s_category_id, InterestT s_interest, CallbackT s_callback )
   : category_id( s_category_id ), interest( move( s_interest ) ), callback( move( s_callback ) )
 {}
@@ -39,6 +71,10 @@ EventLoop::FDRule::FDRule( BasicRule&& base,
   , recover( move( s_recover ) )
 {}
 
+EventLoop::TimerRule::TimerRule( BasicRule&& base, uint64_t s_deadline_ms )
+  : BasicRule( base ), deadline_ms( s_deadline_ms )
+{}
+
 EventLoop::RuleHandle EventLoop::add_rule( size_t category_id,
                                            FileDescriptor& fd,
                                            Direction direction,
@@ -53,6 +89,13 @@ EventLoop::RuleHandle EventLoop::add_rule( size_t category_id,
 
   _fd_rules.emplace_back( make_shared<FDRule>(
     BasicRule { category_id, interest, callback }, fd.duplicate(), direction, cancel, recover ) );
+  FDRule& rule = *_fd_rules.back();
+  rule.position = prev( _fd_rules.end() );
+  if ( _backend == Backend::Epoll ) {
+    epoll_add( rule );
+    mark_dirty( rule );
+    return RuleHandle { _fd_rules.back(), this };
+  }
 
   return RuleHandle { _fd_rules.back() };
 }
@@ -70,19 +113,42 @@ EventLoop::RuleHandle EventLoop::add_rule( const size_t category_id,
   return RuleHandle { _non_fd_rules.back() };
 }
 
+EventLoop::RuleHandle EventLoop::add_timer( size_t category_id, uint64_t delay_ms, const CallbackT& callback )
+{
+  if ( category_id >= _rule_categories.size() ) {
+    throw out_of_range( "bad category_id" );
+  }
+
+  // the slots up to _timers_fired_through_ms have been looked at already
+  const uint64_t deadline_ms = max( now_ms() + delay_ms, _timers_fired_through_ms + 1 );
+  auto timer = make_shared<TimerRule>( BasicRule { category_id, [] { return true; }, callback }, deadline_ms );
+  _timer_wheel.at( deadline_ms % TIMER_WHEEL_SLOTS ).push_back( timer );
+  _timer_count++;
+
+  return RuleHandle { timer };
+}
+
 void EventLoop::RuleHandle::cancel()
 {
   const shared_ptr<BasicRule> rule_shared_ptr = rule_weak_ptr_.lock();
   if ( rule_shared_ptr ) {
     rule_shared_ptr->cancel_requested = true;
+    recheck_interest(); // so that the loop retires it
+  }
+}
+
+void EventLoop::RuleHandle::recheck_interest()
+{
+  const shared_ptr<BasicRule> rule_shared_ptr = rule_weak_ptr_.lock();
+  if ( rule_shared_ptr and loop_ ) {
+    loop_->mark_dirty( static_cast<FDRule&>( *rule_shared_ptr ) ); // only an fd rule's handle has loop_ set
   }
 }
 
 // NOLINTBEGIN(*-cognitive-complexity)
 // NOLINTBEGIN(*-signed-bitwise)
-EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
+bool EventLoop::serve_non_fd_rule()
 {
-  // first, handle the non-file-descriptor-related rules
   {
     for ( auto it = _non_fd_rules.begin(); it != _non_fd_rules.end(); ) {
       auto& this_rule = **it;
@@ -102,18 +168,217 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
         }
 
         rule_fired = true;
-        this_rule.callback();
+        run_callback( this_rule );
       }
 
       if ( rule_fired ) {
-        return Result::Success; /* only serve one rule on each iteration */
+        return true; /* only serve one rule on each iteration */
       }
 
       ++it;
     }
   }
 
-  // now the file-descriptor-related rules. poll any "interested" file descriptors
+  return false;
+}
+
+bool EventLoop::serve_non_fd_rules()
+{
+  bool rule_fired = false;
+  for ( auto it = _non_fd_rules.begin(); it != _non_fd_rules.end(); ) {
+    auto& this_rule = **it;
+    if ( this_rule.cancel_requested ) {
+      it = _non_fd_rules.erase( it );
+      continue;
+    }
+
+    const unsigned budget = _rule_categories.at( this_rule.category_id ).budget;
+    for ( unsigned i = 0; i < budget and not this_rule.cancel_requested and this_rule.interest(); i++ ) {
+      rule_fired = true;
+      run_callback( this_rule );
+    }
+    ++it;
+  }
+
+  return rule_fired;
+}
+
+void EventLoop::run_callback( BasicRule& rule )
+{
+  auto& stats = _rule_categories.at( rule.category_id ).stats;
+  const auto start = chrono::steady_clock::now();
+  rule.callback();
+  stats.callbacks++;
+  stats.callback_time += chrono::steady_clock::now() - start;
+}
+
+uint64_t EventLoop::now_ms()
+{
+  return chrono::duration_cast<chrono::milliseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+bool EventLoop::fire_timers()
+{
+  const uint64_t now = now_ms();
+  if ( now <= _timers_fired_through_ms ) {
+    return false;
+  }
+
+  // look at the slot for each time since the last look, but at each slot only once
+  const uint64_t first = _timers_fired_through_ms + 1;
+  const uint64_t last = min( now, first + TIMER_WHEEL_SLOTS - 1 );
+  _timers_fired_through_ms = now; // timers added by the callbacks go after this
+
+  bool timer_fired = false;
+  vector<shared_ptr<TimerRule>> due;
+  for ( uint64_t t = first; t <= last and _timer_count > 0; t++ ) {
+    auto& slot = _timer_wheel.at( t % TIMER_WHEEL_SLOTS );
+    due.clear();
+    std::erase_if( slot, [&]( const shared_ptr<TimerRule>& timer ) {
+      if ( timer->deadline_ms > now and not timer->cancel_requested ) {
+        return false; // due on a later turn of the wheel
+      }
+      if ( not timer->cancel_requested ) {
+        due.push_back( timer );
+      }
+      _timer_count--;
+      return true;
+    } );
+
+    for ( const auto& timer : due ) {
+      // an earlier callback may have cancelled this timer
+      if ( not timer->cancel_requested ) {
+        timer_fired = true;
+        run_callback( *timer );
+      }
+    }
+  }
+
+  return timer_fired;
+}
+
+optional<uint64_t> EventLoop::next_timer_ms()
+{
+  optional<uint64_t> nearest;
+  const uint64_t first = _timers_fired_through_ms + 1;
+  for ( uint64_t t = first; t < first + TIMER_WHEEL_SLOTS and _timer_count > 0; t++ ) {
+    auto& slot = _timer_wheel.at( t % TIMER_WHEEL_SLOTS );
+    std::erase_if( slot, [&]( const shared_ptr<TimerRule>& timer ) {
+      if ( timer->cancel_requested ) {
+        _timer_count--;
+        return true;
+      }
+      nearest = min( nearest.value_or( UINT64_MAX ), timer->deadline_ms );
+      return false;
+    } );
+
+    // every timer in a later slot is due after t
+    if ( nearest and nearest.value() <= t ) {
+      break;
+    }
+  }
+
+  if ( not nearest ) {
+    return {};
+  }
+  const uint64_t now = now_ms();
+  return nearest.value() > now ? nearest.value() - now : 0;
+}
+
+// Whether `fd` is still ready for `direction`, without waiting
+static bool still_ready( const FileDescriptor& fd, Direction direction )
+{
+  pollfd one { fd.fd_num(), static_cast<int16_t>( direction ), 0 };
+  return CheckSystemCall( "poll", ::poll( &one, 1, 0 ) ) == 1 and ( one.revents & one.events );
+}
+
+void EventLoop::serve_fd_rule( FDRule& rule )
+{
+  if ( rule.ready_since ) {
+    auto& stats = _rule_categories.at( rule.category_id ).stats;
+    const chrono::nanoseconds latency = chrono::steady_clock::now() - rule.ready_since.value();
+    stats.waits++;
+    stats.total_latency += latency;
+    stats.max_latency = max( stats.max_latency, latency );
+    rule.ready_since.reset();
+  }
+
+  const unsigned budget = _service == Service::AllReady ? _rule_categories.at( rule.category_id ).budget : 1;
+  for ( unsigned i = 0; i < budget; i++ ) {
+    if ( i > 0 and not( rule.interest() and still_ready( rule.fd, rule.direction ) ) ) {
+      break;
+    }
+
+    // we only want to call callback if revents includes the event we asked for
+    const auto count_before = rule.service_count();
+    run_callback( rule );
+
+    if ( count_before == rule.service_count() and ( not rule.fd.closed() ) and rule.interest() ) {
+      throw runtime_error( "EventLoop: busy wait detected: rule \"" + _rule_categories.at( rule.category_id ).name
+                           + "\" did not read/write fd and is still interested" );
+    }
+    if ( rule.cancel_requested or rule.fd.closed() or ( rule.direction == Direction::In and rule.fd.eof() ) ) {
+      break;
+    }
+  }
+}
+
+void EventLoop::report_error( const FDRule& rule ) const
+{
+  /* see if fd is a socket */
+  int socket_error = 0;
+  socklen_t optlen = sizeof( socket_error );
+  const int ret = getsockopt( rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
+  if ( ret == -1 and errno == ENOTSOCK ) {
+    cerr << "error on polled file descriptor for rule \"" << _rule_categories.at( rule.category_id ).name << "\"\n";
+  } else if ( ret == -1 ) {
+    throw unix_error( "getsockopt" );
+  } else if ( optlen != sizeof( socket_error ) ) {
+    throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
+  } else if ( socket_error ) {
+    cerr << "error on polled socket for rule \"" << _rule_categories.at( rule.category_id ).name
+         << "\": " << strerror( socket_error ) << "\n";
+  }
+}
+
+EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
+{
+  // fire the due timers, and wait no longer than until the next one is due (not at all if one fired)
+  bool timer_fired = fire_timers();
+  int wait_ms = timeout_ms;
+  if ( timer_fired ) {
+    wait_ms = 0;
+  } else if ( const auto next_ms = next_timer_ms() ) {
+    const auto until_next = static_cast<int>( min<uint64_t>( next_ms.value(), INT32_MAX ) );
+    wait_ms = timeout_ms < 0 ? until_next : min( timeout_ms, until_next );
+  }
+
+  const Result result = wait_fds( wait_ms );
+  timer_fired |= fire_timers();
+  return timer_fired ? Result::Success : result;
+}
+
+EventLoop::Result EventLoop::wait_fds( const int timeout_ms )
+{
+  if ( _service == Service::OneRule ) {
+    // first, handle the non-file-descriptor-related rules
+    if ( serve_non_fd_rule() ) {
+      return Result::Success;
+    }
+
+    return _backend == Backend::Epoll ? wait_epoll( timeout_ms ) : wait_poll( timeout_ms );
+  }
+
+  // serve the non-fd rules, then any fd rules already ready (without waiting if a non-fd rule had work)
+  const bool non_fd_served = serve_non_fd_rules();
+  const Result fd_result = _backend == Backend::Epoll ? wait_epoll( non_fd_served ? 0 : timeout_ms )
+                                                      : wait_poll( non_fd_served ? 0 : timeout_ms );
+  return non_fd_served ? Result::Success : fd_result;
+}
+
+EventLoop::Result EventLoop::wait_poll( const int timeout_ms )
+{
+  // poll any "interested" file descriptors
   vector<pollfd> pollfds {};
   pollfds.reserve( _fd_rules.size() );
   bool something_to_poll = false;
@@ -152,8 +417,8 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
     ++it;
   }
 
-  // quit if there is nothing left to poll
-  if ( not something_to_poll ) {
+  // quit if there is nothing left to poll or to wait for
+  if ( not something_to_poll and _timer_count == 0 ) {
     return Result::Exit;
   }
 
@@ -162,11 +427,27 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
     return Result::Timeout;
   }
 
-  // go through the poll results
-  for ( auto [it, idx] = make_pair( _fd_rules.begin(), static_cast<size_t>( 0 ) ); it != _fd_rules.end(); ++idx ) {
+  // note when each ready rule's fd was first seen ready, for its category's latency stats
+  const auto polled_at = chrono::steady_clock::now();
+  auto rule_it = _fd_rules.begin();
+  for ( const auto& this_pollfd : pollfds ) {
+    auto& this_rule = **rule_it++;
+    if ( ( this_pollfd.revents & this_pollfd.events ) and not this_rule.ready_since ) {
+      this_rule.ready_since = polled_at;
+    }
+  }
+
+  // go through the poll results (rules added by callbacks, at the end of the list, wait for the next call)
+  for ( auto [it, idx] = make_pair( _fd_rules.begin(), static_cast<size_t>( 0 ) ); idx < pollfds.size(); ++idx ) {
     const auto& this_pollfd = pollfds.at( idx );
     auto& this_rule = **it;
 
+    if ( this_rule.cancel_requested or this_rule.fd.closed() ) {
+      // cancelled or closed by an earlier callback in this call; retired at the next call
+      ++it;
+      continue;
+    }
+
     const auto poll_error = static_cast<bool>( this_pollfd.revents & ( POLLERR | POLLNVAL ) );
     if ( poll_error ) {
       /* recoverable error? */
@@ -177,21 +458,7 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
         }
       }
 
-      /* see if fd is a socket */
-      int socket_error = 0;
-      socklen_t optlen = sizeof( socket_error );
-      const int ret = getsockopt( this_rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
-      if ( ret == -1 and errno == ENOTSOCK ) {
-        cerr << "error on polled file descriptor for rule \"" << _rule_categories.at( this_rule.category_id ).name
-             << "\"\n";
-      } else if ( ret == -1 ) {
-        throw unix_error( "getsockopt" );
-      } else if ( optlen != sizeof( socket_error ) ) {
-        throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
-      } else if ( socket_error ) {
-        cerr << "error on polled socket for rule \"" << _rule_categories.at( this_rule.category_id ).name
-             << "\": " << strerror( socket_error ) << "\n";
-      }
+      report_error( this_rule );
 
       this_rule.cancel();
       it = _fd_rules.erase( it );
@@ -210,21 +477,196 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
       continue;
     }
 
-    if ( poll_ready ) {
-      // we only want to call callback if revents includes the event we asked for
-      const auto count_before = this_rule.service_count();
-      this_rule.callback();
+    if ( _service == Service::OneRule and poll_ready ) {
+      serve_fd_rule( this_rule );
+      return Result::Success; /* only serve one rule on each iteration */
+    }
+
+    // an earlier callback in this call may have taken away this rule's interest
+    if ( poll_ready and this_rule.interest() ) {
+      serve_fd_rule( this_rule );
+    } else {
+      this_rule.ready_since.reset();
+    }
+
+    ++it; // if we got here, it means we didn't call _fd_rules.erase()
+  }
+
+  return Result::Success;
+}
+
+void EventLoop::epoll_add( FDRule& rule )
+{
+  auto& registration = _epoll_registrations[rule.fd.fd_num()];
+  // a closed fd's number may have been reused by this one before its rules were retired
+  std::erase_if( registration.rules, [&]( FDRule* r ) {
+    if ( not r->fd.closed() ) {
+      return false;
+    }
+    mark_dirty( *r ); // so that it is retired
+    return true;
+  } );
+  if ( registration.rules.empty() ) {
+    // register with no events yet; wait_epoll() sets them from the rules' interest
+    epoll_event event {};
+    event.data.fd = rule.fd.fd_num();
+    if ( ::epoll_ctl( _epoll_fd->fd_num(), EPOLL_CTL_ADD, rule.fd.fd_num(), &event ) == 0 ) {
+      registration.events = 0;
+    } else if ( errno != EEXIST ) {
+      throw unix_error( "epoll_ctl" );
+    }
+  }
+  registration.rules.push_back( &rule );
+}
+
+void EventLoop::epoll_remove( const FDRule& rule )
+{
+  const auto it = _epoll_registrations.find( rule.fd.fd_num() );
+  if ( it == _epoll_registrations.end() ) {
+    return;
+  }
+  std::erase( it->second.rules, &rule );
+  if ( it->second.rules.empty() ) {
+    // the fd may already be closed, which has removed it from the epoll set
+    ::epoll_ctl( _epoll_fd->fd_num(), EPOLL_CTL_DEL, rule.fd.fd_num(), nullptr );
+    _epoll_registrations.erase( it );
+    return;
+  }
+  // the fd's other rules decide what it stays registered for (or are retired too, if it was closed)
+  for ( FDRule* other : it->second.rules ) {
+    mark_dirty( *other );
+  }
+}
+
+void EventLoop::epoll_update( const int fd_num )
+{
+  auto& registration = _epoll_registrations.at( fd_num );
+  uint32_t events = 0;
+  for ( const FDRule* rule : registration.rules ) {
+    events |= rule->interested ? static_cast<uint32_t>( rule->direction ) : 0;
+  }
+  if ( events != registration.events ) {
+    epoll_event event {};
+    event.events = events;
+    event.data.fd = fd_num;
+    CheckSystemCall( "epoll_ctl", ::epoll_ctl( _epoll_fd->fd_num(), EPOLL_CTL_MOD, fd_num, &event ) );
+    registration.events = events;
+  }
+}
+
+void EventLoop::mark_dirty( FDRule& rule )
+{
+  if ( _backend == Backend::Epoll and not rule.dirty and not rule.retired ) {
+    rule.dirty = true;
+    _dirty_fd_rules.push_back( *rule.position );
+  }
+}
+
+EventLoop::Result EventLoop::wait_epoll( const int timeout_ms )
+{
+  // Retire finished rules and evaluate interest again, but only for the rules whose interest may have changed:
+  // those added, served or on a ready fd since the last wait, and those a RuleHandle flagged. (Indexed, because
+  // retiring a rule marks the other rules on its fd.)
+  for ( size_t i = 0; i < _dirty_fd_rules.size(); i++ ) {
+    auto& this_rule = *_dirty_fd_rules[i];
+    this_rule.dirty = false;
+
+    const bool was_interested = this_rule.interested;
+    const bool finished = this_rule.cancel_requested
+                          or ( this_rule.direction == Direction::In and this_rule.fd.eof() )
+                          or this_rule.fd.closed();
+    if ( finished ) {
+      if ( not this_rule.cancel_requested ) {
+        this_rule.cancel();
+      }
+      this_rule.interested = false;
+      this_rule.retired = true;
+      epoll_remove( this_rule );
+      _fd_rules.erase( this_rule.position );
+    } else {
+      this_rule.interested = this_rule.interest();
+      epoll_update( this_rule.fd.fd_num() );
+    }
+    if ( this_rule.interested != was_interested ) {
+      _interested_fd_rules += this_rule.interested ? 1 : -1;
+    }
+  }
+  _dirty_fd_rules.clear();
+
+  // quit if there is nothing left to poll or to wait for
+  if ( _interested_fd_rules == 0 and _timer_count == 0 ) {
+    return Result::Exit;
+  }
+
+  _epoll_events.resize( max<size_t>( _epoll_registrations.size(), 1 ) );
+  const int ready = CheckSystemCall( "epoll_wait",
+                                     ::epoll_wait( _epoll_fd->fd_num(),
+                                                   _epoll_events.data(),
+                                                   static_cast<int>( _epoll_events.size() ),
+                                                   timeout_ms ) );
+  if ( ready == 0 ) {
+    return Result::Timeout;
+  }
 
-      if ( count_before == this_rule.service_count() and ( not this_rule.fd.closed() ) and this_rule.interest() ) {
-        throw runtime_error( "EventLoop: busy wait detected: rule \""
-                             + _rule_categories.at( this_rule.category_id ).name
-                             + "\" did not read/write fd and is still interested" );
+  // note when each ready rule's fd was first seen ready, for its category's latency stats
+  const span ready_events { _epoll_events.data(), static_cast<size_t>( ready ) };
+  const auto polled_at = chrono::steady_clock::now();
+  for ( const auto& ready_event : ready_events ) {
+    const auto registration = _epoll_registrations.find( ready_event.data.fd );
+    if ( registration == _epoll_registrations.end() ) {
+      continue;
+    }
+    for ( FDRule* rule : registration->second.rules ) {
+      if ( rule->interested and ( ready_event.events & static_cast<uint32_t>( rule->direction ) )
+           and not rule->ready_since ) {
+        rule->ready_since = polled_at;
       }
+    }
+  }
 
-      return Result::Success; /* only serve one rule on each iteration */
+  // serve every ready rule (a rule cancelled here is retired at the next call)
+  for ( const auto& ready_event : ready_events ) {
+    const auto registration = _epoll_registrations.find( ready_event.data.fd );
+    if ( registration == _epoll_registrations.end() ) {
+      continue;
     }
+    const vector<FDRule*> rules = registration->second.rules; // callbacks may add rules for this fd
 
-    ++it; // if we got here, it means we didn't call _fd_rules.erase()
+    for ( FDRule* rule_ptr : rules ) {
+      auto& this_rule = *rule_ptr;
+      mark_dirty( this_rule ); // whatever happens to it here, its interest may change
+      if ( this_rule.cancel_requested or this_rule.fd.closed() ) {
+        continue;
+      }
+      const auto requested = this_rule.interested ? static_cast<uint32_t>( this_rule.direction ) : 0;
+
+      if ( ready_event.events & EPOLLERR ) {
+        /* recoverable error? */
+        if ( this_rule.recover() ) {
+          continue;
+        }
+        report_error( this_rule );
+        this_rule.cancel();
+        this_rule.cancel_requested = true;
+        continue;
+      }
+
+      const auto poll_ready = static_cast<bool>( ready_event.events & requested );
+      const auto poll_hup = static_cast<bool>( ready_event.events & EPOLLHUP );
+      if ( poll_hup && ( ( requested && !poll_ready ) or ( this_rule.direction == Direction::Out ) ) ) {
+        // as with poll(), the fd is defunct for this rule
+        this_rule.cancel();
+        this_rule.cancel_requested = true;
+        continue;
+      }
+
+      // an earlier callback in this call may have taken away this rule's interest
+      if ( poll_ready and this_rule.interest() ) {
+        serve_fd_rule( this_rule );
+      } else {
+        this_rule.ready_since.reset();
+      }
+    }
   }
 
   return Result::Success;
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <list>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <poll.h>
+#include <string>
 #include <string_view>
+#include <sys/epoll.h>
+#include <unordered_map>
+#include <vector>
 
 #include "file_descriptor.hh"
 
@@ -20,6 +27,43 @@ public:
     Out = POLLOUT //!< Callback will be triggered when Rule::fd is writable.
   };
 
+  //! How EventLoop waits for its file descriptors
+  enum class Backend
+  {
+    Poll, //!< Call [poll(2)](\ref man2::poll) on every interested fd.
+    Epoll //!< Keep the fds registered with [epoll(7)](\ref man7::epoll), and serve every ready rule per call.
+          //!< A rule's interest is evaluated again only when it may have changed (see RuleHandle), so an idle
+          //!< rule costs nothing per call.
+  };
+
+  //! How many rules each call to EventLoop::wait_next_event serves
+  enum class Service
+  {
+    OneRule, //!< Return after the first rule served: a non-fd rule (until it loses interest), or else a ready fd
+             //!< rule (but Backend::Epoll serves every ready fd rule).
+    AllReady //!< Serve every interested non-fd rule and every ready fd rule, each up to its category's budget
+             //!< of callbacks, before returning.
+  };
+
+  //! How a category of rules has been served
+  struct CategoryStats
+  {
+    uint64_t callbacks {};                     //!< Callbacks run
+    std::chrono::nanoseconds callback_time {}; //!< Time spent in those callbacks
+    uint64_t waits {};                         //!< Times an fd rule's fd polled ready before it was served
+    std::chrono::nanoseconds total_latency {}; //!< Summed over those, time from polling ready to being served
+    std::chrono::nanoseconds max_latency {};   //!< The longest of those times
+  };
+
+  //! Returned by each call to EventLoop::wait_next_event.
+  enum class Result
+  {
+    Success, //!< At least one Rule was triggered.
+    Timeout, //!< No rules were triggered before timeout.
+    Exit     //!< All rules have been canceled or were uninterested, and no timers are pending; make no further
+             //!< calls to EventLoop::wait_next_event.
+  };
+
 private:
   using CallbackT = std::function<void( void )>;
   using InterestT = std::function<bool( void )>;
@@ -27,6 +71,8 @@ private:
   struct RuleCategory
   {
     std::string name;
+    unsigned budget; //!< Callbacks per rule per call, with Service::AllReady
+    CategoryStats stats {};
   };
 
   struct BasicRule
@@ -45,6 +91,13 @@ private:
     Direction direction; //!< Direction::In for reading from fd, Direction::Out for writing to fd.
     CallbackT cancel;    //!< A callback that is called when the rule is cancelled (e.g. on hangup)
     InterestT recover;   //!< A callback that is called when the fd is ERR. Returns true to keep rule.
+    bool interested {};  //!< Result of interest() when it was last evaluated (Backend::Epoll)
+    bool dirty {};       //!< Queued to have its interest evaluated before the next wait (Backend::Epoll)
+    bool retired {};     //!< Removed from the loop (Backend::Epoll)
+    std::list<std::shared_ptr<FDRule>>::iterator position {}; //!< Where it is in EventLoop::_fd_rules
+
+    //! When fd was first seen ready without this rule being served yet
+    std::optional<std::chrono::steady_clock::time_point> ready_since {};
 
     FDRule( BasicRule&& base,
             FileDescriptor&& s_fd,
@@ -57,34 +110,119 @@ private:
     unsigned int service_count() const;
   };
 
+  struct TimerRule : public BasicRule
+  {
+    uint64_t deadline_ms; //!< When to fire, on the clock of EventLoop::now_ms()
+
+    TimerRule( BasicRule&& base, uint64_t s_deadline_ms );
+  };
+
   std::vector<RuleCategory> _rule_categories {};
   std::list<std::shared_ptr<FDRule>> _fd_rules {};
   std::list<std::shared_ptr<BasicRule>> _non_fd_rules {};
 
-public:
-  EventLoop() { _rule_categories.reserve( 64 ); }
+  //! \brief Hashed timer wheel: a timer due at time t (in ms) waits in slot t modulo the number of slots
+  //! \details Firing the due timers looks only at the slots for the times that have passed since the last look,
+  //! and finding the nearest deadline scans forward from there to the first occupied slot.
+  static constexpr size_t TIMER_WHEEL_SLOTS = 512;
+  std::vector<std::vector<std::shared_ptr<TimerRule>>> _timer_wheel;
+  uint64_t _timers_fired_through_ms; //!< Every timer due at or before this time has fired
+  size_t _timer_count {};            //!< Timers in the wheel, including cancelled ones not yet dropped
 
-  //! Returned by each call to EventLoop::wait_next_event.
-  enum class Result
+  static uint64_t now_ms();
+
+  //! Fire every timer that is due; returns true if any fired
+  bool fire_timers();
+
+  //! Milliseconds until the nearest timer is due (dropping cancelled timers on the way), if any is pending
+  std::optional<uint64_t> next_timer_ms();
+
+  //! The rules on one fd number, and the events it is registered for with epoll
+  struct EpollRegistration
   {
-    Success, //!< At least one Rule was triggered.
-    Timeout, //!< No rules were triggered before timeout.
-    Exit     //!< All rules have been canceled or were uninterested; make no further calls to
-             //!< EventLoop::wait_next_event.
+    std::vector<FDRule*> rules {};
+    uint32_t events {};
   };
 
-  size_t add_category( const std::string& name );
+  Backend _backend;
+  Service _service;
+  std::optional<FileDescriptor> _epoll_fd {};
+  std::unordered_map<int, EpollRegistration> _epoll_registrations {};
+  std::vector<epoll_event> _epoll_events {};
+  std::vector<std::shared_ptr<FDRule>> _dirty_fd_rules {}; //!< Rules whose interest may have changed
+  size_t _interested_fd_rules {};                          //!< Rules whose interest was last found true
+
+  void epoll_add( FDRule& rule );
+  void epoll_remove( const FDRule& rule );
+
+  //! Set the events an fd is registered for from its rules' interest, if they changed
+  void epoll_update( int fd_num );
+
+  //! Queue a rule to have its interest evaluated (and to be retired, if it has finished) before the next wait
+  void mark_dirty( FDRule& rule );
+
+  //! Serve at most one non-fd rule; returns true if one was served
+  bool serve_non_fd_rule();
+
+  //! Serve every interested non-fd rule, up to its budget; returns true if any was served
+  bool serve_non_fd_rules();
+
+  //! Run a rule's callback, counting it in its category's stats
+  void run_callback( BasicRule& rule );
+
+  //! Serve an fd rule whose fd polled ready: once with Service::OneRule, or else up to its category's budget
+  //! for as long as it stays interested and its fd stays ready
+  void serve_fd_rule( FDRule& rule );
+
+  //! Log why a polled fd reported an error
+  void report_error( const FDRule& rule ) const;
+
+  Result wait_fds( int timeout_ms );
+  Result wait_poll( int timeout_ms );
+  Result wait_epoll( int timeout_ms );
+
+public:
+  explicit EventLoop( Backend backend = Backend::Poll, Service service = Service::OneRule );
+
+  //! An EventLoop stays where it is, since its rule handles point to it
+  EventLoop( const EventLoop& other ) = delete;
+  EventLoop& operator=( const EventLoop& other ) = delete;
+  EventLoop( EventLoop&& other ) = delete;
+  EventLoop& operator=( EventLoop&& other ) = delete;
+  ~EventLoop() = default;
+
+  //! Add a category of rules, whose rules are each served up to `budget` callbacks per call with
+  //! Service::AllReady
+  size_t add_category( const std::string& name, unsigned budget = 1 );
+
+  //! How the rules in a category have been served
+  const CategoryStats& stats( size_t category_id ) const { return _rule_categories.at( category_id ).stats; }
+
+  //! Print each category's stats
+  void summary( std::ostream& out ) const;
 
   class RuleHandle
   {
     std::weak_ptr<BasicRule> rule_weak_ptr_;
+    EventLoop* loop_; //!< for an fd rule of a Backend::Epoll loop, which must hear when the rule changes
 
   public:
     template<class RuleType>
-    explicit RuleHandle( const std::shared_ptr<RuleType> x ) : rule_weak_ptr_( x )
+    explicit RuleHandle( const std::shared_ptr<RuleType> x, EventLoop* loop = nullptr )
+      : rule_weak_ptr_( x ), loop_( loop )
     {}
 
+    RuleHandle( const RuleHandle& other ) = default; // loop_ is only used while the rule is alive
+    RuleHandle& operator=( const RuleHandle& other ) = default;
+
     void cancel();
+
+    //! \brief Have the loop evaluate the rule's interest again before it next waits
+    //! \details Backend::Epoll evaluates an fd rule's interest when the rule is added, after its fd polls ready,
+    //! and after its callback runs. A rule whose interest can turn true at any other time (because of some other
+    //! rule's callback, or code outside the loop) must be told with this, or it may never be served; so must
+    //! one whose fd is closed outside its callbacks, or it is never retired.
+    void recheck_interest();
   };
 
   RuleHandle add_rule(
@@ -101,7 +239,12 @@ public:
     const CallbackT& callback,
     const InterestT& interest = [] { return true; } );
 
-  //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+  //! Call `callback` once, `delay_ms` from now (cancel it through the returned handle)
+  RuleHandle add_timer( size_t category_id, uint64_t delay_ms, const CallbackT& callback );
+
+  //! Fires any timers that are due, waits for fds with the backend (see Backend) for no longer than
+  //! `timeout_ms` (-1 for no limit) or until the nearest timer is due, and then executes callbacks for ready fds
+  //! (see Service) and timers.
   Result wait_next_event( int timeout_ms );
 
   // convenience function to add category and rule at the same time
@@ -39,4 +39,11 @@ public:
 
   //! Called periodically when time elapses
   void tick( const size_t unused [[maybe_unused]] ) {}
+
+  //! Called once per event-loop iteration, to hand any reads and writes the adapter has queued to the kernel
+  void flush() {}
+
+  //! \brief Whether read() has another datagram to look at without waiting on the fd
+  //! \returns `true` if the caller should call read() again before waiting
+  bool read_pending() const { return false; }
 };
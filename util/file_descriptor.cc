@@ -10,6 +10,7 @@
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <utility>
 
 using namespace std;
 
@@ -83,7 +84,9 @@ FileDescriptor FileDescriptor::duplicate() const
 void FileDescriptor::read( string& buffer )
 {
   if ( buffer.empty() ) {
-    buffer.clear();
+    if ( buffer.capacity() < kReadBufferSize ) {
+      buffer = PacketPool::local().take( kReadBufferSize );
+    }
     buffer.resize( kReadBufferSize );
   }
 
@@ -114,16 +117,27 @@ void FileDescriptor::read( vector<string>& buffers )
     return;
   }
 
-  buffers.back().clear();
-  buffers.back().resize( kReadBufferSize );
+  // the rest of the datagram goes in an MTU-sized slab from this thread's packet pool (see Buffer), so that a
+  // Buffer holding a typical packet doesn't keep a jumbo slab alive; a longer datagram spills into `overflow`
+  // and is then gathered into a jumbo slab
+  string& rest = buffers.back();
+  if ( rest.capacity() < PacketPool::MTU_SLAB ) {
+    rest = PacketPool::local().take( PacketPool::MTU_SLAB );
+  }
+  rest.clear();
+  rest.resize( PacketPool::MTU_SLAB );
+  thread_local string overflow;
+  overflow.resize( kReadBufferSize - PacketPool::MTU_SLAB );
 
   vector<iovec> iovecs;
-  iovecs.reserve( buffers.size() );
+  iovecs.reserve( buffers.size() + 1 );
   size_t total_size = 0;
   for ( const auto& x : buffers ) {
     iovecs.push_back( { const_cast<char*>( x.data() ), x.size() } ); // NOLINT(*-const-cast)
     total_size += x.size();
   }
+  iovecs.push_back( { overflow.data(), overflow.size() } );
+  total_size += overflow.size();
 
   const ssize_t bytes_read = ::readv( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) );
   if ( bytes_read < 0 ) {
@@ -148,6 +162,13 @@ void FileDescriptor::read( vector<string>& buffers )
       remaining_size = 0;
     }
   }
+
+  if ( remaining_size > 0 ) {
+    string jumbo = PacketPool::local().take( rest.size() + remaining_size );
+    jumbo.append( rest );
+    jumbo.append( overflow.data(), remaining_size );
+    PacketPool::local().give( exchange( rest, move( jumbo ) ) );
+  }
 }
 
 size_t FileDescriptor::write( string_view buffer )
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Addresses and ports (host byte order) at both ends of a TCP connection, as seen from the local side
+
+struct FourTuple
+{
+  uint32_t local_address {};
+  uint16_t local_port {};
+  uint32_t remote_address {};
+  uint16_t remote_port {};
+
+  bool operator==( const FourTuple& other ) const = default;
+};
+
+struct FourTupleHash
+{
+  size_t operator()( const FourTuple& t ) const
+  {
+    const uint64_t addresses = ( static_cast<uint64_t>( t.local_address ) << 32U ) | t.remote_address;
+    const uint64_t ports = ( static_cast<uint64_t>( t.local_port ) << 16U ) | t.remote_port;
+    return std::hash<uint64_t> {}( addresses ^ ( ports * 0x9e3779b97f4a7c15ULL ) );
+  }
+};
+
+// Like receive-side scaling with a symmetric key: both ends of a connection hash it to the same value
+struct FourTupleFlowHash
+{
+  size_t operator()( const FourTuple& t ) const
+  {
+    const uint64_t local = ( static_cast<uint64_t>( t.local_address ) << 16U ) | t.local_port;
+    const uint64_t remote = ( static_cast<uint64_t>( t.remote_address ) << 16U ) | t.remote_port;
+    return std::hash<uint64_t> {}( ( local ^ remote ) * 0x9e3779b97f4a7c15ULL + ( local + remote ) );
+  }
+};
@@ -0,0 +1,273 @@
+#include "io_uring.hh"
+
+#include "exception.hh"
+
+#include <atomic>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+static int io_uring_setup( unsigned entries, io_uring_params& params )
+{
+  return static_cast<int>( ::syscall( __NR_io_uring_setup, entries, &params ) );
+}
+
+static int io_uring_enter( int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags )
+{
+  return static_cast<int>( ::syscall( __NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0 ) );
+}
+
+static int io_uring_register( int ring_fd, unsigned opcode, const void* arg, unsigned nr_args )
+{
+  return static_cast<int>( ::syscall( __NR_io_uring_register, ring_fd, opcode, arg, nr_args ) );
+}
+
+static void* map_ring( int ring_fd, size_t size, off_t offset )
+{
+  void* const ret = ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset );
+  if ( ret == MAP_FAILED ) {
+    throw unix_error( "mmap" );
+  }
+  return ret;
+}
+
+// The ring indices are shared with the kernel, which reads and writes them concurrently
+static uint32_t load_acquire( uint32_t* index )
+{
+  return atomic_ref<uint32_t> { *index }.load( memory_order_acquire );
+}
+
+static void store_release( uint32_t* index, uint32_t value )
+{
+  atomic_ref<uint32_t> { *index }.store( value, memory_order_release );
+}
+
+bool IOUring::supported()
+{
+  static const bool ret = [] {
+    io_uring_params params {};
+    const int ring_fd = io_uring_setup( 1, params );
+    if ( ring_fd < 0 ) {
+      return false;
+    }
+    ::close( ring_fd );
+    return true;
+  }();
+  return ret;
+}
+
+// NOLINTBEGIN(*-pointer-arithmetic)
+// NOLINTBEGIN(*-reinterpret-cast)
+IOUring::Rings::Rings( int ring_fd, const io_uring_params& params )
+  : sq_ring_size( params.sq_off.array + params.sq_entries * sizeof( uint32_t ) )
+  , cq_ring_size( params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe ) )
+  , sqes_size( params.sq_entries * sizeof( io_uring_sqe ) )
+  , sq_entries( params.sq_entries )
+{
+  if ( not( params.features & IORING_FEAT_SINGLE_MMAP ) ) {
+    throw runtime_error( "io_uring: kernel does not map both rings together" );
+  }
+
+  // one mapping covers both rings
+  sq_ring_size = max( sq_ring_size, cq_ring_size );
+  sq_ring = map_ring( ring_fd, sq_ring_size, IORING_OFF_SQ_RING );
+  cq_ring = sq_ring;
+  try {
+    sqes = static_cast<io_uring_sqe*>( map_ring( ring_fd, sqes_size, IORING_OFF_SQES ) );
+  } catch ( ... ) {
+    ::munmap( sq_ring, sq_ring_size );
+    throw;
+  }
+
+  auto* const sq = static_cast<char*>( sq_ring );
+  sq_head = reinterpret_cast<uint32_t*>( sq + params.sq_off.head );
+  sq_tail = reinterpret_cast<uint32_t*>( sq + params.sq_off.tail );
+  sq_array = reinterpret_cast<uint32_t*>( sq + params.sq_off.array );
+  sq_mask = *reinterpret_cast<uint32_t*>( sq + params.sq_off.ring_mask );
+
+  auto* const cq = static_cast<char*>( cq_ring );
+  cq_head = reinterpret_cast<uint32_t*>( cq + params.cq_off.head );
+  cq_tail = reinterpret_cast<uint32_t*>( cq + params.cq_off.tail );
+  cqes = reinterpret_cast<io_uring_cqe*>( cq + params.cq_off.cqes );
+  cq_mask = *reinterpret_cast<uint32_t*>( cq + params.cq_off.ring_mask );
+}
+// NOLINTEND(*-reinterpret-cast)
+
+IOUring::Rings::~Rings()
+{
+  ::munmap( sqes, sqes_size );
+  ::munmap( sq_ring, sq_ring_size );
+}
+
+IOUring::IOUring( unsigned entries ) : IOUring( entries, make_unique<io_uring_params>() ) {}
+
+IOUring::IOUring( unsigned entries, unique_ptr<io_uring_params> params )
+  : FileDescriptor( ::CheckSystemCall( "io_uring_setup", io_uring_setup( entries, *params ) ) )
+  , rings_( make_unique<Rings>( fd_num(), *params ) )
+{}
+
+void IOUring::register_buffers( const vector<iovec>& buffers )
+{
+  CheckSystemCall( "io_uring_register",
+                   io_uring_register( fd_num(), IORING_REGISTER_BUFFERS, buffers.data(), buffers.size() ) );
+}
+
+io_uring_sqe& IOUring::next_submission()
+{
+  const uint32_t tail = *rings_->sq_tail;
+  if ( tail - load_acquire( rings_->sq_head ) >= rings_->sq_entries ) {
+    submit();
+    if ( tail - load_acquire( rings_->sq_head ) >= rings_->sq_entries ) {
+      throw runtime_error( "io_uring: kernel did not take any submissions" );
+    }
+  }
+
+  const uint32_t index = tail & rings_->sq_mask;
+  rings_->sq_array[index] = index;
+  io_uring_sqe& sqe = rings_->sqes[index];
+  sqe = {};
+  return sqe;
+}
+
+void IOUring::read_fixed( const FileDescriptor& fd, const iovec& buffer, uint16_t buffer_index, uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_submission();
+  sqe.opcode = IORING_OP_READ_FIXED;
+  sqe.fd = fd.fd_num();
+  sqe.addr = reinterpret_cast<uintptr_t>( buffer.iov_base ); // NOLINT(*-reinterpret-cast)
+  sqe.len = buffer.iov_len;
+  sqe.off = -1; // the fd's current position, or none for a socket or device
+  sqe.buf_index = buffer_index;
+  sqe.user_data = user_data;
+
+  store_release( rings_->sq_tail, *rings_->sq_tail + 1 );
+  unsubmitted_++;
+}
+
+void IOUring::writev( const FileDescriptor& fd, const vector<iovec>& buffers, uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_submission();
+  sqe.opcode = IORING_OP_WRITEV;
+  sqe.fd = fd.fd_num();
+  sqe.addr = reinterpret_cast<uintptr_t>( buffers.data() ); // NOLINT(*-reinterpret-cast)
+  sqe.len = buffers.size();
+  sqe.off = -1;
+  sqe.user_data = user_data;
+
+  store_release( rings_->sq_tail, *rings_->sq_tail + 1 );
+  unsubmitted_++;
+  register_write();
+}
+
+void IOUring::submit()
+{
+  while ( unsubmitted_ > 0 ) {
+    syscall_count_++;
+    const int submitted = io_uring_enter( fd_num(), unsubmitted_, 0, 0 );
+    if ( submitted < 0 and errno == EINTR ) {
+      continue;
+    }
+    if ( submitted < 0 and ( errno == EAGAIN or errno == EBUSY ) ) {
+      return; // the kernel is short of resources, or completions need taking first; retry at the next submit()
+    }
+    unsubmitted_ -= CheckSystemCall( "io_uring_enter", submitted );
+  }
+}
+
+void IOUring::get_events()
+{
+  syscall_count_++;
+  CheckSystemCall( "io_uring_enter", io_uring_enter( fd_num(), 0, 0, IORING_ENTER_GETEVENTS ) );
+  register_read();
+}
+
+bool IOUring::has_completion() const
+{
+  return *rings_->cq_head != load_acquire( rings_->cq_tail );
+}
+
+optional<IOUring::Completion> IOUring::next_completion()
+{
+  const uint32_t head = *rings_->cq_head;
+  if ( head == load_acquire( rings_->cq_tail ) ) {
+    return {};
+  }
+
+  const io_uring_cqe& cqe = rings_->cqes[head & rings_->cq_mask];
+  const Completion ret { cqe.user_data, cqe.res };
+  store_release( rings_->cq_head, head + 1 );
+  register_read();
+  return ret;
+}
+// NOLINTEND(*-pointer-arithmetic)
+
+IOUringDatagrams::IOUringDatagrams( FileDescriptor&& fd, uint16_t buffer_count, size_t buffer_size )
+  : fd_( move( fd ) )
+  , ring_( buffer_count * 2U )
+  , buffer_size_( buffer_size )
+  , buffers_( buffer_count, string( buffer_size, 0 ) )
+  , next_write_id_( buffer_count )
+{
+  vector<iovec> iovecs;
+  iovecs.reserve( buffers_.size() );
+  for ( auto& buffer : buffers_ ) {
+    iovecs.push_back( { buffer.data(), buffer.size() } );
+  }
+  ring_.register_buffers( iovecs );
+
+  for ( uint16_t i = 0; i < buffer_count; i++ ) {
+    arm_read( i );
+  }
+  ring_.submit();
+}
+
+void IOUringDatagrams::arm_read( uint16_t buffer_index )
+{
+  string& buffer = buffers_.at( buffer_index );
+  ring_.read_fixed( fd_, { buffer.data(), buffer_size_ }, buffer_index, buffer_index );
+}
+
+optional<string> IOUringDatagrams::read()
+{
+  if ( not ring_.has_completion() ) {
+    // the ring's fd can poll readable before deferred completions are posted
+    ring_.get_events();
+  }
+
+  while ( const auto completion = ring_.next_completion() ) {
+    if ( completion->user_data < buffers_.size() ) {
+      const auto buffer_index = static_cast<uint16_t>( completion->user_data );
+      if ( completion->result < 0 ) {
+        throw unix_error( "read", -completion->result );
+      }
+      string ret = PacketPool::local().take( completion->result );
+      ret.assign( buffers_.at( buffer_index ), 0, completion->result );
+      arm_read( buffer_index );
+      return ret;
+    }
+
+    writes_.erase( completion->user_data );
+    if ( completion->result < 0 ) {
+      throw unix_error( "writev", -completion->result );
+    }
+  }
+
+  return {};
+}
+
+void IOUringDatagrams::write( vector<Buffer>&& datagram )
+{
+  const uint64_t id = next_write_id_++;
+  auto& pending = writes_[id];
+  pending.datagram = move( datagram );
+  for ( const auto& buffer : pending.datagram ) {
+    const string_view view = buffer;
+    pending.iovecs.push_back( { const_cast<char*>( view.data() ), view.size() } ); // NOLINT(*-const-cast)
+  }
+  ring_.writev( fd_, pending.iovecs, id );
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "buffer.hh"
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/uio.h>
+#include <unordered_map>
+#include <vector>
+
+//! \brief An [io_uring(7)](\ref man7::io_uring) instance, set up and driven with raw system calls
+//! \details Submissions are queued in the shared submission ring and handed to the kernel together by submit().
+//! The ring's fd can be watched by an EventLoop: it is readable while completions are waiting, and writable
+//! while the submission ring has room. Each completion taken counts as a read of that fd, and each submission
+//! queued as a write, so EventLoop's busy-wait detection applies as for any other fd.
+class IOUring : public FileDescriptor
+{
+public:
+  //! The outcome of one submission
+  struct Completion
+  {
+    uint64_t user_data; //!< as given when the submission was queued
+    int32_t result;     //!< the system call's return value, or a negated errno
+  };
+
+  //! Whether this kernel allows io_uring (it may be compiled out, or disabled by sysctl or seccomp)
+  static bool supported();
+
+  //! Set up a ring with room for `entries` submissions
+  explicit IOUring( unsigned entries );
+
+  //! Register `buffers` for fixed-buffer reads, which the kernel then need not map on each read
+  void register_buffers( const std::vector<iovec>& buffers );
+
+  //! Queue a read into registered buffer `buffer_index`
+  void read_fixed( const FileDescriptor& fd, const iovec& buffer, uint16_t buffer_index, uint64_t user_data );
+
+  //! Queue a gathered write; `buffers` must stay valid until its completion is taken
+  void writev( const FileDescriptor& fd, const std::vector<iovec>& buffers, uint64_t user_data );
+
+  //! Hand every queued submission to the kernel with one system call
+  void submit();
+
+  //! Have the kernel post any completions it has deferred (e.g., to run on this thread) to the ring
+  void get_events();
+
+  //! Take the next completion, if there is one
+  std::optional<Completion> next_completion();
+
+  //! Whether a completion is waiting (without a system call)
+  bool has_completion() const;
+
+  //! Number of io_uring_enter system calls made
+  size_t syscall_count() const { return syscall_count_; }
+
+private:
+  //! The rings shared with the kernel
+  struct Rings
+  {
+    void* sq_ring {};
+    size_t sq_ring_size {};
+    void* cq_ring {};
+    size_t cq_ring_size {};
+    io_uring_sqe* sqes {};
+    size_t sqes_size {};
+
+    uint32_t* sq_head {};
+    uint32_t* sq_tail {};
+    uint32_t* sq_array {};
+    uint32_t sq_mask {};
+    uint32_t sq_entries {};
+
+    uint32_t* cq_head {};
+    uint32_t* cq_tail {};
+    io_uring_cqe* cqes {};
+    uint32_t cq_mask {};
+
+    Rings( int ring_fd, const io_uring_params& params );
+    ~Rings();
+
+    Rings( const Rings& other ) = delete;
+    Rings& operator=( const Rings& other ) = delete;
+    Rings( Rings&& other ) = delete;
+    Rings& operator=( Rings&& other ) = delete;
+  };
+
+  std::unique_ptr<Rings> rings_;
+  unsigned unsubmitted_ {};
+  size_t syscall_count_ {};
+
+  IOUring( unsigned entries, std::unique_ptr<io_uring_params> params );
+
+  //! Claim the next submission entry, submitting what is queued first if the ring is full
+  io_uring_sqe& next_submission();
+};
+
+//! \brief Datagram reads and writes on one fd, through an IOUring
+//! \details A read is kept outstanding on each of a set of registered buffers, so datagrams arrive without a
+//! system call per read. Writes are queued, holding their Buffers until they complete, and reach the kernel in a
+//! batch with the re-armed reads at the next flush().
+class IOUringDatagrams
+{
+  FileDescriptor fd_;
+  IOUring ring_;
+
+  size_t buffer_size_;
+  std::vector<std::string> buffers_;
+
+  //! Writes in flight, by user_data (which starts after the buffer indices)
+  struct PendingWrite
+  {
+    std::vector<Buffer> datagram {};
+    std::vector<iovec> iovecs {};
+  };
+  std::unordered_map<uint64_t, PendingWrite> writes_ {};
+  uint64_t next_write_id_;
+
+  void arm_read( uint16_t buffer_index );
+
+public:
+  //! Read from `fd` into `buffer_count` registered buffers of `buffer_size` bytes each
+  explicit IOUringDatagrams( FileDescriptor&& fd, uint16_t buffer_count = 32, size_t buffer_size = 16384 );
+
+  //! The next datagram received, if one has arrived; write completions are retired along the way
+  std::optional<std::string> read();
+
+  //! Queue a datagram to be written at the next flush()
+  void write( std::vector<Buffer>&& datagram );
+
+  //! Submit the queued writes and re-armed reads
+  void flush() { ring_.submit(); }
+
+  //! Whether read() has a completion to look at without waiting
+  bool has_completion() const { return ring_.has_completion(); }
+
+  //! The fd to watch for completions (see IOUring)
+  FileDescriptor& fd() { return ring_; }
+
+  //! Number of io_uring_enter system calls made
+  size_t syscall_count() const { return ring_.syscall_count(); }
+};
@@ -21,6 +21,7 @@ struct IPv4Datagram
 
   void serialize( Serializer& serializer ) const
   {
+    serializer.reserve( header.serialized_length() );
     header.serialize( serializer );
     for ( const auto& x : payload ) {
       serializer.buffer( x );
@@ -8,28 +8,12 @@
 
 using namespace std;
 
+static_assert( IPv4Header::serialized_length() == IPv4Header::LENGTH );
+
 // Parse from string.
 void IPv4Header::parse( Parser& parser )
 {
-  uint8_t first_byte {};
-  parser.integer( first_byte );
-  ver = first_byte >> 4;    // version
-  hlen = first_byte & 0x0f; // header length
-  parser.integer( tos );    // type of service
-  parser.integer( len );
-  parser.integer( id );
-
-  uint16_t fo_val {};
-  parser.integer( fo_val );
-  df = static_cast<bool>( fo_val & 0x4000 ); // don't fragment
-  mf = static_cast<bool>( fo_val & 0x2000 ); // more fragments
-  offset = fo_val & 0x1fff;                  // offset
-
-  parser.integer( ttl );
-  parser.integer( proto );
-  parser.integer( cksum );
-  parser.integer( src );
-  parser.integer( dst );
+  Layout::parse( parser, *this );
 
   if ( ver != 4 ) {
     parser.set_error();
@@ -61,22 +45,7 @@ void IPv4Header::serialize( Serializer& serializer ) const
     throw runtime_error( "wrong IP version" );
   }
 
-  const uint8_t first_byte = ( static_cast<uint32_t>( ver ) << 4 ) | ( hlen & 0xfU );
-  serializer.integer( first_byte ); // version and header length
-  serializer.integer( tos );
-  serializer.integer( len );
-  serializer.integer( id );
-
-  const uint16_t fo_val = ( df ? 0x4000U : 0 ) | ( mf ? 0x2000U : 0 ) | ( offset & 0x1fffU );
-  serializer.integer( fo_val );
-
-  serializer.integer( ttl );
-  serializer.integer( proto );
-
-  serializer.integer( cksum );
-
-  serializer.integer( src );
-  serializer.integer( dst );
+  Layout::serialize( serializer, *this );
 }
 
 uint16_t IPv4Header::payload_length() const
@@ -107,12 +76,12 @@ uint32_t IPv4Header::pseudo_checksum() const
 void IPv4Header::compute_checksum()
 {
   cksum = 0;
-  Serializer s;
-  serialize( s );
+  array<char, Layout::length> wire {};
+  Layout::write( *this, wire.data() );
 
   // calculate checksum -- taken over header only
   InternetChecksum check;
-  check.add( s.output() );
+  check.add( { wire.data(), wire.size() } );
   cksum = check.value();
 }
 
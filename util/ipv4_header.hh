@@ -1,6 +1,7 @@
 #pragma once
 
 #include "parser.hh"
+#include "wire_layout.hh"
 
 #include <cstddef>
 #include <cstdint>
@@ -13,7 +14,7 @@ struct IPv4Header
   static constexpr uint8_t DEFAULT_TTL = 128; // A reasonable default TTL value
   static constexpr uint8_t PROTO_TCP = 6;     // Protocol number for TCP
 
-  static constexpr uint64_t serialized_length() { return LENGTH; }
+  static constexpr uint64_t serialized_length() { return Layout::length; }
 
   /*
    *   0                   1                   2                   3
@@ -62,4 +63,23 @@ struct IPv4Header
 
   void parse( Parser& parser );
   void serialize( Serializer& serializer ) const;
+
+  // Where each field sits in the header, as drawn above
+  using Layout = wire::Layout<wire::Packed<0,
+                                           uint8_t,
+                                           wire::Bits<&IPv4Header::ver, 4, 4>,
+                                           wire::Bits<&IPv4Header::hlen, 0, 4>>,
+                              wire::Integer<1, &IPv4Header::tos>,
+                              wire::Integer<2, &IPv4Header::len>,
+                              wire::Integer<4, &IPv4Header::id>,
+                              wire::Packed<6,
+                                           uint16_t,
+                                           wire::Bits<&IPv4Header::df, 14, 1>,
+                                           wire::Bits<&IPv4Header::mf, 13, 1>,
+                                           wire::Bits<&IPv4Header::offset, 0, 13>>,
+                              wire::Integer<8, &IPv4Header::ttl>,
+                              wire::Integer<9, &IPv4Header::proto>,
+                              wire::Integer<10, &IPv4Header::cksum>,
+                              wire::Integer<12, &IPv4Header::src>,
+                              wire::Integer<16, &IPv4Header::dst>>;
 };
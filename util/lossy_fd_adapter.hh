@@ -66,4 +66,6 @@ public:
   const FdAdapterConfig& config() const { return _adapter.config(); } //!< FdAdapterBase::config passthrough
   FdAdapterConfig& config_mut() { return _adapter.config_mut(); }     //!< FdAdapterBase::config_mut passthrough
   void tick( const size_t ms_since_last_tick ) { _adapter.tick( ms_since_last_tick ); }
+  void flush() { _adapter.flush(); }                                  //!< FdAdapterBase::flush passthrough
+  bool read_pending() const { return _adapter.read_pending(); }       //!< FdAdapterBase::read_pending passthrough
 };
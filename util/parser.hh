@@ -3,6 +3,8 @@
 #include "buffer.hh"
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <concepts>
 #include <cstdint>
 #include <cstring>
@@ -16,6 +18,22 @@
 
 class Serializer;
 
+// Convert an integer between native and big-endian (network) byte order; the conversion is its own inverse
+template<std::unsigned_integral T>
+constexpr T big_endian( T val )
+{
+  if constexpr ( std::endian::native == std::endian::big or sizeof( T ) == 1 ) {
+    return val;
+  } else if constexpr ( sizeof( T ) == 2 ) {
+    return __builtin_bswap16( val );
+  } else if constexpr ( sizeof( T ) == 4 ) {
+    return __builtin_bswap32( val );
+  } else {
+    static_assert( sizeof( T ) == 8 );
+    return __builtin_bswap64( val );
+  }
+}
+
 class Parser
 {
   class BufferList
@@ -59,21 +77,20 @@ class Parser
       }
     }
 
+    // The returned Buffers share storage with the input; the first is narrowed past any bytes already consumed.
     void dump_all( std::vector<Buffer>& out )
     {
       out.clear();
       if ( empty() ) {
         return;
       }
-      std::string first_str = std::move( buffer_.front() );
-      if ( skip_ ) {
-        first_str = first_str.substr( skip_ );
-      }
-      out.emplace_back( std::move( first_str ) );
-      buffer_.pop_front();
+      buffer_.front().remove_prefix( skip_ );
       for ( auto&& x : buffer_ ) {
         out.emplace_back( std::move( x ) );
       }
+      buffer_.clear();
+      size_ = 0;
+      skip_ = 0;
     }
 
     void dump_all( Buffer& out )
@@ -81,14 +98,15 @@ class Parser
       std::vector<Buffer> concat;
       dump_all( concat );
       if ( concat.size() == 1 ) {
-        out = concat.front();
+        out = std::move( concat.front() );
         return;
       }
 
-      out.release().clear();
+      std::string joined;
       for ( const auto& s : concat ) {
-        out.release().append( s );
+        joined.append( s );
       }
+      out = std::move( joined );
     }
 
     void append( Buffer str )
@@ -125,17 +143,22 @@ public:
       return;
     }
 
-    if constexpr ( sizeof( T ) == 1 ) {
-      out = static_cast<uint8_t>( input_.peek().front() );
-      input_.remove_prefix( 1 );
+    // fast path: the whole integer is in the current buffer
+    const std::string_view front = input_.peek();
+    if ( front.size() >= sizeof( T ) ) {
+      T raw {};
+      std::memcpy( &raw, front.data(), sizeof( T ) );
+      out = big_endian( raw );
+      input_.remove_prefix( sizeof( T ) );
       return;
-    } else {
-      out = static_cast<T>( 0 );
-      for ( size_t i = 0; i < sizeof( T ); i++ ) {
-        out <<= 8;
-        out |= static_cast<uint8_t>( input_.peek().front() );
-        input_.remove_prefix( 1 );
-      }
+    }
+
+    // the integer straddles buffers
+    out = static_cast<T>( 0 );
+    for ( size_t i = 0; i < sizeof( T ); i++ ) {
+      out <<= 8;
+      out |= static_cast<uint8_t>( input_.peek().front() );
+      input_.remove_prefix( 1 );
     }
   }
 
@@ -154,6 +177,28 @@ public:
     }
   }
 
+  // Hand the next N bytes to `read` as one contiguous block: in place if they are all in the current buffer, or
+  // else gathered into a copy on the stack
+  template<size_t N, typename F>
+  void block( F&& read )
+  {
+    check_size( N );
+    if ( has_error() ) {
+      return;
+    }
+
+    const std::string_view front = input_.peek();
+    if ( front.size() >= N ) {
+      read( front.data() );
+      input_.remove_prefix( N );
+      return;
+    }
+
+    std::array<char, N> gathered {};
+    string( gathered );
+    read( gathered.data() );
+  }
+
   void all_remaining( std::vector<Buffer>& out ) { input_.dump_all( out ); }
   void all_remaining( Buffer& out ) { input_.dump_all( out ); }
 };
@@ -164,20 +209,28 @@ class Serializer
   std::string buffer_ {};
 
 public:
-  Serializer() = default;
-  explicit Serializer( std::string&& buffer ) : buffer_( std::move( buffer ) ) {}
+  Serializer() { output_.reserve( 4 ); } // a header and a few payload Buffers
+  explicit Serializer( std::string&& buffer ) : buffer_( std::move( buffer ) ) { output_.reserve( 4 ); }
 
   template<std::unsigned_integral T>
   void integer( const T& val )
   {
-    constexpr uint64_t len = sizeof( T );
+    const T raw = big_endian( val );
+    buffer_.append( reinterpret_cast<const char*>( &raw ), sizeof( T ) ); // NOLINT(*-reinterpret-cast)
+  }
 
-    for ( uint64_t i = 0; i < len; ++i ) {
-      const uint8_t byte_val = val >> ( ( len - i - 1 ) * 8 );
-      buffer_.push_back( byte_val );
-    }
+  // Append N bytes, all filled in by `write`
+  template<size_t N, typename F>
+  void block( F&& write )
+  {
+    const size_t start = buffer_.size();
+    buffer_.resize( start + N );
+    write( buffer_.data() + start );
   }
 
+  // Make room for `len` more bytes of integers and strings before the next buffer()
+  void reserve( size_t len ) { buffer_.reserve( buffer_.size() + len ); }
+
   void buffer( const Buffer& buf )
   {
     flush();
@@ -193,22 +246,29 @@ public:
 
   void flush()
   {
-    output_.emplace_back( std::move( buffer_ ) );
-    buffer_.clear();
+    if ( not buffer_.empty() ) {
+      output_.emplace_back( std::move( buffer_ ) );
+      buffer_.clear();
+    }
   }
 
+  // Take the serialized Buffers, leaving the Serializer empty
   std::vector<Buffer> output()
   {
     flush();
-    return output_;
+    return std::move( output_ );
   }
 };
 
-// Helper to serialize any object (without constructing a Serializer of the caller's own)
+// Helper to serialize any object (without constructing a Serializer of the caller's own), reserving room for the
+// object's serialized_length() if it has one
 template<class T>
 std::vector<Buffer> serialize( const T& obj )
 {
   Serializer s;
+  if constexpr ( requires { obj.serialized_length(); } ) {
+    s.reserve( obj.serialized_length() );
+  }
   obj.serialize( s );
   return s.output();
 }
@@ -2,12 +2,14 @@
 
 #include "exception.hh"
 
+#include <cerrno>
 #include <cstddef>
 #include <linux/if_packet.h>
 #include <net/if.h>
 #include <stdexcept>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include <utility>
 
 using namespace std;
 
@@ -151,6 +153,93 @@ void DatagramSocket::send( const string_view payload )
   register_write();
 }
 
+size_t DatagramSocket::recv_batch( vector<Received>& datagrams, const size_t max_datagrams, const size_t max_size )
+{
+  if ( max_datagrams == 0 ) {
+    return 0;
+  }
+
+  if ( batch_slabs_.size() < max_datagrams ) {
+    batch_slabs_.resize( max_datagrams );
+  }
+  vector<Address::Raw> sources( max_datagrams );
+  vector<iovec> iovecs( max_datagrams );
+  vector<mmsghdr> headers( max_datagrams );
+  for ( size_t i = 0; i < max_datagrams; i++ ) {
+    string& slab = batch_slabs_[i];
+    if ( slab.capacity() < max_size ) { // handed out by the last call (or new, or too small)
+      if ( slab.capacity() > 0 ) {
+        PacketPool::local().give( move( slab ) ); // too small for this call's `max_size`
+      }
+      slab = PacketPool::local().take( max_size );
+    }
+    slab.resize( max_size );
+    iovecs[i] = { slab.data(), slab.size() };
+    headers[i].msg_hdr.msg_name = static_cast<sockaddr*>( sources[i] );
+    headers[i].msg_hdr.msg_namelen = sizeof( sources[i].storage );
+    headers[i].msg_hdr.msg_iov = &iovecs[i];
+    headers[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  const int result
+    = ::recvmmsg( fd_num(), headers.data(), static_cast<unsigned int>( max_datagrams ), MSG_WAITFORONE, nullptr );
+  const bool would_block = result < 0 and ( errno == EAGAIN or errno == EWOULDBLOCK );
+  const size_t received = would_block ? 0 : CheckSystemCall( "recvmmsg", result );
+  if ( not would_block ) {
+    register_read();
+  }
+
+  size_t appended = 0;
+  for ( size_t i = 0; i < received; i++ ) {
+    if ( headers[i].msg_hdr.msg_flags & MSG_TRUNC ) {
+      truncated_count_++; // its slab, holding only part of it, is kept for the next call
+      continue;
+    }
+    string& slab = batch_slabs_[i];
+    slab.resize( headers[i].msg_len );
+    datagrams.push_back( { { sources[i], headers[i].msg_hdr.msg_namelen }, exchange( slab, {} ) } );
+    appended++;
+  }
+  return appended;
+}
+
+size_t DatagramSocket::send_batch( const Address* destination, const vector<vector<Buffer>>& datagrams )
+{
+  if ( datagrams.empty() ) {
+    return 0;
+  }
+
+  size_t pieces = 0;
+  for ( const auto& datagram : datagrams ) {
+    pieces += datagram.size();
+  }
+
+  vector<iovec> iovecs;
+  iovecs.reserve( pieces );
+  vector<mmsghdr> headers( datagrams.size() );
+  for ( size_t i = 0; i < datagrams.size(); i++ ) {
+    headers[i].msg_hdr.msg_iov = iovecs.data() + iovecs.size();
+    headers[i].msg_hdr.msg_iovlen = datagrams[i].size();
+    for ( const auto& piece : datagrams[i] ) {
+      const string_view view = piece;
+      iovecs.push_back( { const_cast<char*>( view.data() ), view.size() } ); // NOLINT(*-const-cast)
+    }
+    if ( destination ) {
+      // NOLINTNEXTLINE(*-const-cast)
+      headers[i].msg_hdr.msg_name = const_cast<sockaddr*>( static_cast<const sockaddr*>( *destination ) );
+      headers[i].msg_hdr.msg_namelen = destination->size();
+    }
+  }
+
+  const int sent = ::sendmmsg( fd_num(), headers.data(), static_cast<unsigned int>( headers.size() ), 0 );
+  if ( sent < 0 and ( errno == EAGAIN or errno == EWOULDBLOCK ) ) {
+    return 0;
+  }
+  CheckSystemCall( "sendmmsg", sent );
+  register_write();
+  return sent;
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen( const int backlog )
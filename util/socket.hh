@@ -5,7 +5,10 @@
 
 #include <cstdint>
 #include <functional>
+#include <string>
+#include <string_view>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -62,7 +65,22 @@ class DatagramSocket : public Socket
 {
   using Socket::Socket;
 
+  size_t truncated_count_ {}; //!< datagrams recv_batch() dropped for not fitting in `max_size`
+
+  //! Slabs recv_batch() receives into, kept across calls: only those a call hands out are taken afresh
+  std::vector<std::string> batch_slabs_ {};
+
+  //! Send datagrams with [sendmmsg(2)](\ref man2::sendmmsg), to `destination` if given
+  size_t send_batch( const Address* destination, const std::vector<std::vector<Buffer>>& datagrams );
+
 public:
+  //! A datagram received by recv_batch(), and the Address of its sender
+  struct Received
+  {
+    Address source;
+    std::string payload;
+  };
+
   //! Receive a datagram and the Address of its sender
   void recv( Address& source_address, std::string& payload );
 
@@ -71,6 +89,30 @@ public:
 
   //! Send datagram to the socket's connected address (must call connect() first)
   void send( std::string_view payload );
+
+  //! \brief Receive up to `max_datagrams` datagrams, of up to `max_size` bytes each, with one
+  //! [recvmmsg(2)](\ref man2::recvmmsg) call, appending them to `datagrams`
+  //! \details Waits for the first datagram (unless the socket is non-blocking), then takes whichever others have
+  //! already arrived. Each payload is a slab from this thread's PacketPool; the socket keeps the slabs a call does
+  //! not fill for the next call. A datagram longer than `max_size` is dropped and counted in truncated_count().
+  //! \returns the number of datagrams appended (0 if a non-blocking socket had none)
+  size_t recv_batch( std::vector<Received>& datagrams, size_t max_datagrams, size_t max_size = kReadBufferSize );
+
+  //! Number of oversized datagrams recv_batch() has dropped
+  size_t truncated_count() const { return truncated_count_; }
+
+  //! \brief Send datagrams (each given as its pieces) to the specified Address with one system call
+  //! \returns the number of datagrams sent, which is fewer than all if a non-blocking socket's buffer filled
+  size_t sendto_batch( const Address& destination, const std::vector<std::vector<Buffer>>& datagrams )
+  {
+    return send_batch( &destination, datagrams );
+  }
+
+  //! Send datagrams to the socket's connected address with one system call (see sendto_batch())
+  size_t send_batch( const std::vector<std::vector<Buffer>>& datagrams )
+  {
+    return send_batch( nullptr, datagrams );
+  }
 };
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
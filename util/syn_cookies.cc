@@ -0,0 +1,117 @@
+#include "syn_cookies.hh"
+#include "tcp_config.hh"
+
+#include <algorithm>
+#include <bit>
+#include <random>
+
+using namespace std;
+
+class Wrap32Raw : public Wrap32
+{
+public:
+  uint32_t raw_value() const { return raw_value_; }
+};
+
+static uint32_t raw( Wrap32 seqno )
+{
+  return Wrap32Raw { seqno }.raw_value();
+}
+
+// SipHash-2-4 (Aumasson and Bernstein) of a message of three 64-bit words
+static uint64_t siphash24( const array<uint64_t, 2>& key, const array<uint64_t, 3>& message )
+{
+  array<uint64_t, 4> v { key[0] ^ 0x736f6d6570736575ULL,
+                         key[1] ^ 0x646f72616e646f6dULL,
+                         key[0] ^ 0x6c7967656e657261ULL,
+                         key[1] ^ 0x7465646279746573ULL };
+  const auto round = [&v] {
+    v[0] += v[1];
+    v[1] = rotl( v[1], 13 ) ^ v[0];
+    v[0] = rotl( v[0], 32 );
+    v[2] += v[3];
+    v[3] = rotl( v[3], 16 ) ^ v[2];
+    v[0] += v[3];
+    v[3] = rotl( v[3], 21 ) ^ v[0];
+    v[2] += v[1];
+    v[1] = rotl( v[1], 17 ) ^ v[2];
+    v[2] = rotl( v[2], 32 );
+  };
+  const auto compress = [&]( uint64_t m ) {
+    v[3] ^= m;
+    round();
+    round();
+    v[0] ^= m;
+  };
+
+  for ( const uint64_t m : message ) {
+    compress( m );
+  }
+  compress( static_cast<uint64_t>( message.size() * sizeof( uint64_t ) ) << 56U );
+
+  v[2] ^= 0xff;
+  for ( int i = 0; i < 4; i++ ) {
+    round();
+  }
+  return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+static constexpr unsigned COUNTER_SHIFT = 27;
+static constexpr unsigned MSS_SHIFT = 25;
+static constexpr uint32_t HASH_MASK = ( 1U << MSS_SHIFT ) - 1;
+
+SYNCookies::SYNCookies() : key_()
+{
+  random_device rd;
+  for ( auto& word : key_ ) {
+    word = ( static_cast<uint64_t>( rd() ) << 32U ) | rd();
+  }
+}
+
+uint32_t SYNCookies::hash( const FourTuple& addresses,
+                           Wrap32 client_isn,
+                           uint64_t counter,
+                           uint8_t mss_index ) const
+{
+  const uint64_t ips = ( static_cast<uint64_t>( addresses.local_address ) << 32U ) | addresses.remote_address;
+  const uint64_t ports_and_isn = ( static_cast<uint64_t>( addresses.local_port ) << 48U )
+                                 | ( static_cast<uint64_t>( addresses.remote_port ) << 32U ) | raw( client_isn );
+  return static_cast<uint32_t>( siphash24( key_, { ips, ports_and_isn, ( counter << 8U ) | mss_index } ) )
+         & HASH_MASK;
+}
+
+Wrap32 SYNCookies::make( const FourTuple& addresses,
+                         Wrap32 client_isn,
+                         optional<uint16_t> client_mss,
+                         uint64_t now_ms ) const
+{
+  // without an MSS option, assume what TCPPeer assumes
+  const uint16_t mss = client_mss.value_or( TCPConfig::MAX_PAYLOAD_SIZE );
+  const auto fits = [&]( uint16_t entry ) { return entry <= mss; };
+  const auto mss_index = static_cast<uint8_t>( count_if( MSS_TABLE.begin() + 1, MSS_TABLE.end(), fits ) );
+
+  const uint64_t counter = now_ms / PERIOD_MS;
+  return Wrap32 { static_cast<uint32_t>( ( counter % 32 ) << COUNTER_SHIFT )
+                  | static_cast<uint32_t>( mss_index << MSS_SHIFT )
+                  | hash( addresses, client_isn, counter, mss_index ) };
+}
+
+optional<uint16_t> SYNCookies::check( const FourTuple& addresses,
+                                      Wrap32 client_isn,
+                                      Wrap32 cookie,
+                                      uint64_t now_ms ) const
+{
+  const uint32_t value = raw( cookie );
+  const uint64_t now_counter = now_ms / PERIOD_MS;
+  const auto mss_index = static_cast<uint8_t>( ( value >> MSS_SHIFT ) & 3U );
+
+  // accept cookies made in this period or the one before
+  for ( uint64_t age = 0; age < 2 and age <= now_counter; age++ ) {
+    const uint64_t counter = now_counter - age;
+    if ( ( value >> COUNTER_SHIFT ) == counter % 32
+         and ( value & HASH_MASK ) == hash( addresses, client_isn, counter, mss_index ) ) {
+      return MSS_TABLE.at( mss_index );
+    }
+  }
+  return {};
+}
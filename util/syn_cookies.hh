@@ -0,0 +1,35 @@
+#pragma once
+
+#include "four_tuple.hh"
+#include "wrapping_integers.hh"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+//! \brief Stateless SYN cookies: an ISN that encodes everything needed to rebuild a connection from its first ACK
+//! \details The cookie's top 5 bits hold a coarse clock (one tick per PERIOD_MS), the next 2 bits the index of
+//! the client's MSS in MSS_TABLE, and the low 25 bits a keyed hash (SipHash-2-4) of the connection's addresses,
+//! the client's ISN, the clock and the MSS index. A listener that answers a SYN with a cookie ISN keeps no state;
+//! the ACK that completes the handshake acknowledges cookie + 1, and check() recovers the MSS from it.
+class SYNCookies
+{
+  std::array<uint64_t, 2> key_;
+
+  uint32_t hash( const FourTuple& addresses, Wrap32 client_isn, uint64_t counter, uint8_t mss_index ) const;
+
+public:
+  static constexpr uint64_t PERIOD_MS = 64000; //!< A cookie is good for one to two periods
+  static constexpr std::array<uint16_t, 4> MSS_TABLE { 536, 1000, 1300, 1460 };
+
+  //! Generate a random key
+  SYNCookies();
+
+  //! The ISN to answer a SYN with (the client's MSS is rounded down to an entry of MSS_TABLE)
+  Wrap32 make( const FourTuple& addresses, Wrap32 client_isn, std::optional<uint16_t> client_mss, uint64_t now_ms )
+    const;
+
+  //! If `cookie` is a current cookie for the connection, the client's MSS that it encodes
+  std::optional<uint16_t> check( const FourTuple& addresses, Wrap32 client_isn, Wrap32 cookie, uint64_t now_ms )
+    const;
+};
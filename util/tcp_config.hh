@@ -3,6 +3,7 @@
 #include "address.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <optional>
@@ -11,15 +12,39 @@
 class TCPConfig
 {
 public:
-  static constexpr size_t DEFAULT_CAPACITY = 64000; //!< Default capacity
-  static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
-  static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
-  static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
+  static constexpr size_t DEFAULT_CAPACITY = 64000;  //!< Default capacity
+  static constexpr size_t MAX_PAYLOAD_SIZE = 1000;   //!< Conservative max payload size for real Internet
+  static constexpr uint16_t TIMEOUT_DFLT = 1000;     //!< Default re-transmit timeout is 1 second
+  static constexpr unsigned MAX_RETX_ATTEMPTS = 8;   //!< Maximum re-transmit attempts before giving up
+  static constexpr unsigned DUP_ACK_THRESHOLD = 3;   //!< Duplicate ACKs that trigger a fast retransmit
+  static constexpr size_t MAX_SACK_BLOCKS = 4;       //!< Most SACK blocks that fit in the TCP options space
+  static constexpr uint8_t MAX_WINDOW_SHIFT = 14;    //!< Largest window scale allowed by RFC 7323
+  static constexpr size_t PACING_BURST_SEGMENTS = 2; //!< Segments a pacing sender may save up to send at once
 
   uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
   size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
+  size_t recv_capacity_max = 0;            //!< Autotune the receive capacity up to this many bytes (0 = fixed)
   size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
   std::optional<Wrap32> fixed_isn {};
+  bool sack = false;               //!< Offer selective acknowledgments (RFC 2018) in the SYN
+  bool window_scale = false;       //!< Offer window scaling (RFC 7323) in the SYN
+  bool timestamps = false;         //!< Offer timestamps (RFC 7323) for per-ACK RTT samples and PAWS
+  uint16_t ack_delay_ms = 0;       //!< Delayed ACK timeout (RFC 1122), or 0 to acknowledge every segment at once
+  uint16_t mss = MAX_PAYLOAD_SIZE; //!< Largest payload the local link carries, offered in the SYN
+  bool mtu_probing = false;        //!< Start at MAX_PAYLOAD_SIZE and probe up to the negotiated MSS (RFC 4821)
+  bool nagle = false;              //!< Coalesce small writes while data is unacknowledged (RFC 896)
+  bool pacing = false;             //!< Spread each window of segments over the round-trip time
+
+  //! Smallest window shift that lets the receive window advertise all of the largest receive capacity
+  uint8_t window_shift() const
+  {
+    const size_t capacity = std::max( recv_capacity, recv_capacity_max );
+    uint8_t shift = 0;
+    while ( shift < MAX_WINDOW_SHIFT and ( capacity >> shift ) > UINT16_MAX ) {
+      shift++;
+    }
+    return shift;
+  }
 };
 
 //! Config for classes derived from FdAdapter
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -18,8 +19,6 @@
 
 using namespace std;
 
-static constexpr size_t TCP_TICK_MS = 10;
-
 static inline uint64_t timestamp_ms()
 {
   static_assert( std::is_same<std::chrono::steady_clock::duration, std::chrono::nanoseconds>::value );
@@ -27,28 +26,64 @@ static inline uint64_t timestamp_ms()
   return std::chrono::steady_clock::now().time_since_epoch().count() / 1000000;
 }
 
+template<typename AdaptT>
+void TCPMinnowSocket<AdaptT>::_tick()
+{
+  const auto now = timestamp_ms();
+  if ( _tcp.has_value() and _tcp.value().active() and now > _last_tick_ms ) {
+    _tcp.value().tick( now - _last_tick_ms );
+    collect_segments();
+    _datagram_adapter.tick( now - _last_tick_ms );
+  }
+  _last_tick_ms = now;
+}
+
+template<typename AdaptT>
+void TCPMinnowSocket<AdaptT>::_arm_timer()
+{
+  optional<uint64_t> due_ms;
+  if ( _tcp.value().active() ) {
+    if ( const auto deadline = _tcp.value().next_deadline() ) {
+      due_ms = _last_tick_ms + deadline.value();
+    }
+  }
+  if ( due_ms == _timer_due_ms ) {
+    return;
+  }
+
+  if ( _timer.has_value() ) {
+    _timer->cancel();
+    _timer.reset();
+  }
+  _timer_due_ms = due_ms;
+  if ( due_ms.has_value() ) {
+    const auto now = timestamp_ms();
+    _timer = _eventloop.add_timer( _timer_category, due_ms.value() - min( now, due_ms.value() ), [&] {
+      _timer.reset();
+      _timer_due_ms.reset();
+      _tick();
+    } );
+  }
+}
+
 //! \param[in] condition is a function returning true if loop should continue
 template<typename AdaptT>
 void TCPMinnowSocket<AdaptT>::_tcp_loop( const function<bool()>& condition )
 {
-  auto base_time = timestamp_ms();
+  if ( not _tcp.has_value() ) {
+    throw runtime_error( "_tcp_loop entered before TCPPeer initialized" );
+  }
+
+  // the rules tick the TCPPeer when they run, so with nothing to do and no deadline armed, the thread sleeps
   while ( condition() ) {
-    auto ret = _eventloop.wait_next_event( TCP_TICK_MS );
+    _arm_timer();
+    auto ret = _eventloop.wait_next_event( -1 );
     if ( ret == EventLoop::Result::Exit or _abort ) {
       break;
     }
 
-    if ( not _tcp.has_value() ) {
-      throw runtime_error( "_tcp_loop entered before TCPPeer initialized" );
-    }
-
-    if ( _tcp.value().active() ) {
-      const auto next_time = timestamp_ms();
-      _tcp.value().tick( next_time - base_time );
-      collect_segments();
-      _datagram_adapter.tick( next_time - base_time );
-      base_time = next_time;
-    }
+    // hand the adapter's queued reads and writes (if it queues them) to the kernel together
+    _datagram_adapter.flush();
   }
 }
 
@@ -60,6 +95,7 @@ TCPMinnowSocket<AdaptT>::TCPMinnowSocket( pair<FileDescriptor, FileDescriptor> d
   : LocalStreamSocket( move( data_socket_pair.first ) )
   , _thread_data( move( data_socket_pair.second ) )
   , _datagram_adapter( move( datagram_interface ) )
+  , _abort_wakeup( CheckSystemCall( "eventfd", ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) )
 {
   _thread_data.set_blocking( false );
   set_blocking( false );
@@ -69,6 +105,7 @@ template<typename AdaptT>
 void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
+  _last_tick_ms = timestamp_ms();
 
   // Set up the event loop
 
@@ -94,10 +131,13 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     _datagram_adapter.fd(),
     Direction::In,
     [&] {
-      if ( auto seg = _datagram_adapter.read() ) {
-        _tcp->receive( move( seg.value() ) );
-        collect_segments();
-      }
+      _tick();
+      do {
+        if ( auto seg = _datagram_adapter.read() ) {
+          _tcp->receive( move( seg.value() ) );
+          collect_segments();
+        }
+      } while ( _datagram_adapter.read_pending() );
 
       // debugging output:
       if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
@@ -114,6 +154,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     _thread_data,
     Direction::In,
     [&] {
+      _tick();
       string data;
       data.resize( _tcp->outbound_writer().available_capacity() );
       _thread_data.read( data );
@@ -147,6 +188,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     _thread_data,
     Direction::Out,
     [&] {
+      _tick();
       Reader& inbound = _tcp->inbound_reader();
       // Write from the inbound_stream into
       // the pipe, handling the possibility of a partial
@@ -155,6 +197,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
         const std::string_view buffer = inbound.peek();
         const auto bytes_written = _thread_data.write( buffer );
         inbound.pop( bytes_written );
+        collect_segments(); // may open the receive window
       }
 
       if ( inbound.is_finished() or inbound.has_error() ) {
@@ -184,6 +227,18 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       }
     },
     [&] { return not outgoing_segments_.empty(); } );
+
+  // the TCPPeer's deadlines (see _arm_timer), and the owner's request to abort
+  _timer_category = _eventloop.add_category( "TCP timers" );
+  _eventloop.add_rule(
+    "abort",
+    _abort_wakeup,
+    Direction::In,
+    [&] {
+      string counter( sizeof( uint64_t ), 0 );
+      _abort_wakeup.read( counter );
+    },
+    [&] { return _tcp->active(); } );
 }
 
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
@@ -210,6 +265,8 @@ TCPMinnowSocket<AdaptT>::~TCPMinnowSocket()
       cerr << "Warning: unclean shutdown of TCPMinnowSocket\n";
       // force the other side to exit
       _abort.store( true );
+      const uint64_t one = 1;
+      CheckSystemCall( "write", ::write( _abort_wakeup.fd_num(), &one, sizeof( one ) ) );
       _tcp_thread.join();
     }
   } catch ( const exception& e ) {
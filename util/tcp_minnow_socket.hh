@@ -37,8 +37,23 @@ private:
   //! Segments queued to be sent on the network
   std::queue<TCPSegment> outgoing_segments_ {};
 
-  //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
-  EventLoop _eventloop {};
+  //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes),
+  //! serving every ready one per iteration so that a busy inbound stream cannot starve the others
+  EventLoop _eventloop { EventLoop::Backend::Poll, EventLoop::Service::AllReady };
+
+  //! When the TCPPeer and the adapter were last ticked
+  uint64_t _last_tick_ms {};
+
+  //! The timer armed for the TCPPeer's nearest deadline, and when it is due
+  size_t _timer_category {};
+  std::optional<EventLoop::RuleHandle> _timer {};
+  std::optional<uint64_t> _timer_due_ms {};
+
+  //! Tick the TCPPeer and the adapter up to the present
+  void _tick();
+
+  //! Keep one timer armed for the TCPPeer's nearest deadline (retransmission, pacing or delayed ACK), if any
+  void _arm_timer();
 
   //! Process events while specified condition is true
   void _tcp_loop( const std::function<bool()>& condition );
@@ -54,6 +69,8 @@ private:
 
   std::atomic_bool _abort { false }; //!< Flag used by the owner to force the TCPPeer thread to shut down
 
+  FileDescriptor _abort_wakeup; //!< eventfd that interrupts the TCPPeer thread's wait when _abort is set
+
   bool _inbound_shutdown { false }; //!< Has TCPMinnowSocket shut down the incoming data to the owner?
 
   bool _outbound_shutdown { false }; //!< Has the owner shut down the outbound data to the TCP connection?
@@ -0,0 +1,393 @@
+#include "tcp_multiplexer.hh"
+
+#include "exception.hh"
+#include "ipv4_datagram.hh"
+#include "parser.hh"
+#include "tcp_over_ip.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <type_traits>
+
+using namespace std;
+
+static inline uint64_t timestamp_ms()
+{
+  static_assert( std::is_same<std::chrono::steady_clock::duration, std::chrono::nanoseconds>::value );
+
+  return std::chrono::steady_clock::now().time_since_epoch().count() / 1000000;
+}
+
+//! \param[in] datagrams carries one IPv4 datagram per read and write (e.g., a TunFD)
+//! \param[in] cfg is the configuration given to each connection's TCPPeer
+TCPMultiplexer::TCPMultiplexer( FileDescriptor&& datagrams, const TCPConfig& cfg )
+  : datagrams_( move( datagrams ) )
+  , cfg_( cfg )
+  , push_category_( eventloop_.add_category( "push bytes to TCPPeer" ) )
+  , read_category_( eventloop_.add_category( "read bytes from inbound stream" ) )
+  , timer_category_( eventloop_.add_category( "TCP timers" ) )
+{
+  eventloop_.add_rule(
+    eventloop_.add_category( "receive TCP segment from the network", DATAGRAM_BUDGET ),
+    datagrams_,
+    Direction::In,
+    [&] { receive_datagram(); } );
+
+  // One datagram per callback, and none once the fd stops being writable, so a full device queue never blocks
+  send_rule_ = eventloop_.add_rule(
+    eventloop_.add_category( "send TCP segment", DATAGRAM_BUDGET ),
+    datagrams_,
+    Direction::Out,
+    [&] {
+      datagrams_.write( outgoing_datagrams_.front() );
+      outgoing_datagrams_.pop();
+    },
+    [&] { return not outgoing_datagrams_.empty(); } );
+}
+
+TCPMultiplexer::Listener* TCPMultiplexer::listener_for( uint32_t address, uint16_t port )
+{
+  const auto it = ranges::find_if( listeners_, [&]( const Listener& listener ) {
+    return listener.port == port and ( listener.address == 0 or listener.address == address );
+  } );
+  return it == listeners_.end() ? nullptr : &*it;
+}
+
+void TCPMultiplexer::listen( const Address& local, size_t backlog, bool syn_cookies )
+{
+  listeners_.push_back( { local.ipv4_numeric(), local.port(), backlog, syn_cookies } );
+}
+
+LocalStreamSocket TCPMultiplexer::connect( const Address& local, const Address& remote )
+{
+  const FourTuple addresses { local.ipv4_numeric(), local.port(), remote.ipv4_numeric(), remote.port() };
+  if ( connections_.contains( addresses ) ) {
+    throw runtime_error( "TCPMultiplexer::connect(): connection already exists" );
+  }
+
+  LocalStreamSocket app_end = add_connection( addresses, cfg_ );
+  Connection& connection = *connections_.at( addresses );
+  touch( connection );
+  connection.peer.push(); // sends the SYN
+  collect_segments( connection );
+  return app_end;
+}
+
+optional<pair<LocalStreamSocket, Address>> TCPMultiplexer::accept()
+{
+  if ( accept_queue_.empty() ) {
+    return {};
+  }
+  auto ret = move( accept_queue_.front() );
+  accept_queue_.pop();
+  return ret;
+}
+
+LocalStreamSocket TCPMultiplexer::add_connection( const FourTuple& addresses, const TCPConfig& cfg )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_STREAM, 0, fds.data() ) );
+  LocalStreamSocket app_end { FileDescriptor { fds[0] } };
+  LocalStreamSocket our_end { FileDescriptor { fds[1] } };
+  our_end.set_blocking( false );
+
+  auto& connection = connections_[addresses];
+  connection = make_unique<Connection>( addresses, TCPPeer { cfg }, move( our_end ) );
+  Connection* const c = connection.get();
+  c->last_tick_ms = timestamp_ms();
+
+  // Outbound bytes written by the application (like TCPMinnowSocket's rule 2)
+  c->rules.push_back( eventloop_.add_rule(
+    push_category_,
+    c->app_data,
+    Direction::In,
+    [this, c] {
+      touch( *c );
+      string data;
+      data.resize( c->peer.outbound_writer().available_capacity() );
+      c->app_data.read( data );
+      c->peer.outbound_writer().push( move( data ) );
+
+      if ( c->app_data.eof() ) {
+        c->peer.outbound_writer().close();
+        c->outbound_shutdown = true;
+      }
+
+      c->peer.push();
+      collect_segments( *c );
+    },
+    [c] {
+      return c->peer.active() and not c->outbound_shutdown and c->peer.outbound_writer().available_capacity() > 0;
+    },
+    [this, c] {
+      touch( *c );
+      c->peer.outbound_writer().close();
+      c->outbound_shutdown = true;
+    } ) );
+
+  // Inbound bytes for the application (like TCPMinnowSocket's rule 3)
+  c->rules.push_back( eventloop_.add_rule(
+    read_category_,
+    c->app_data,
+    Direction::Out,
+    [this, c] {
+      touch( *c );
+      Reader& inbound = c->peer.inbound_reader();
+      if ( inbound.bytes_buffered() ) {
+        inbound.pop( c->app_data.write( inbound.peek() ) );
+        collect_segments( *c ); // may open the receive window
+      }
+
+      if ( inbound.is_finished() or inbound.has_error() ) {
+        c->app_data.shutdown( SHUT_WR );
+        c->inbound_shutdown = true;
+      }
+    },
+    [c] {
+      const Reader& inbound = c->peer.inbound_reader();
+      return inbound.bytes_buffered()
+             or ( ( inbound.is_finished() or inbound.has_error() ) and not c->inbound_shutdown );
+    },
+    [this, c] {
+      c->inbound_shutdown = true; // the application hung up
+      touch( *c );
+    } ) );
+
+  return app_end;
+}
+
+void TCPMultiplexer::receive_datagram()
+{
+  vector<string> strs( 2 );
+  strs.front().resize( IPv4Header::LENGTH );
+  datagrams_.read( strs );
+
+  InternetDatagram ip_dgram;
+  if ( not parse( ip_dgram, { move( strs.at( 0 ) ), move( strs.at( 1 ) ) } )
+       or ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
+    return;
+  }
+
+  const TCPSegmentView view { ip_dgram.payload, ip_dgram.header.pseudo_checksum() };
+  TCPSegment seg;
+  if ( not view.decode( seg ) ) {
+    return;
+  }
+
+  const FourTuple addresses { ip_dgram.header.dst, view.dst_port(), ip_dgram.header.src, view.src_port() };
+  const auto it = connections_.find( addresses );
+  Connection* const connection = it == connections_.end() ? open_passive( addresses, seg ) : it->second.get();
+  if ( connection == nullptr ) {
+    return;
+  }
+
+  touch( *connection );
+  connection->peer.receive( move( seg ) );
+  collect_segments( *connection );
+  maybe_accept( *connection );
+}
+
+TCPMultiplexer::Connection* TCPMultiplexer::open_passive( const FourTuple& addresses, const TCPSegment& seg )
+{
+  Listener* const listener = listener_for( addresses.local_address, addresses.local_port );
+  if ( listener == nullptr or seg.reset ) {
+    return nullptr;
+  }
+  const auto listener_index = static_cast<size_t>( listener - listeners_.data() );
+
+  if ( seg.sender_message.SYN ) {
+    if ( seg.receiver_message.ackno.has_value() ) {
+      return nullptr;
+    }
+    if ( listener->half_open < listener->backlog ) {
+      return &add_passive_connection( addresses, cfg_, listener_index );
+    }
+    if ( listener->syn_cookies ) {
+      send_syn_cookie( addresses, seg );
+    }
+    return nullptr;
+  }
+
+  // Is this the ACK that completes a handshake we answered with a SYN cookie?
+  if ( not listener->syn_cookies or not seg.receiver_message.ackno.has_value() ) {
+    return nullptr;
+  }
+  const Wrap32 client_isn = seg.sender_message.seqno + UINT32_MAX;
+  const Wrap32 isn = seg.receiver_message.ackno.value() + UINT32_MAX;
+  const auto mss = cookies_.check( addresses, client_isn, isn, timestamp_ms() );
+  if ( not mss.has_value() ) {
+    return nullptr;
+  }
+
+  // Rebuild the state the SYN would have created; the SYN/ACK it makes was already sent, by send_syn_cookie()
+  Connection& connection = add_passive_connection( addresses, cookie_config( isn ), listener_index );
+  TCPSegment syn;
+  syn.sender_message.seqno = client_isn;
+  syn.sender_message.SYN = true;
+  syn.receiver_message.window_size = seg.receiver_message.window_size;
+  syn.receiver_message.mss = mss;
+  connection.peer.receive( move( syn ) );
+  while ( connection.peer.maybe_send() ) {}
+  return &connection;
+}
+
+TCPConfig TCPMultiplexer::cookie_config( Wrap32 isn ) const
+{
+  // Options that the cookie has no room for are not negotiated
+  TCPConfig cfg = cfg_;
+  cfg.fixed_isn = isn;
+  cfg.sack = false;
+  cfg.window_scale = false;
+  cfg.timestamps = false;
+  return cfg;
+}
+
+void TCPMultiplexer::send_syn_cookie( const FourTuple& addresses, const TCPSegment& syn )
+{
+  const Wrap32 isn
+    = cookies_.make( addresses, syn.sender_message.seqno, syn.receiver_message.mss, timestamp_ms() );
+  TCPPeer responder { cookie_config( isn ) };
+  responder.receive( syn );
+  while ( auto reply = responder.maybe_send() ) {
+    send_segment( reply.value(), addresses );
+  }
+}
+
+TCPMultiplexer::Connection& TCPMultiplexer::add_passive_connection( const FourTuple& addresses,
+                                                                      const TCPConfig& cfg,
+                                                                      size_t listener )
+{
+  LocalStreamSocket app_end = add_connection( addresses, cfg );
+  Connection& connection = *connections_.at( addresses );
+  connection.listener = listener;
+  connection.app_end = move( app_end );
+  listeners_.at( listener ).half_open++;
+  return connection;
+}
+
+void TCPMultiplexer::maybe_accept( Connection& connection )
+{
+  // established once our SYN is acknowledged (nothing else can be in flight before the application has it)
+  if ( not connection.listener.has_value() or not connection.peer.has_ackno()
+       or connection.peer.sender().sequence_numbers_in_flight() > 0 ) {
+    return;
+  }
+
+  listeners_.at( connection.listener.value() ).half_open--;
+  connection.listener.reset();
+  const FourTuple& addresses = connection.addresses;
+  accept_queue_.emplace(
+    move( connection.app_end.value() ),
+    Address { Address::from_ipv4_numeric( addresses.remote_address ).ip(), addresses.remote_port } );
+  connection.app_end.reset();
+}
+
+void TCPMultiplexer::send_segment( TCPSegment& seg, const FourTuple& addresses )
+{
+  outgoing_datagrams_.push( serialize( TCPOverIPv4Adapter::wrap_tcp_in_ip(
+    seg, addresses.local_address, addresses.local_port, addresses.remote_address, addresses.remote_port ) ) );
+  send_rule_->recheck_interest();
+}
+
+void TCPMultiplexer::collect_segments( Connection& connection )
+{
+  while ( auto seg = connection.peer.maybe_send() ) {
+    send_segment( seg.value(), connection.addresses );
+  }
+}
+
+void TCPMultiplexer::touch( Connection& connection )
+{
+  const uint64_t now = timestamp_ms();
+  if ( connection.peer.active() and now > connection.last_tick_ms ) {
+    connection.peer.tick( now - connection.last_tick_ms );
+    collect_segments( connection );
+  }
+  connection.last_tick_ms = now;
+
+  if ( not connection.touched ) {
+    connection.touched = true;
+    touched_.push_back( &connection );
+  }
+}
+
+void TCPMultiplexer::arm_timer( Connection& connection )
+{
+  optional<uint64_t> due_ms;
+  if ( connection.peer.active() ) {
+    if ( const auto deadline = connection.peer.next_deadline() ) {
+      due_ms = connection.last_tick_ms + deadline.value();
+    }
+  }
+  if ( due_ms == connection.timer_due_ms ) {
+    return;
+  }
+
+  if ( connection.timer.has_value() ) {
+    connection.timer->cancel();
+    connection.timer.reset();
+  }
+  connection.timer_due_ms = due_ms;
+  if ( due_ms.has_value() ) {
+    const uint64_t delay_ms = due_ms.value() - min( timestamp_ms(), due_ms.value() );
+    Connection* const c = &connection;
+    connection.timer = eventloop_.add_timer( timer_category_, delay_ms, [this, c] {
+      c->timer.reset();
+      c->timer_due_ms.reset();
+      touch( *c );
+    } );
+  }
+}
+
+void TCPMultiplexer::settle_touched()
+{
+  for ( Connection* const connection : touched_ ) {
+    connection->touched = false;
+
+    // give up on a handshake whose SYN/ACK was never acknowledged, like any half-open connection that died
+    const bool handshake_failed
+      = connection->listener.has_value()
+        and ( connection->peer.sender().consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS
+              or not connection->peer.active() );
+    if ( handshake_failed or ( not connection->peer.active() and connection->inbound_shutdown ) ) {
+      remove_connection( connections_.find( connection->addresses ) );
+    } else {
+      arm_timer( *connection );
+      for ( auto& rule : connection->rules ) {
+        rule.recheck_interest(); // the event may have changed what the connection can push or read
+      }
+    }
+  }
+  touched_.clear();
+}
+
+decltype( TCPMultiplexer::connections_ )::iterator TCPMultiplexer::remove_connection(
+  decltype( connections_ )::iterator it )
+{
+  Connection& connection = *it->second;
+  if ( connection.listener.has_value() ) {
+    listeners_.at( connection.listener.value() ).half_open--;
+  }
+  for ( auto& rule : connection.rules ) {
+    rule.cancel();
+  }
+  if ( connection.timer.has_value() ) {
+    connection.timer->cancel();
+  }
+  return connections_.erase( it );
+}
+
+void TCPMultiplexer::watch( FileDescriptor& fd, const function<void()>& callback )
+{
+  eventloop_.add_rule( "watched file descriptor", fd, Direction::In, callback );
+}
+
+EventLoop::Result TCPMultiplexer::wait_next_event( int timeout_ms )
+{
+  settle_touched();
+  return eventloop_.wait_next_event( timeout_ms );
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "address.hh"
+#include "buffer.hh"
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "four_tuple.hh"
+#include "socket.hh"
+#include "syn_cookies.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//! Serves many TCP connections over one datagram file descriptor (e.g., a TUN device) from a single event loop
+class TCPMultiplexer
+{
+private:
+  //! One TCPPeer and the socket pair that connects it to the application
+  struct Connection
+  {
+    FourTuple addresses;
+    TCPPeer peer;
+    LocalStreamSocket app_data; //!< the multiplexer's end; the application holds the other
+    std::vector<EventLoop::RuleHandle> rules {};
+    bool inbound_shutdown {};  //!< has the inbound stream been finished towards the application?
+    bool outbound_shutdown {}; //!< has the application finished writing?
+
+    uint64_t last_tick_ms {};                     //!< when the TCPPeer's clock was last advanced
+    std::optional<EventLoop::RuleHandle> timer {}; //!< armed for the TCPPeer's nearest deadline, if any
+    std::optional<uint64_t> timer_due_ms {};
+    bool touched {}; //!< has an event involved the connection since it was last settled?
+
+    //! While a passive open is half-open: the listener it counts against, and the application's end to accept
+    std::optional<size_t> listener {};
+    std::optional<LocalStreamSocket> app_end {};
+  };
+
+  //! A local (address, port) accepting connections; address 0 matches any
+  struct Listener
+  {
+    uint32_t address;
+    uint16_t port;
+    size_t backlog;   //!< most half-open connections to keep
+    bool syn_cookies; //!< past the backlog, answer SYNs statelessly instead of dropping them
+    size_t half_open {};
+  };
+
+  //! Carries one IPv4 datagram per read and write
+  FileDescriptor datagrams_;
+
+  //! Datagrams read from (and written to) `datagrams_` per wait_next_event(), so that a burst is handled without
+  //! an event-loop iteration, and a look at every connection's rules, for each datagram
+  static constexpr unsigned DATAGRAM_BUDGET = 64;
+
+  TCPConfig cfg_;
+
+  EventLoop eventloop_ { EventLoop::Backend::Epoll, EventLoop::Service::AllReady };
+  size_t push_category_;
+  size_t read_category_;
+  size_t timer_category_;
+
+  std::unordered_map<FourTuple, std::unique_ptr<Connection>, FourTupleHash> connections_ {};
+
+  std::vector<Listener> listeners_ {};
+  SYNCookies cookies_ {};
+
+  //! Established passive connections not yet taken by accept(), with the peer's address
+  std::queue<std::pair<LocalStreamSocket, Address>> accept_queue_ {};
+
+  //! Serialized datagrams waiting for the file descriptor to become writable
+  std::queue<std::vector<Buffer>> outgoing_datagrams_ {};
+  std::optional<EventLoop::RuleHandle> send_rule_ {}; //!< told when a datagram is queued
+
+  //! Connections that events have involved since the last settle_touched()
+  std::vector<Connection*> touched_ {};
+
+  //! Create a connection and its event-loop rules; returns the application's end of its socket pair
+  LocalStreamSocket add_connection( const FourTuple& addresses, const TCPConfig& cfg );
+
+  //! Handle a segment for no known connection: a SYN or a SYN cookie's ACK to a listener opens one
+  Connection* open_passive( const FourTuple& addresses, const TCPSegment& seg );
+
+  //! Answer a SYN with a SYN cookie, keeping no state
+  void send_syn_cookie( const FourTuple& addresses, const TCPSegment& syn );
+
+  //! The configuration for a connection whose SYN was answered with a SYN cookie
+  TCPConfig cookie_config( Wrap32 isn ) const;
+
+  //! Queue a segment for the network
+  void send_segment( TCPSegment& seg, const FourTuple& addresses );
+
+  //! A half-open connection that will count against a listener until accepted
+  Connection& add_passive_connection( const FourTuple& addresses, const TCPConfig& cfg, size_t listener );
+
+  //! Once a half-open connection is established, queue it for accept()
+  void maybe_accept( Connection& connection );
+
+  //! Close a connection and cancel its rules
+  decltype( connections_ )::iterator remove_connection( decltype( connections_ )::iterator it );
+
+  //! Read one datagram and hand its segment to the matching connection (or a listener)
+  void receive_datagram();
+
+  //! Queue the connection's outgoing segments as datagrams
+  void collect_segments( Connection& connection );
+
+  //! Advance the connection's clock to now, and note that it needs settling (before any event involving it)
+  void touch( Connection& connection );
+
+  //! Keep one timer armed for the connection's nearest deadline (retransmission, pacing or delayed ACK), if any
+  void arm_timer( Connection& connection );
+
+  //! Drop each touched connection that has finished, and re-arm the others' timers and recheck their rules'
+  //! interest. Only connections that events involved are looked at, and they are removed here rather than from
+  //! their own rules' callbacks.
+  void settle_touched();
+
+  Listener* listener_for( uint32_t address, uint16_t port );
+
+public:
+  //! Serve connections over `datagrams`, configuring each TCPPeer with `cfg`
+  explicit TCPMultiplexer( FileDescriptor&& datagrams, const TCPConfig& cfg = {} );
+
+  //! Open a connection from `local` to `remote`; returns the application's end of the connection
+  LocalStreamSocket connect( const Address& local, const Address& remote );
+
+  //! Accept connections to `local` (address "0" for any local address), keeping at most `backlog` half-open.
+  //! Past that, SYNs are answered with SYN cookies, or dropped if `syn_cookies` is false.
+  void listen( const Address& local, size_t backlog = 128, bool syn_cookies = true );
+
+  //! Take the next accepted connection, if any, with the peer's address
+  std::optional<std::pair<LocalStreamSocket, Address>> accept();
+
+  //! Serve ready events and due timers, waiting at most `timeout_ms` (-1 for no limit) for one
+  EventLoop::Result wait_next_event( int timeout_ms );
+
+  //! Also call `callback` from the event loop whenever `fd` is readable (e.g., to take requests from other threads)
+  void watch( FileDescriptor& fd, const std::function<void()>& callback );
+
+  //! Number of connections currently served, including half-open ones
+  size_t connection_count() const { return connections_.size(); }
+
+  //! \name
+  //! Event-loop rules refer to the multiplexer, so it cannot be moved or copied
+
+  //!@{
+  TCPMultiplexer( const TCPMultiplexer& ) = delete;
+  TCPMultiplexer( TCPMultiplexer&& ) = delete;
+  TCPMultiplexer& operator=( const TCPMultiplexer& ) = delete;
+  TCPMultiplexer& operator=( TCPMultiplexer&& ) = delete;
+  ~TCPMultiplexer() = default;
+  //!@}
+};
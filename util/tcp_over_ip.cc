@@ -42,13 +42,18 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
   }
 
   // is the payload a valid TCP segment?
-  TCPSegment tcp_seg;
-  if ( not parse( tcp_seg, ip_dgram.payload, ip_dgram.header.pseudo_checksum() ) ) {
+  const TCPSegmentView view { ip_dgram.payload, ip_dgram.header.pseudo_checksum() };
+  if ( not view.valid() ) {
     return {};
   }
 
   // is the TCP segment for us?
-  if ( tcp_seg.udinfo.dst_port != config().source.port() ) {
+  if ( view.dst_port() != config().source.port() ) {
+    return {};
+  }
+
+  TCPSegment tcp_seg;
+  if ( not view.decode( tcp_seg ) ) {
     return {};
   }
 
@@ -75,16 +80,29 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( TCPSegment& seg )
+{
+  return wrap_tcp_in_ip( seg,
+                         config().source.ipv4_numeric(),
+                         config().source.port(),
+                         config().destination.ipv4_numeric(),
+                         config().destination.port() );
+}
+
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( TCPSegment& seg,
+                                                     uint32_t src_address,
+                                                     uint16_t src_port,
+                                                     uint32_t dst_address,
+                                                     uint16_t dst_port )
 {
   // set the port numbers in the TCP segment
-  seg.udinfo.src_port = config().source.port();
-  seg.udinfo.dst_port = config().destination.port();
+  seg.udinfo.src_port = src_port;
+  seg.udinfo.dst_port = dst_port;
 
   // create an Internet Datagram and set its addresses and length
   InternetDatagram ip_dgram;
-  ip_dgram.header.src = config().source.ipv4_numeric();
-  ip_dgram.header.dst = config().destination.ipv4_numeric();
-  ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + seg.sender_message.payload.size();
+  ip_dgram.header.src = src_address;
+  ip_dgram.header.dst = dst_address;
+  ip_dgram.header.len = ip_dgram.header.hlen * 4 + seg.header_length() + seg.sender_message.payload.size();
 
   // set payload, calculating TCP checksum using information from IP header
   seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
@@ -14,4 +14,11 @@ public:
   std::optional<TCPSegment> unwrap_tcp_in_ip( const InternetDatagram& ip_dgram );
 
   InternetDatagram wrap_tcp_in_ip( TCPSegment& seg );
+
+  //! Wrap `seg` in an IPv4 datagram between numeric addresses, setting its ports and both checksums
+  static InternetDatagram wrap_tcp_in_ip( TCPSegment& seg,
+                                          uint32_t src_address,
+                                          uint16_t src_port,
+                                          uint32_t dst_address,
+                                          uint16_t dst_port );
 };
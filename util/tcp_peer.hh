@@ -7,6 +7,8 @@
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
 
+#include <algorithm>
+#include <cstddef>
 #include <optional>
 
 class TCPPeer
@@ -20,14 +22,91 @@ class TCPPeer
 
   bool need_send_ {};
 
+  // Delayed ACK state: in-order data received since our last segment, and how long it has waited
+  uint64_t unacked_bytes_ {};
+  uint64_t largest_payload_ {}; // the peer's full-sized segment, as far as we have seen
+  std::optional<uint64_t> ack_timer_ {};
+
+  // Right edge of the last window we advertised, as a stream index
+  uint64_t advertised_window_end_ {};
+
+  // Send a window update once the application has freed min(half the buffer, one segment) (RFC 1122 4.2.3.3)
+  bool window_opened() const
+  {
+    const Writer& writer = inbound_stream_.writer();
+    const uint64_t threshold = std::min<uint64_t>( writer.capacity() / 2, cfg_.mss );
+    return has_ackno() and not writer.is_closed()
+           and writer.bytes_pushed() + writer.available_capacity() >= advertised_window_end_ + threshold;
+  }
+
+  std::optional<bool> peer_offered_window_scale_ {};
+
+  // Receive-buffer autotuning, like Linux's dynamic right-sizing: once per round trip, measure how much the peer
+  // delivered (bytes the application drained plus bytes held out of order) and let the receive capacity grow to
+  // twice that, so a sender limited by our window can double its rate each RTT.
+  uint64_t autotune_elapsed_ms_ {};
+  uint64_t autotune_popped_ {}; // inbound bytes_popped() when the current measurement began
+
+  void autotune_receive_capacity( uint64_t ms_since_last_tick )
+  {
+    const auto rtt = sender_.smoothed_rtt();
+    autotune_elapsed_ms_ += ms_since_last_tick;
+    if ( not rtt.has_value() or autotune_elapsed_ms_ < std::max<uint64_t>( rtt.value(), 1 ) ) {
+      return;
+    }
+    const uint64_t popped = inbound_stream_.reader().bytes_popped();
+    const uint64_t delivered = popped - autotune_popped_ + reassembler_.bytes_pending();
+    const uint64_t target = std::min<uint64_t>( 2 * delivered, cfg_.recv_capacity_max );
+    if ( target > inbound_stream_.writer().capacity() ) {
+      inbound_stream_.writer().set_capacity( target ); // the window update goes out with the next maybe_send()
+    }
+    autotune_elapsed_ms_ = 0;
+    autotune_popped_ = popped;
+  }
+
 public:
-  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg ) {}
+  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg )
+  {
+    sender_.set_nagle( cfg_.nagle );
+    sender_.set_pacing( cfg_.pacing );
+    sender_.set_timestamps( cfg_.timestamps ); // our SYN offers them; turned off if the peer's SYN doesn't
+  }
 
   Writer& outbound_writer() { return outbound_stream_.writer(); }
   Reader& inbound_reader() { return inbound_stream_.reader(); }
 
   void push() { sender_.push( outbound_stream_.reader() ); };
-  void tick( uint64_t ms_since_last_tick ) { sender_.tick( ms_since_last_tick ); }
+
+  // Like TCP_CORK: while corked, only full-sized segments are sent. Uncorking sends whatever is left.
+  void cork() { sender_.set_cork( true ); }
+  void uncork()
+  {
+    sender_.set_cork( false );
+    push();
+  }
+  void tick( uint64_t ms_since_last_tick )
+  {
+    sender_.tick( ms_since_last_tick );
+    if ( cfg_.recv_capacity_max > cfg_.recv_capacity ) {
+      autotune_receive_capacity( ms_since_last_tick );
+    }
+    if ( ack_timer_.has_value() ) {
+      ack_timer_.value() += ms_since_last_tick;
+      need_send_ |= ( ack_timer_.value() >= cfg_.ack_delay_ms );
+    }
+  }
+
+  // How many ms until tick() next has work to do (a retransmission, a paced segment or a delayed ACK), if any.
+  // Autotuning needs no deadline of its own: it measures whenever ticks come, and they come while data flows.
+  std::optional<uint64_t> next_deadline() const
+  {
+    auto deadline = sender_.next_deadline();
+    if ( ack_timer_.has_value() ) {
+      const uint64_t ack_wait = cfg_.ack_delay_ms - std::min<uint64_t>( ack_timer_.value(), cfg_.ack_delay_ms );
+      deadline = std::min( deadline.value_or( ack_wait ), ack_wait );
+    }
+    return deadline;
+  }
 
   bool has_ackno() const { return receiver_.send( inbound_stream_.writer() ).ackno.has_value(); }
 
@@ -47,14 +126,64 @@ public:
       return;
     }
 
+    // SACK and timestamps are in effect only if both SYNs offer them, so the peer's mean nothing unless we
+    // offered them too
+    if ( not cfg_.sack ) {
+      seg.sender_message.sack_permitted = false;
+    }
+    if ( not cfg_.timestamps ) {
+      seg.sender_message.timestamp.reset();
+    }
+
+    // PAWS: a stale duplicate is dropped entirely, but acknowledged (RFC 7323 5.3)
+    if ( receiver_.paws_reject( seg.sender_message ) ) {
+      need_send_ = true;
+      return;
+    }
+
     // Give incoming TCPReceiverMessage to sender.
-    sender_.receive( seg.receiver_message );
+    sender_.receive( seg.receiver_message, seg.sender_message.sequence_length() > 0 );
+
+    if ( seg.sender_message.SYN ) {
+      // Segments are sized by the smaller of the two MSS options (MAX_PAYLOAD_SIZE if the peer sent none).
+      const size_t mss
+        = std::min<size_t>( cfg_.mss, seg.receiver_message.mss.value_or( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      if ( cfg_.mtu_probing ) {
+        sender_.set_mss( std::min( mss, TCPConfig::MAX_PAYLOAD_SIZE ), mss );
+      } else {
+        sender_.set_mss( mss );
+      }
+
+      if ( not seg.sender_message.timestamp.has_value() ) {
+        sender_.set_timestamps( false );
+      }
+
+      // Window scaling takes effect only if both SYNs carry the option, and never applies to the SYNs themselves.
+      peer_offered_window_scale_ = seg.receiver_message.window_scale.has_value();
+      if ( cfg_.window_scale and peer_offered_window_scale_.value() ) {
+        sender_.set_window_shift( seg.receiver_message.window_scale.value() );
+        receiver_.set_window_shift( cfg_.window_shift() );
+      }
+    }
 
     // Give incoming TCPSenderMessage to receiver.
     // If SenderMessage is non-empty or a keep-alive, make sure to reply.
-    need_send_ |= ( seg.sender_message.sequence_length() > 0 );
+    // With delayed ACKs, in-order data is acknowledged every second full-sized segment or when the timer expires;
+    // SYN, FIN, out-of-order data and data that fills a hole are still acknowledged right away.
     const auto our_ackno = receiver_.send( inbound_stream_.writer() ).ackno;
     need_send_ |= ( our_ackno.has_value() and seg.sender_message.seqno + 1 == our_ackno.value() );
+    if ( seg.sender_message.sequence_length() > 0 ) {
+      const bool in_order = our_ackno.has_value() and seg.sender_message.seqno == our_ackno.value()
+                            and reassembler_.bytes_pending() == 0;
+      if ( cfg_.ack_delay_ms == 0 or seg.sender_message.SYN or seg.sender_message.FIN or not in_order ) {
+        need_send_ = true;
+      } else {
+        largest_payload_ = std::max<uint64_t>( largest_payload_, seg.sender_message.payload.size() );
+        unacked_bytes_ += seg.sender_message.payload.size();
+        ack_timer_ = ack_timer_.value_or( 0 );
+        need_send_ |= ( unacked_bytes_ >= 2 * largest_payload_ );
+      }
+    }
 
     receiver_.receive( std::move( seg.sender_message ), reassembler_, inbound_stream_.writer() );
   }
@@ -64,11 +193,15 @@ public:
     // Get outgoing TCPReceiverMessage from receiver.
     auto receiver_msg = receiver_.send( inbound_stream_.writer() );
 
-    // If connection is alive, push stream to TCPSender.
+    // If connection is alive, push stream to TCPSender, leaving room in each segment for the options it will
+    // carry (RFC 6691): timestamps, and the SACK blocks we currently have to report.
     if ( receiver_msg.ackno.has_value() ) {
+      sender_.set_option_length( TCPSegment::options_length( sender_.send_empty_message(), receiver_msg ) );
       push();
     }
 
+    need_send_ |= window_opened();
+
     // Get (possible) outgoing TCPSenderMessage, using empty message if we need to send something.
     auto sender_msg = sender_.maybe_send();
 
@@ -76,10 +209,44 @@ public:
       sender_msg = sender_.send_empty_message();
     }
 
+    if ( sender_msg.has_value() and sender_msg->SYN ) {
+      sender_msg->sack_permitted = cfg_.sack;
+      // The window in a SYN is never scaled; offer the shift unless the peer's SYN already declined it.
+      receiver_msg = receiver_.send( inbound_stream_.writer() );
+      receiver_msg.window_size
+        = static_cast<uint16_t>( std::min<uint64_t>( inbound_stream_.writer().available_capacity(), UINT16_MAX ) );
+      if ( cfg_.window_scale and peer_offered_window_scale_.value_or( true ) ) {
+        receiver_msg.window_scale = cfg_.window_shift();
+      }
+      // A peer that sees no MSS option uses MAX_PAYLOAD_SIZE, so only an MSS the config changed is offered
+      if ( cfg_.mss != TCPConfig::MAX_PAYLOAD_SIZE ) {
+        receiver_msg.mss = cfg_.mss;
+      }
+    }
+
+    // A segment sized before more SACK blocks were due (such as a retransmission) reports only as many as fit
+    if ( sender_msg.has_value() and not receiver_msg.sack_blocks.empty() ) {
+      auto blocks = std::move( receiver_msg.sack_blocks );
+      receiver_msg.sack_blocks.clear();
+      const size_t used
+        = sender_msg->payload.size() + TCPSegment::options_length( sender_msg.value(), receiver_msg );
+      const size_t room = sender_.mss() - std::min( sender_.mss(), used );
+      // the SACK option takes 4 bytes (two NOPs, kind and length) and 8 more for each block
+      const size_t fit = room < 4 ? 0 : ( room - 4 ) / 8;
+      if ( blocks.size() > fit ) {
+        blocks.erase( blocks.begin() + static_cast<std::ptrdiff_t>( fit ), blocks.end() );
+      }
+      receiver_msg.sack_blocks = std::move( blocks );
+    }
+
     need_send_ = false;
 
     // Send the segment
     if ( sender_msg.has_value() ) {
+      unacked_bytes_ = 0;
+      ack_timer_.reset();
+      advertised_window_end_
+        = inbound_stream_.writer().bytes_pushed() + inbound_stream_.writer().available_capacity();
       return TCPSegment {
         sender_msg.value(), receiver_msg, outbound_stream_.reader().has_error() or inbound_reader().has_error() };
     }
@@ -3,22 +3,41 @@
 #include "wrapping_integers.hh"
 
 #include <optional>
+#include <utility>
+#include <vector>
 
 /*
  * The TCPReceiverMessage structure contains the information sent from a TCP receiver to its sender.
  *
- * It contains two fields:
+ * It contains six fields:
  *
  * 1) The acknowledgment number (ackno): the *next* sequence number needed by the TCP Receiver.
  *    This is an optional field that is empty if the TCPReceiver hasn't yet received the Initial Sequence Number.
  *
  * 2) The window size. This is the number of sequence numbers that the TCP receiver is interested
  *    to receive, starting from the ackno if present. The maximum value is 65,535 (UINT16_MAX from
- *    the <cstdint> header).
+ *    the <cstdint> header). If window scaling was negotiated, the window is window_size << shift.
+ *
+ * 3) The SACK blocks (RFC 2018): [left, right) sequence number ranges the TCP receiver holds beyond the
+ *    ackno. Only sent if the peer's SYN said it understands them. The first block contains the segment
+ *    that triggered this message.
+ *
+ * 4) The window scale option (RFC 7323), only sent along with a SYN: the shift the TCP receiver will
+ *    apply to every later window_size. The window_size in a SYN segment is never scaled.
+ *
+ * 5) The maximum segment size option (RFC 9293), only sent along with a SYN: the largest payload the
+ *    TCP receiver can accept in one segment.
+ *
+ * 6) The timestamp echo (TSecr, RFC 7323): the most recent timestamp the TCP receiver has accepted
+ *    from the peer's sender, if the timestamps option is in use.
  */
 
 struct TCPReceiverMessage
 {
   std::optional<Wrap32> ackno {};
   uint16_t window_size {};
+  std::vector<std::pair<Wrap32, Wrap32>> sack_blocks {};
+  std::optional<uint8_t> window_scale {};
+  std::optional<uint16_t> mss {};
+  std::optional<uint32_t> timestamp_echo {};
 };
@@ -1,95 +1,407 @@
 #include "tcp_segment.hh"
 #include "checksum.hh"
+#include "tcp_config.hh"
+#include "wire_layout.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <cstddef>
+#include <string_view>
 
 static constexpr uint32_t TCPHeaderMinLen = 5; // 32-bit words
 
+// TCP option kinds
+static constexpr uint8_t TCPOptionEnd = 0;
+static constexpr uint8_t TCPOptionNop = 1;
+static constexpr uint8_t TCPOptionMSS = 2;
+static constexpr uint8_t TCPOptionWindowScale = 3;
+static constexpr uint8_t TCPOptionSACKPermitted = 4;
+static constexpr uint8_t TCPOptionSACK = 5;
+static constexpr uint8_t TCPOptionTimestamps = 8;
+
 using namespace std;
 
-void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
+class Wrap32Serializable : public Wrap32
 {
-  {
-    /* verify checksum */
-    Parser parser2 = parser;
-    Buffer all_remaining;
-    parser2.all_remaining( all_remaining );
-    InternetChecksum check { datagram_layer_pseudo_checksum };
-    check.add( all_remaining );
-    if ( check.value() ) {
-      parser.set_error();
-      return;
-    }
-  }
+public:
+  uint32_t raw_value() const { return raw_value_; }
+};
 
-  uint32_t raw32 {};
-  uint16_t raw16 {};
-  uint8_t octet {};
+// The fixed part of the TCP header, as it is on the wire
+struct TCPFixedHeader
+{
+  uint16_t src_port {};
+  uint16_t dst_port {};
+  uint32_t seqno {};
+  uint32_t ackno {};
+  uint8_t data_offset {}; // 32-bit words
+  bool ack {};
+  bool rst {};
+  bool syn {};
+  bool fin {};
+  uint16_t window_size {};
+  uint16_t cksum {};
+  uint16_t urgent {};
 
-  parser.integer( udinfo.src_port );
-  parser.integer( udinfo.dst_port );
+  using SrcPort = wire::Integer<0, &TCPFixedHeader::src_port>;
+  using DstPort = wire::Integer<2, &TCPFixedHeader::dst_port>;
+  using Seqno = wire::Integer<4, &TCPFixedHeader::seqno>;
+  using Ackno = wire::Integer<8, &TCPFixedHeader::ackno>;
+  using DataOffset = wire::Bits<&TCPFixedHeader::data_offset, 4, 4>;
+  using OffsetByte = wire::Packed<12, uint8_t, DataOffset>;
+  using Ack = wire::Bits<&TCPFixedHeader::ack, 4, 1>;
+  using Rst = wire::Bits<&TCPFixedHeader::rst, 2, 1>;
+  using Syn = wire::Bits<&TCPFixedHeader::syn, 1, 1>;
+  using Fin = wire::Bits<&TCPFixedHeader::fin, 0, 1>;
+  using Flags = wire::Packed<13, uint8_t, Ack, Rst, Syn, Fin>;
+  using WindowSize = wire::Integer<14, &TCPFixedHeader::window_size>;
+  using Cksum = wire::Integer<16, &TCPFixedHeader::cksum>;
+  using Urgent = wire::Integer<18, &TCPFixedHeader::urgent>;
 
-  parser.integer( raw32 );
-  sender_message.seqno = Wrap32 { raw32 };
+  using Layout = wire::Layout<SrcPort, DstPort, Seqno, Ackno, OffsetByte, Flags, WindowSize, Cksum, Urgent>;
+};
 
-  parser.integer( raw32 );
-  receiver_message.ackno = Wrap32 { raw32 };
+static_assert( TCPFixedHeader::Layout::length == TCPHeaderMinLen * 4 );
 
-  parser.integer( octet );
-  const uint8_t data_offset = octet >> 4;
+// Reads a big-endian 16-bit value from the start of `str`
+static uint16_t read_u16( string_view str )
+{
+  return static_cast<uint16_t>( static_cast<uint8_t>( str.at( 0 ) ) << 8 | static_cast<uint8_t>( str.at( 1 ) ) );
+}
 
-  parser.integer( octet ); // flags
-  if ( not( octet & 0b0001'0000 ) ) {
-    receiver_message.ackno.reset(); // no ACK
+// Reads a big-endian 32-bit value from the start of `str`
+static uint32_t read_u32( string_view str )
+{
+  uint32_t ret = 0;
+  for ( size_t i = 0; i < 4; i++ ) {
+    ret = ( ret << 8 ) | static_cast<uint8_t>( str.at( i ) );
   }
+  return ret;
+}
 
-  reset = octet & 0b0000'0100;
-  sender_message.SYN = octet & 0b0000'0010;
-  sender_message.FIN = octet & 0b0000'0001;
+static void append_u32( string& str, uint32_t val )
+{
+  for ( size_t i = 0; i < 4; i++ ) {
+    str.push_back( static_cast<char>( val >> ( ( 3 - i ) * 8 ) ) );
+  }
+}
 
-  parser.integer( receiver_message.window_size );
-  parser.integer( udinfo.cksum );
-  parser.integer( raw16 ); // urgent pointer
+// Decodes the TCP options into the segment; returns false if they are malformed
+static bool parse_options( string_view options, TCPSegment& seg )
+{
+  while ( not options.empty() ) {
+    const uint8_t kind = options.front();
+    if ( kind == TCPOptionEnd ) {
+      break;
+    }
+    if ( kind == TCPOptionNop ) {
+      options.remove_prefix( 1 );
+      continue;
+    }
+    if ( options.size() < 2 ) {
+      return false;
+    }
+    const uint8_t len = options.at( 1 );
+    if ( len < 2 or len > options.size() ) {
+      return false;
+    }
+    const string_view value = options.substr( 2, len - 2 );
+    switch ( kind ) {
+      case TCPOptionMSS:
+        if ( value.size() != 2 ) {
+          return false;
+        }
+        if ( seg.sender_message.SYN ) {
+          seg.receiver_message.mss = read_u16( value );
+        }
+        break;
+      case TCPOptionWindowScale:
+        if ( value.size() != 1 ) {
+          return false;
+        }
+        if ( seg.sender_message.SYN ) {
+          seg.receiver_message.window_scale
+            = min( static_cast<uint8_t>( value.front() ), TCPConfig::MAX_WINDOW_SHIFT );
+        }
+        break;
+      case TCPOptionSACKPermitted:
+        seg.sender_message.sack_permitted = seg.sender_message.SYN;
+        break;
+      case TCPOptionSACK:
+        if ( value.size() % 8 ) {
+          return false;
+        }
+        for ( size_t i = 0; i < value.size(); i += 8 ) {
+          seg.receiver_message.sack_blocks.emplace_back( Wrap32 { read_u32( value.substr( i ) ) },
+                                                         Wrap32 { read_u32( value.substr( i + 4 ) ) } );
+        }
+        break;
+      case TCPOptionTimestamps:
+        if ( value.size() != 8 ) {
+          return false;
+        }
+        seg.sender_message.timestamp = read_u32( value );
+        if ( seg.receiver_message.ackno.has_value() ) { // TSecr is only valid with the ACK flag
+          seg.receiver_message.timestamp_echo = read_u32( value.substr( 4 ) );
+        }
+        break;
+      default: // unknown options are skipped
+        break;
+    }
+    options.remove_prefix( len );
+  }
+  return true;
+}
 
-  // skip any options or anything extra in the header
-  if ( data_offset < TCPHeaderMinLen ) {
-    parser.set_error();
+// Encodes the segment's TCP options, padded to a multiple of 4 bytes
+static string serialize_options( const TCPSegment& seg )
+{
+  string options;
+  if ( seg.sender_message.SYN and seg.receiver_message.mss.has_value() ) {
+    const uint16_t mss = seg.receiver_message.mss.value();
+    options.append( { TCPOptionMSS, 4, static_cast<char>( mss >> 8 ), static_cast<char>( mss ) } );
+  }
+  if ( seg.sender_message.SYN and seg.receiver_message.window_scale.has_value() ) {
+    options.append(
+      { TCPOptionNop, TCPOptionWindowScale, 3, static_cast<char>( seg.receiver_message.window_scale.value() ) } );
   }
-  parser.remove_prefix( data_offset * 4 - TCPHeaderMinLen * 4 );
+  if ( seg.sender_message.SYN and seg.sender_message.sack_permitted ) {
+    options.append( { TCPOptionNop, TCPOptionNop, TCPOptionSACKPermitted, 2 } );
+  }
+  if ( seg.sender_message.timestamp.has_value() ) {
+    options.append( { TCPOptionNop, TCPOptionNop, TCPOptionTimestamps, 10 } );
+    append_u32( options, seg.sender_message.timestamp.value() );
+    append_u32( options, seg.receiver_message.timestamp_echo.value_or( 0 ) );
+  }
+  if ( seg.receiver_message.ackno.has_value() and not seg.receiver_message.sack_blocks.empty() ) {
+    // with timestamps, one fewer SACK block fits in the 40 bytes of options
+    const size_t max_blocks = TCPConfig::MAX_SACK_BLOCKS - ( seg.sender_message.timestamp.has_value() ? 1 : 0 );
+    const size_t blocks = min( seg.receiver_message.sack_blocks.size(), max_blocks );
+    options.append( { TCPOptionNop, TCPOptionNop, TCPOptionSACK, static_cast<char>( 2 + blocks * 8 ) } );
+    for ( size_t i = 0; i < blocks; i++ ) {
+      const auto& [left, right] = seg.receiver_message.sack_blocks.at( i );
+      append_u32( options, Wrap32Serializable { left }.raw_value() );
+      append_u32( options, Wrap32Serializable { right }.raw_value() );
+    }
+  }
+  options.resize( ( options.size() + 3 ) / 4 * 4, TCPOptionEnd );
+  return options;
+}
 
-  parser.all_remaining( sender_message.payload );
+void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
+{
+  vector<Buffer> fragments;
+  parser.all_remaining( fragments );
+  if ( not TCPSegmentView { fragments, datagram_layer_pseudo_checksum }.decode( *this ) ) {
+    parser.set_error();
+  }
 }
 
-class Wrap32Serializable : public Wrap32
+// The fixed part of the segment's header, followed by `options_size` bytes of options
+static TCPFixedHeader fixed_header( const TCPSegment& seg, size_t options_size )
 {
-public:
-  uint32_t raw_value() const { return raw_value_; }
-};
+  const Wrap32 ackno = seg.receiver_message.ackno.value_or( Wrap32 { 0 } );
+  return { .src_port = seg.udinfo.src_port,
+           .dst_port = seg.udinfo.dst_port,
+           .seqno = Wrap32Serializable { seg.sender_message.seqno }.raw_value(),
+           .ackno = Wrap32Serializable { ackno }.raw_value(),
+           .data_offset = static_cast<uint8_t>( TCPHeaderMinLen + options_size / 4 ),
+           .ack = seg.receiver_message.ackno.has_value(),
+           .rst = seg.reset,
+           .syn = seg.sender_message.SYN,
+           .fin = seg.sender_message.FIN,
+           .window_size = seg.receiver_message.window_size,
+           .cksum = seg.udinfo.cksum,
+           .urgent = 0 };
+}
 
 void TCPSegment::serialize( Serializer& serializer ) const
 {
-  serializer.integer( udinfo.src_port );
-  serializer.integer( udinfo.dst_port );
-  serializer.integer( Wrap32Serializable { sender_message.seqno }.raw_value() );
-  serializer.integer( Wrap32Serializable { receiver_message.ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { TCPHeaderMinLen << 4 } ); // data offset
-  const uint8_t flags = ( receiver_message.ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
-                        | ( sender_message.SYN ? 0b0000'0010U : 0 ) | ( sender_message.FIN ? 0b0000'0001U : 0 );
-  serializer.integer( flags );
-  serializer.integer( receiver_message.window_size );
-  serializer.integer( udinfo.cksum );
-  serializer.integer( uint16_t { 0 } ); // urgent pointer
+  const string options = serialize_options( *this );
+  serializer.reserve( TCPHeaderMinLen * 4 + options.size() );
+  TCPFixedHeader::Layout::serialize( serializer, fixed_header( *this, options.size() ) );
+  for ( const char c : options ) {
+    serializer.integer( static_cast<uint8_t>( c ) );
+  }
   serializer.buffer( sender_message.payload );
 }
 
+size_t TCPSegment::header_length() const
+{
+  return TCPHeaderMinLen * 4 + options_length();
+}
+
+size_t TCPSegment::options_length( const TCPSenderMessage& sender, const TCPReceiverMessage& receiver )
+{
+  // each option is laid out as serialize_options() writes it, padded with NOPs to 4 bytes
+  size_t length = 0;
+  if ( sender.SYN ) {
+    length += receiver.mss.has_value() ? 4 : 0;
+    length += receiver.window_scale.has_value() ? 4 : 0;
+    length += sender.sack_permitted ? 4 : 0;
+  }
+  if ( sender.timestamp.has_value() ) {
+    length += 12;
+  }
+  if ( receiver.ackno.has_value() and not receiver.sack_blocks.empty() ) {
+    const size_t max_blocks = TCPConfig::MAX_SACK_BLOCKS - ( sender.timestamp.has_value() ? 1 : 0 );
+    length += 4 + 8 * min( receiver.sack_blocks.size(), max_blocks );
+  }
+  return ( length + 3 ) / 4 * 4;
+}
+
+// Sums the header as it will be written, and the payload (unless the sender already summed it), without
+// serializing the segment
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
   udinfo.cksum = 0;
-  Serializer s;
-  serialize( s );
+  const string options = serialize_options( *this );
+  array<char, TCPFixedHeader::Layout::length> fixed {};
+  TCPFixedHeader::Layout::write( fixed_header( *this, options.size() ), fixed.data() );
 
   InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( s.output() );
+  check.add( { fixed.data(), fixed.size() } );
+  check.add( options );
+  if ( sender_message.payload_checksum.has_value() ) {
+    check.add( sender_message.payload_checksum.value() );
+  } else {
+    check.add( sender_message.payload );
+  }
   udinfo.cksum = check.value();
 }
+
+TCPSegmentView::TCPSegmentView( const vector<Buffer>& fragments, uint32_t datagram_layer_pseudo_checksum )
+  : fragments_( &fragments )
+{
+  InternetChecksum check { datagram_layer_pseudo_checksum };
+  size_t total = 0;
+  for ( const auto& fragment : fragments ) {
+    check.add( fragment );
+    total += fragment.size();
+  }
+  if ( check.value() or total < TCPHeaderMinLen * 4 ) {
+    return;
+  }
+
+  // decode the header where it lies if the first fragment holds all of it, or else from a copy of its first bytes
+  const string_view front = fragments.front();
+  in_place_ = front.size() >= TCPHeaderMinLen * 4
+              and front.size() >= TCPFixedHeader::OffsetByte::get<TCPFixedHeader::DataOffset>( front.data() ) * 4U;
+  if ( not in_place_ ) {
+    auto next = gathered_.begin();
+    for ( const auto& fragment : fragments ) {
+      const string_view piece = string_view { fragment }.substr( 0, gathered_.end() - next );
+      next = ranges::copy( piece, next ).out;
+    }
+  }
+
+  header_length_ = TCPFixedHeader::OffsetByte::get<TCPFixedHeader::DataOffset>( header() ) * 4U;
+  valid_ = header_length_ >= TCPHeaderMinLen * 4 and header_length_ <= total;
+}
+
+const char* TCPSegmentView::header() const
+{
+  return in_place_ ? string_view { fragments_->front() }.data() : gathered_.data();
+}
+
+uint16_t TCPSegmentView::src_port() const
+{
+  return TCPFixedHeader::SrcPort::get( header() );
+}
+
+uint16_t TCPSegmentView::dst_port() const
+{
+  return TCPFixedHeader::DstPort::get( header() );
+}
+
+Wrap32 TCPSegmentView::seqno() const
+{
+  return Wrap32 { TCPFixedHeader::Seqno::get( header() ) };
+}
+
+optional<Wrap32> TCPSegmentView::ackno() const
+{
+  if ( not TCPFixedHeader::Flags::get<TCPFixedHeader::Ack>( header() ) ) {
+    return {};
+  }
+  return Wrap32 { TCPFixedHeader::Ackno::get( header() ) };
+}
+
+bool TCPSegmentView::RST() const
+{
+  return TCPFixedHeader::Flags::get<TCPFixedHeader::Rst>( header() );
+}
+
+bool TCPSegmentView::SYN() const
+{
+  return TCPFixedHeader::Flags::get<TCPFixedHeader::Syn>( header() );
+}
+
+bool TCPSegmentView::FIN() const
+{
+  return TCPFixedHeader::Flags::get<TCPFixedHeader::Fin>( header() );
+}
+
+uint16_t TCPSegmentView::window_size() const
+{
+  return TCPFixedHeader::WindowSize::get( header() );
+}
+
+vector<Buffer> TCPSegmentView::payload() const
+{
+  vector<Buffer> ret;
+  if ( not valid_ ) {
+    return ret;
+  }
+
+  size_t skip = header_length_;
+  for ( const auto& fragment : *fragments_ ) {
+    if ( skip >= fragment.size() ) {
+      skip -= fragment.size();
+      continue;
+    }
+    ret.push_back( fragment.substr( skip ) );
+    skip = 0;
+  }
+  return ret;
+}
+
+bool TCPSegmentView::decode( TCPSegment& seg ) const
+{
+  if ( not valid_ ) {
+    return false;
+  }
+
+  TCPFixedHeader fixed;
+  TCPFixedHeader::Layout::read( header(), fixed );
+  seg.udinfo.src_port = fixed.src_port;
+  seg.udinfo.dst_port = fixed.dst_port;
+  seg.udinfo.cksum = fixed.cksum;
+  seg.sender_message.seqno = Wrap32 { fixed.seqno };
+  seg.receiver_message.ackno = Wrap32 { fixed.ackno };
+  if ( not fixed.ack ) {
+    seg.receiver_message.ackno.reset();
+  }
+  seg.reset = fixed.rst;
+  seg.sender_message.SYN = fixed.syn;
+  seg.sender_message.FIN = fixed.fin;
+  seg.receiver_message.window_size = fixed.window_size;
+
+  if ( not parse_options( { header() + TCPHeaderMinLen * 4, header_length_ - TCPHeaderMinLen * 4 }, seg ) ) {
+    return false;
+  }
+
+  // the payload shares the fragments' storage, unless it spans more than one of them
+  vector<Buffer> payload = this->payload();
+  if ( payload.size() == 1 ) {
+    seg.sender_message.payload = move( payload.front() );
+  } else if ( payload.size() > 1 ) {
+    string joined;
+    for ( const auto& piece : payload ) {
+      joined.append( piece );
+    }
+    PacketPool::local().count_copy( joined.size() );
+    seg.sender_message.payload = move( joined );
+  }
+  return true;
+}
@@ -5,6 +5,10 @@
 #include "tcp_sender_message.hh"
 #include "udinfo.hh"
 
+#include <array>
+#include <optional>
+#include <vector>
+
 struct TCPSegment
 {
   TCPSenderMessage sender_message {};
@@ -16,4 +20,55 @@ struct TCPSegment
   void serialize( Serializer& serializer ) const;
 
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
+
+  // Length of the TCP header, including options
+  size_t header_length() const;
+
+  // Length of the TCP options, padded to a multiple of 4 bytes
+  size_t options_length() const { return options_length( sender_message, receiver_message ); }
+
+  // Length of the TCP options a segment carrying these messages would have, worked out without encoding them
+  static size_t options_length( const TCPSenderMessage& sender, const TCPReceiverMessage& receiver );
+};
+
+// A received TCP segment, read in place from the Buffers it arrived in (which must outlive the view). The checksum
+// is verified over those fragments without joining them, each header field is decoded from its fixed offset only
+// when asked for, and the payload is a slice of the fragments.
+class TCPSegmentView
+{
+public:
+  TCPSegmentView( const std::vector<Buffer>& fragments, uint32_t datagram_layer_pseudo_checksum );
+
+  // Is the checksum correct, and does the header fit in the segment? (The other accessors need a valid view.)
+  bool valid() const { return valid_; }
+
+  uint16_t src_port() const;
+  uint16_t dst_port() const;
+  Wrap32 seqno() const;
+  std::optional<Wrap32> ackno() const;
+  bool RST() const;
+  bool SYN() const;
+  bool FIN() const;
+  uint16_t window_size() const;
+
+  // Length of the TCP header, including options
+  size_t header_length() const { return header_length_; }
+
+  // The payload, as slices sharing storage with the fragments
+  std::vector<Buffer> payload() const;
+
+  // Decode the whole segment, options included. Returns false if the view is not valid or the options are
+  // malformed.
+  bool decode( TCPSegment& seg ) const;
+
+private:
+  static constexpr size_t MAX_HEADER_LENGTH = 60;
+
+  const std::vector<Buffer>* fragments_;
+  std::array<char, MAX_HEADER_LENGTH> gathered_ {}; // the header, if the first fragment does not hold all of it
+  bool in_place_ {};
+  size_t header_length_ {};
+  bool valid_ {};
+
+  const char* header() const;
 };
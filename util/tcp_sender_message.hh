@@ -1,14 +1,17 @@
 #pragma once
 
 #include "buffer.hh"
+#include "checksum.hh"
 #include "wrapping_integers.hh"
 
+#include <cstdint>
+#include <optional>
 #include <string>
 
 /*
  * The TCPSenderMessage structure contains the information sent from a TCP sender to its receiver.
  *
- * It contains four fields:
+ * It contains six fields:
  *
  * 1) The sequence number (seqno) of the beginning of the segment. If the SYN flag is set, this is the
  *    sequence number of the SYN flag. Otherwise, it's the sequence number of the beginning of the payload.
@@ -19,6 +22,12 @@
  * 3) The payload: a substring (possibly empty) of the byte stream.
  *
  * 4) The FIN flag. If set, it means the payload represents the ending of the byte stream.
+ *
+ * 5) The SACK-permitted option (only meaningful with SYN). If set, the sender understands
+ *    selective acknowledgments, so its peer's receiver may report the out-of-order blocks it holds.
+ *
+ * 6) The timestamp (TSval, RFC 7323): the sender's clock when the segment was sent, if the timestamps
+ *    option is in use. The peer's receiver echoes it back so the sender can measure the round trip.
  */
 
 struct TCPSenderMessage
@@ -27,6 +36,12 @@ struct TCPSenderMessage
   bool SYN { false };
   Buffer payload {};
   bool FIN { false };
+  bool sack_permitted { false };
+  std::optional<uint32_t> timestamp {};
+
+  // The payload's contribution to the TCP checksum, if the sender summed it while copying it out of the stream
+  // (anything that changes the payload must reset this)
+  std::optional<InternetChecksum> payload_checksum {};
 
   // How many sequence numbers does this segment use?
   size_t sequence_length() const { return SYN + payload.size() + FIN; }
@@ -0,0 +1,169 @@
+#include "tcp_sharded_runtime.hh"
+
+#include "exception.hh"
+
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+static FileDescriptor make_eventfd( int flags )
+{
+  return FileDescriptor { CheckSystemCall( "eventfd", ::eventfd( 0, EFD_CLOEXEC | flags ) ) };
+}
+
+static void signal_eventfd( const FileDescriptor& fd, const uint64_t count = 1 )
+{
+  CheckSystemCall( "write", ::write( fd.fd_num(), &count, sizeof( count ) ) );
+}
+
+TCPShardedRuntime::Shard::Shard( FileDescriptor&& queue, const TCPConfig& cfg )
+  : multiplexer( move( queue ), cfg ), wakeup( make_eventfd( EFD_NONBLOCK ) )
+{}
+
+//! \param[in] queues carry one IPv4 datagram per read and write; each gets a shard and a thread
+//! \param[in] cfg is the configuration given to each connection's TCPPeer
+TCPShardedRuntime::TCPShardedRuntime( vector<FileDescriptor>&& queues, const TCPConfig& cfg )
+  : accept_ready_( make_eventfd( EFD_SEMAPHORE ) )
+{
+  if ( queues.empty() ) {
+    throw runtime_error( "TCPShardedRuntime needs at least one queue" );
+  }
+
+  for ( auto& queue : queues ) {
+    shards_.push_back( make_unique<Shard>( move( queue ), cfg ) );
+  }
+  for ( auto& shard : shards_ ) {
+    shard->thread = thread( &TCPShardedRuntime::shard_main, this, ref( *shard ) );
+  }
+}
+
+TCPShardedRuntime::~TCPShardedRuntime()
+{
+  try {
+    stop_.store( true );
+    for ( auto& shard : shards_ ) {
+      signal_eventfd( shard->wakeup );
+      shard->thread.join();
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception destructing TCPShardedRuntime: " << e.what() << endl;
+  }
+}
+
+void TCPShardedRuntime::shard_main( Shard& shard )
+{
+  try {
+    const auto take_requests = [&] {
+      string counter( sizeof( uint64_t ), 0 );
+      shard.wakeup.read( counter );
+
+      queue<Request> requests;
+      {
+        const lock_guard lock { shard.mutex };
+        swap( requests, shard.requests );
+      }
+      for ( ; not requests.empty(); requests.pop() ) {
+        try {
+          ( *requests.front().work )( shard.multiplexer );
+          requests.front().done->set_value();
+        } catch ( ... ) {
+          requests.front().done->set_exception( current_exception() );
+        }
+      }
+    };
+    shard.multiplexer.watch( shard.wakeup, take_requests );
+
+    while ( not stop_.load() ) {
+      shard.multiplexer.wait_next_event( -1 ); // until a segment, a request or a connection's timer is due
+
+      while ( auto connection = shard.multiplexer.accept() ) {
+        {
+          const lock_guard lock { shard.mutex };
+          shard.accepted.push( move( connection.value() ) );
+        }
+        signal_eventfd( accept_ready_ );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception in TCPShardedRuntime shard: " << e.what() << endl;
+    fail( shard, current_exception() );
+  } catch ( ... ) {
+    fail( shard, current_exception() );
+  }
+}
+
+void TCPShardedRuntime::fail( Shard& shard, exception_ptr failure )
+{
+  {
+    const lock_guard lock { shard.mutex };
+    shard.failure = failure;
+    for ( ; not shard.requests.empty(); shard.requests.pop() ) {
+      shard.requests.front().done->set_exception( failure );
+    }
+  }
+  // wake every accept(), now and later, to find it has to give up (a count no caller will use up, with room to
+  // add one per shard and per accepted connection without reaching the eventfd's limit)
+  signal_eventfd( accept_ready_, uint64_t { 1 } << 48 );
+}
+
+void TCPShardedRuntime::run_on( Shard& shard, const function<void( TCPMultiplexer& )>& request )
+{
+  promise<void> done;
+  {
+    const lock_guard lock { shard.mutex };
+    if ( shard.failure ) {
+      rethrow_exception( shard.failure );
+    }
+    shard.requests.push( { &request, &done } );
+  }
+  signal_eventfd( shard.wakeup );
+  done.get_future().get();
+}
+
+void TCPShardedRuntime::listen( const Address& local, size_t backlog, bool syn_cookies )
+{
+  for ( auto& shard : shards_ ) {
+    run_on( *shard, [&]( TCPMultiplexer& multiplexer ) { multiplexer.listen( local, backlog, syn_cookies ); } );
+  }
+}
+
+LocalStreamSocket TCPShardedRuntime::connect( const Address& local, const Address& remote )
+{
+  const FourTuple addresses { local.ipv4_numeric(), local.port(), remote.ipv4_numeric(), remote.port() };
+  Shard& shard = *shards_.at( FourTupleFlowHash {}( addresses ) % shards_.size() );
+
+  optional<LocalStreamSocket> app_end;
+  run_on( shard, [&]( TCPMultiplexer& multiplexer ) { app_end.emplace( multiplexer.connect( local, remote ) ); } );
+  return move( app_end.value() );
+}
+
+pair<LocalStreamSocket, Address> TCPShardedRuntime::accept()
+{
+  // wait for a count, which guarantees some shard has a connection for us
+  string counter( sizeof( uint64_t ), 0 );
+  accept_ready_.read( counter );
+
+  while ( true ) {
+    exception_ptr failure;
+    for ( size_t i = 0; i < shards_.size(); i++ ) {
+      Shard& shard = *shards_.at( next_accept_shard_++ % shards_.size() );
+      const lock_guard lock { shard.mutex };
+      if ( not shard.accepted.empty() ) {
+        auto ret = move( shard.accepted.front() );
+        shard.accepted.pop();
+        return ret;
+      }
+      failure = failure ? failure : shard.failure;
+    }
+    if ( failure ) {
+      rethrow_exception( failure );
+    }
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "address.hh"
+#include "file_descriptor.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_multiplexer.hh"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! \brief A TCP stack sharded across worker threads, one per datagram queue (e.g., each queue of a multi-queue
+//! TUN device)
+//! \details Each shard is a TCPMultiplexer that its own thread serves, with its own event loop and timers; no
+//! connection state is shared between shards. A connection opened with connect() goes to the shard picked by a
+//! symmetric hash of its 4-tuple (FourTupleFlowHash), so a peer that shards by the same hash sees it on the
+//! matching queue. A passive connection belongs to the shard whose queue its SYN arrived on.
+//! Applications talk to their connections through the returned sockets, from any thread.
+class TCPShardedRuntime
+{
+  //! Work for a shard's thread, posted by run_on(), which waits on `done`
+  struct Request
+  {
+    const std::function<void( TCPMultiplexer& )>* work;
+    std::promise<void>* done;
+  };
+
+  struct Shard
+  {
+    TCPMultiplexer multiplexer;
+    FileDescriptor wakeup; //!< eventfd that interrupts the shard's event loop when requests are posted
+
+    std::mutex mutex {}; //!< guards the members below, between this shard's thread and the application
+    std::queue<Request> requests {};
+    std::queue<std::pair<LocalStreamSocket, Address>> accepted {};
+    std::exception_ptr failure {}; //!< why the shard's thread stopped early, if it did
+
+    std::thread thread {};
+
+    Shard( FileDescriptor&& queue, const TCPConfig& cfg );
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_ {};
+  FileDescriptor accept_ready_; //!< semaphore eventfd: one count per connection waiting in a shard's `accepted`
+  std::atomic<size_t> next_accept_shard_ {};
+  std::atomic_bool stop_ { false };
+
+  void shard_main( Shard& shard );
+
+  //! Record why the shard's thread is stopping, and fail its pending and future requests and accept() calls
+  void fail( Shard& shard, std::exception_ptr failure );
+
+  //! Run `request` on the shard's thread, and wait for it to finish (rethrowing why the shard stopped, if it has)
+  void run_on( Shard& shard, const std::function<void( TCPMultiplexer& )>& request );
+
+public:
+  //! Start one shard per queue, each configuring its TCPPeers with `cfg`
+  explicit TCPShardedRuntime( std::vector<FileDescriptor>&& queues, const TCPConfig& cfg = {} );
+
+  //! Stop the shards' threads
+  ~TCPShardedRuntime();
+
+  //! Accept connections to `local` on every shard (see TCPMultiplexer::listen)
+  void listen( const Address& local, size_t backlog = 128, bool syn_cookies = true );
+
+  //! Open a connection from `local` to `remote` on the shard its 4-tuple hashes to
+  LocalStreamSocket connect( const Address& local, const Address& remote );
+
+  //! Wait for the next connection accepted by any shard (rethrowing why a shard stopped, once none is waiting)
+  std::pair<LocalStreamSocket, Address> accept();
+
+  size_t shard_count() const { return shards_.size(); }
+
+  //! \name
+  //! Shard threads refer to the runtime, so it cannot be moved or copied
+
+  //!@{
+  TCPShardedRuntime( const TCPShardedRuntime& ) = delete;
+  TCPShardedRuntime( TCPShardedRuntime&& ) = delete;
+  TCPShardedRuntime& operator=( const TCPShardedRuntime& ) = delete;
+  TCPShardedRuntime& operator=( TCPShardedRuntime&& ) = delete;
+  //!@}
+};
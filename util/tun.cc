@@ -1,38 +1,87 @@
 #include "tun.hh"
 #include "exception.hh"
 
+#include <cerrno>
 #include <cstring>
 #include <fcntl.h>
 #include <linux/if.h>
 #include <linux/if_tun.h>
+#include <stdexcept>
 #include <sys/ioctl.h>
 
 static constexpr const char* CLONEDEV = "/dev/net/tun";
 
 using namespace std;
 
+// Attach `fd` to the device with TUNSETIFF; returns false if the device's queue mode does not match `flags`
+static bool set_interface( const FileDescriptor& fd, const string& devname, const int flags )
+{
+  struct ifreq tun_req
+  {};
+
+  tun_req.ifr_flags = static_cast<int16_t>( flags );
+
+  // copy devname to ifr_name, making sure to null terminate
+
+  strncpy( static_cast<char*>( tun_req.ifr_name ), devname.data(), IFNAMSIZ - 1 );
+  tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
+
+  if ( ioctl( fd.fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) ) < 0 ) {
+    if ( errno == EINVAL ) {
+      return false;
+    }
+    throw unix_error { "ioctl" };
+  }
+  return true;
+}
+
+static int device_flags( const bool is_tun )
+{
+  return ( is_tun ? IFF_TUN : IFF_TAP ) | IFF_NO_PI; // no packetinfo
+}
+
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects
 //! Ethernet frames)
 //!
 //! To create a TUN device, you should already have run
 //!
-//!     ip tuntap add mode tun user `username` name `devname`
+//!     ip tuntap add mode tun [multi_queue] user `username` name `devname`
 //!
 //! as root before calling this function.
 
 TunTapFD::TunTapFD( const string& devname, const bool is_tun )
   : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) )
 {
-  struct ifreq tun_req
-  {};
-
-  tun_req.ifr_flags = static_cast<int16_t>( ( is_tun ? IFF_TUN : IFF_TAP ) | IFF_NO_PI ); // no packetinfo
+  // a multi-queue device only accepts fds that ask for a queue of their own
+  if ( not set_interface( *this, devname, device_flags( is_tun ) )
+       and not set_interface( *this, devname, device_flags( is_tun ) | IFF_MULTI_QUEUE ) ) {
+    throw unix_error { "ioctl" };
+  }
+}
 
-  // copy devname to ifr_name, making sure to null terminate
+TunTapFD::TunTapFD( const string& devname, const bool is_tun, MultiQueue /* unused */ )
+  : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) )
+{
+  if ( not set_interface( *this, devname, device_flags( is_tun ) | IFF_MULTI_QUEUE ) ) {
+    throw runtime_error( devname + " is not a multi-queue device (create it with `ip tuntap add` and `multi_queue`)" );
+  }
+}
 
-  strncpy( static_cast<char*>( tun_req.ifr_name ), devname.data(), IFNAMSIZ - 1 );
-  tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
+vector<TunFD> TunFD::open_queues( const string& devname, const size_t count )
+{
+  vector<TunFD> queues;
+  for ( size_t i = 0; i < count; i++ ) {
+    queues.push_back( TunFD { devname, MultiQueue {} } );
+  }
+  return queues;
+}
 
-  CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) ) );
+vector<TapFD> TapFD::open_queues( const string& devname, const size_t count )
+{
+  vector<TapFD> queues;
+  for ( size_t i = 0; i < count; i++ ) {
+    queues.push_back( TapFD { devname, MultiQueue {} } );
+  }
+  return queues;
 }
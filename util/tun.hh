@@ -3,14 +3,27 @@
 #include "file_descriptor.hh"
 
 #include <string>
+#include <utility>
+#include <vector>
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor
 {
+protected:
+  //! Open one queue of an existing persistent multi-queue device (see TunFD::open_queues())
+  struct MultiQueue
+  {};
+  TunTapFD( const std::string& devname, bool is_tun, MultiQueue /* unused */ );
+
 public:
   //! Open an existing persistent [TUN or TAP
-  //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
+  //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt). A multi-queue device gets one
+  //! queue.
   explicit TunTapFD( const std::string& devname, bool is_tun );
+
+  //! Use an fd that is already open and carries one packet per read and write (e.g., a datagram socket
+  //! standing in for a TUN device in a test)
+  explicit TunTapFD( FileDescriptor&& fd ) : FileDescriptor( std::move( fd ) ) {}
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -19,6 +32,18 @@ class TunFD : public TunTapFD
 public:
   //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
   explicit TunFD( const std::string& devname ) : TunTapFD( devname, true ) {}
+
+  //! Use an fd that is already open and carries one IP datagram per read and write
+  explicit TunFD( FileDescriptor&& fd ) : TunTapFD( std::move( fd ) ) {}
+
+  //! \brief Open `count` queues of an existing persistent multi-queue TUN device (`ip tuntap add mode tun
+  //! multi_queue`, as scripts/tun.sh creates), one fd per worker thread
+  //! \details The kernel steers each flow to one queue, by a hash of its addresses and ports, so each worker sees
+  //! whole connections (e.g. give the fds to a TCPShardedRuntime).
+  static std::vector<TunFD> open_queues( const std::string& devname, size_t count );
+
+private:
+  TunFD( const std::string& devname, MultiQueue mq ) : TunTapFD( devname, true, mq ) {}
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -27,4 +52,10 @@ class TapFD : public TunTapFD
 public:
   //! Open an existing persistent [TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
   explicit TapFD( const std::string& devname ) : TunTapFD( devname, false ) {}
+
+  //! Open `count` queues of an existing persistent multi-queue TAP device (see TunFD::open_queues())
+  static std::vector<TapFD> open_queues( const std::string& devname, size_t count );
+
+private:
+  TapFD( const std::string& devname, MultiQueue mq ) : TunTapFD( devname, false, mq ) {}
 };
@@ -3,20 +3,59 @@
 
 using namespace std;
 
+TCPOverIPv4OverTunFdAdapter::TCPOverIPv4OverTunFdAdapter( TunFD&& tun, bool use_io_uring ) : _tun( move( tun ) )
+{
+  if ( use_io_uring and IOUring::supported() ) {
+    _uring = make_unique<IOUringDatagrams>( _tun.duplicate() );
+  }
+}
+
 optional<TCPSegment> TCPOverIPv4OverTunFdAdapter::read()
 {
+  if ( _uring ) {
+    auto datagram = _uring->read();
+    if ( not datagram ) {
+      return {};
+    }
+    return parse_datagram( { move( datagram.value() ) } );
+  }
+
   vector<string> strs( 2 );
   strs.front().resize( IPv4Header::LENGTH );
   _tun.read( strs );
+  return parse_datagram( { move( strs.at( 0 ) ), move( strs.at( 1 ) ) } );
+}
 
+optional<TCPSegment> TCPOverIPv4OverTunFdAdapter::parse_datagram( vector<Buffer>&& buffers )
+{
   InternetDatagram ip_dgram;
-  const vector<Buffer> buffers = { strs.at( 0 ), strs.at( 1 ) };
   if ( parse( ip_dgram, buffers ) ) {
     return unwrap_tcp_in_ip( ip_dgram );
   }
   return {};
 }
 
+void TCPOverIPv4OverTunFdAdapter::write( TCPSegment& seg )
+{
+  if ( _uring ) {
+    _uring->write( serialize( wrap_tcp_in_ip( seg ) ) );
+  } else {
+    _tun.write( serialize( wrap_tcp_in_ip( seg ) ) );
+  }
+}
+
+void TCPOverIPv4OverTunFdAdapter::flush()
+{
+  if ( _uring ) {
+    _uring->flush();
+  }
+}
+
+size_t TCPOverIPv4OverTunFdAdapter::syscall_count() const
+{
+  return _uring ? _uring->syscall_count() : _tun.read_count() + _tun.write_count();
+}
+
 //! \param[in] tap Raw network device that will be owned by the adapter
 //! \param[in] eth_address Ethernet address (local address) of the adapter
 //! \param[in] ip_address IP address (local address) of the adapter
@@ -1,11 +1,13 @@
 #pragma once
 
 #include "ethernet_header.hh"
+#include "io_uring.hh"
 #include "network_interface.hh"
 #include "tcp_over_ip.hh"
 #include "tcp_segment.hh"
 #include "tun.hh"
 
+#include <memory>
 #include <optional>
 #include <unordered_map>
 #include <utility>
@@ -16,15 +18,35 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 private:
   TunFD _tun;
 
+  //! Reads and writes through io_uring, if enabled; otherwise each is a system call on `_tun`
+  std::unique_ptr<IOUringDatagrams> _uring {};
+
+  std::optional<TCPSegment> parse_datagram( std::vector<Buffer>&& buffers );
+
 public:
-  //! Construct from a TunFD
-  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) {}
+  //! \brief Construct from a TunFD
+  //! \param[in] tun is the TUN device
+  //! \param[in] use_io_uring asks for reads and writes through io_uring (see IOUringDatagrams), falling back
+  //!            to system calls on each event if this kernel does not allow it
+  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun, bool use_io_uring = false );
 
   //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
   std::optional<TCPSegment> read();
 
   //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-  void write( TCPSegment& seg ) { _tun.write( serialize( wrap_tcp_in_ip( seg ) ) ); }
+  void write( TCPSegment& seg );
+
+  //! Submits the reads and writes queued since the last flush (with io_uring)
+  void flush();
+
+  //! Whether a received datagram is waiting for read() (with io_uring)
+  bool read_pending() const { return _uring and _uring->has_completion(); }
+
+  //! Whether reads and writes go through io_uring
+  bool uses_io_uring() const { return _uring != nullptr; }
+
+  //! Number of system calls made for the reads and writes (not counting waits for readiness)
+  size_t syscall_count() const;
 
   //! Access the underlying TUN device
   explicit operator TunFD&() { return _tun; }
@@ -32,8 +54,8 @@ public:
   //! Access the underlying TUN device
   explicit operator const TunFD&() const { return _tun; }
 
-  //! Access underlying file descriptor
-  FileDescriptor& fd() { return _tun; }
+  //! Access the file descriptor to wait on: the TUN device, or the io_uring instance's completions
+  FileDescriptor& fd() { return _uring ? _uring->fd() : _tun; }
 };
 
 //! Typedef for TCPOverIPv4OverTunFdAdapter
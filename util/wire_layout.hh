@@ -0,0 +1,195 @@
+#pragma once
+
+#include "parser.hh"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+
+// Compile-time descriptions of fixed-length wire formats. A header lists each of its fields once, with the field's
+// byte offset, and wire::Layout turns that list into parse and serialize code that reads or writes every field at
+// its constant offset in one contiguous block, with no per-field size checks:
+//
+//   using Layout = wire::Layout<wire::Integer<0, &Header::type>, wire::Bytes<2, &Header::address>>;
+//
+// Layout::length is the length of the format in bytes; the fields must cover it exactly once.
+namespace wire {
+
+// The class and type of a pointer to a data member
+template<auto Member>
+struct member_traits;
+
+template<class H, class T, T H::*Member>
+struct member_traits<Member>
+{
+  using header = H;
+  using type = T;
+};
+
+template<auto Member>
+using member_type = typename member_traits<Member>::type;
+
+// An unsigned integer member, in network byte order
+template<size_t Offset, auto Member>
+  requires std::unsigned_integral<member_type<Member>>
+struct Integer
+{
+  using T = member_type<Member>;
+  static constexpr size_t offset = Offset;
+  static constexpr size_t size = sizeof( T );
+
+  // Decode just this field from the format at `wire`
+  static T get( const char* wire )
+  {
+    T raw {};
+    std::memcpy( &raw, wire + Offset, sizeof( T ) );
+    return big_endian( raw );
+  }
+
+  template<class H>
+  static void read( const char* wire, H& h )
+  {
+    h.*Member = get( wire );
+  }
+
+  template<class H>
+  static void write( const H& h, char* wire )
+  {
+    const T raw = big_endian( h.*Member );
+    std::memcpy( wire + Offset, &raw, sizeof( T ) );
+  }
+};
+
+// A member that is an array of bytes (e.g. an Ethernet address), copied as is
+template<size_t Offset, auto Member>
+  requires( sizeof( typename member_type<Member>::value_type ) == 1 )
+struct Bytes
+{
+  static constexpr size_t offset = Offset;
+  static constexpr size_t size = std::tuple_size_v<member_type<Member>>;
+
+  template<class H>
+  static void read( const char* wire, H& h )
+  {
+    std::memcpy( ( h.*Member ).data(), wire + Offset, size );
+  }
+
+  template<class H>
+  static void write( const H& h, char* wire )
+  {
+    std::memcpy( wire + Offset, ( h.*Member ).data(), size );
+  }
+};
+
+// A member held in `Width` bits of a Packed integer, starting `Shift` bits above its least significant bit
+template<auto Member, unsigned Shift, unsigned Width>
+struct Bits
+{
+  template<std::unsigned_integral W>
+  static constexpr W mask = static_cast<W>( ( 1ULL << Width ) - 1 );
+
+  template<std::unsigned_integral W>
+  static member_type<Member> get( W word )
+  {
+    return static_cast<member_type<Member>>( ( word >> Shift ) & mask<W> );
+  }
+
+  template<std::unsigned_integral W, class H>
+  static void read( W word, H& h )
+  {
+    h.*Member = get( word );
+  }
+
+  template<std::unsigned_integral W, class H>
+  static W write( const H& h )
+  {
+    return static_cast<W>( ( static_cast<W>( h.*Member ) & mask<W> ) << Shift );
+  }
+};
+
+// An unsigned integer of type W, in network byte order, that packs several members (each a Bits) together.
+// Bits not covered by any member are read as nothing and written as zero.
+template<size_t Offset, std::unsigned_integral W, typename... Members>
+struct Packed
+{
+  static constexpr size_t offset = Offset;
+  static constexpr size_t size = sizeof( W );
+
+  // Decode just `Member` (one of Members) from the format at `wire`
+  template<typename Member>
+  static auto get( const char* wire )
+  {
+    W raw {};
+    std::memcpy( &raw, wire + Offset, sizeof( W ) );
+    return Member::get( big_endian( raw ) );
+  }
+
+  template<class H>
+  static void read( const char* wire, H& h )
+  {
+    W raw {};
+    std::memcpy( &raw, wire + Offset, sizeof( W ) );
+    const W word = big_endian( raw );
+    ( Members::read( word, h ), ... );
+  }
+
+  template<class H>
+  static void write( const H& h, char* wire )
+  {
+    const W raw = big_endian( static_cast<W>( ( Members::template write<W>( h ) | ... | W {} ) ) );
+    std::memcpy( wire + Offset, &raw, sizeof( W ) );
+  }
+};
+
+// A fixed-length wire format made of Fields (each an Integer, Bytes or Packed)
+template<typename... Fields>
+struct Layout
+{
+  static constexpr size_t length = std::max( { ( Fields::offset + Fields::size )... } );
+
+private:
+  // Every byte of the format belongs to exactly one field
+  static constexpr bool covered_once()
+  {
+    std::array<size_t, length> owners {};
+    ( [&] {
+      for ( size_t i = Fields::offset; i < Fields::offset + Fields::size; i++ ) {
+        owners.at( i )++;
+      }
+    }(),
+      ... );
+    return std::ranges::all_of( owners, []( size_t n ) { return n == 1; } );
+  }
+  static_assert( covered_once(), "fields of a wire::Layout must not overlap or leave gaps" );
+
+public:
+  // Decode the `length` bytes at `wire` into `h`
+  template<class H>
+  static void read( const char* wire, H& h )
+  {
+    ( Fields::read( wire, h ), ... );
+  }
+
+  // Encode `h` into the `length` bytes at `wire`
+  template<class H>
+  static void write( const H& h, char* wire )
+  {
+    ( Fields::write( h, wire ), ... );
+  }
+
+  template<class H>
+  static void parse( Parser& parser, H& h )
+  {
+    parser.block<length>( [&]( const char* wire ) { read( wire, h ); } );
+  }
+
+  template<class H>
+  static void serialize( Serializer& serializer, const H& h )
+  {
+    serializer.block<length>( [&]( char* wire ) { write( h, wire ); } );
+  }
+};
+
+} // namespace wire